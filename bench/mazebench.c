@@ -0,0 +1,270 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "algos.h"
+#include "bmp.h"
+#include "maze.h"
+#include "batch.h"
+#include "pqueue.h"
+#include "costmap.h"
+
+/*
+    Stage benchmark for the solver.
+    Every maze goes through the whole pipeline repeat times, and every stage is timed on its own:
+        decode - mapping the bitmap and packing it into the wall bitset
+        build  - building the graph (and the grid search arrays)
+        search - A* from start to end
+        write  - decoding the pixels, drawing the path and writing the output bitmap
+    The median and 99th percentile of every stage are printed, along with the
+    nodes expanded per second of search time, and written to a JSON file for
+    comparing one build against another.
+
+    With -weights the mazes are read as weighted maps (see costmap.h) instead of black and white walls.
+
+    Usage: mazebench [-full | -grid | -corridor | -csr] [-weights threshold maxCost] [-repeat N] [-json file] [-out file.bmp] maze.bmp ...
+*/
+
+typedef enum BENCH_STAGE_ENUM {
+    STAGE_DECODE,
+    STAGE_BUILD,
+    STAGE_SEARCH,
+    STAGE_WRITE,
+    numStages
+} BENCH_STAGE;
+
+static const char* stageNames[numStages] = {"decode", "build", "search", "write"};
+
+typedef struct BENCH_RESULT_STRUCT {
+    char* name;
+    int width;
+    int height;
+    uint32_t graphNodes;
+    uint32_t pathCost;
+    uint64_t expanded;
+
+    // Sorted stage times of every run, in ms
+    double* times[numStages];
+    double median[numStages];
+    double p99[numStages];
+} BENCH_RESULT;
+
+static int compareTimes(const void* a, const void* b)
+{
+    double left = *(const double*)a;
+    double right = *(const double*)b;
+    return (left > right) - (left < right);
+}
+
+// Nearest rank percentile of sorted times
+static double percentile(const double* sorted, int count, double fraction)
+{
+    int rank = (int)((fraction * count) + 0.999999);
+    rank = (rank < 1) ? 1 : rank;
+    rank = (rank > count) ? count : rank;
+    return sorted[rank - 1];
+}
+
+// One pass through the pipeline, false if the maze could not be solved
+static bool runOnce(char* name, GRAPH_MODE mode, COST_TABLE* table, char* outName, BENCH_RESULT* result, int run)
+{
+    double start = nowMs();
+    BMP* bmp = mapBMP(name);
+    MAZE* maze = mazeFromBMP(bmp, table, NULL);
+    result->times[STAGE_DECODE][run] = nowMs() - start;
+
+    start = nowMs();
+    GRAPH* graph = graphFromMaze(maze, mode, 1);
+    bool built = graph != NULL && gridSearchState(graph);
+    result->times[STAGE_BUILD][run] = nowMs() - start;
+    if(!built)
+    {
+        freeGraph(&graph);
+        freeBMP(&bmp);
+        return false;
+    }
+
+    start = nowMs();
+    PATH path = {0};
+    SEARCH_STATS stats = {0};
+    bool solved = solveGraph(graph, &path, &stats);
+    result->times[STAGE_SEARCH][run] = nowMs() - start;
+
+    start = nowMs();
+    bool written = solved && readData(bmp) && drawPath(bmp, &path, 0xFF0000) && writeBMP(bmp, outName);
+    result->times[STAGE_WRITE][run] = nowMs() - start;
+
+    result->width = graph->width;
+    result->height = graph->height;
+    result->graphNodes = graph->size;
+    result->pathCost = path.cost;
+    result->expanded = stats.expanded;
+    freePath(&path);
+    freeGraph(&graph);
+    freeBMP(&bmp);
+    return written;
+}
+
+static bool benchMaze(char* name, GRAPH_MODE mode, COST_TABLE* table, int repeat, char* outName, BENCH_RESULT* result)
+{
+    memset(result, 0, sizeof(BENCH_RESULT));
+    result->name = name;
+    bool success = true;
+    for(int s = 0; s < numStages; s++)
+    {
+        result->times[s] = malloc(sizeof(double) * repeat);
+        success = success && result->times[s] != NULL;
+    }
+    for(int run = 0; success && run < repeat; run++)
+    {
+        success = runOnce(name, mode, table, outName, result, run);
+    }
+    if(!success)
+    {
+        return false;
+    }
+    for(int s = 0; s < numStages; s++)
+    {
+        qsort(result->times[s], repeat, sizeof(double), compareTimes);
+        result->median[s] = percentile(result->times[s], repeat, 0.5);
+        result->p99[s] = percentile(result->times[s], repeat, 0.99);
+    }
+    return true;
+}
+
+static double expandedPerSecond(BENCH_RESULT* result)
+{
+    double searchMs = result->median[STAGE_SEARCH];
+    return (searchMs > 0) ? result->expanded / (searchMs / 1000.0) : 0;
+}
+
+static bool writeJSON(char* fileName, char* modeName, int repeat, BENCH_RESULT* results, int count)
+{
+    FILE* fp = fopen(fileName, "w");
+    if(fp == NULL)
+    {
+        return false;
+    }
+    fprintf(fp, "{\n  \"mode\": \"%s\",\n  \"queue\": \"%s\",\n  \"repeat\": %d,\n  \"mazes\": [\n", modeName, queueBackend, repeat);
+    for(int i = 0; i < count; i++)
+    {
+        BENCH_RESULT* result = &(results[i]);
+        fprintf(fp, "    {\n      \"name\": \"%s\",\n      \"width\": %d,\n      \"height\": %d,\n", result->name, result->width, result->height);
+        fprintf(fp, "      \"graphNodes\": %u,\n      \"pathCost\": %u,\n      \"expanded\": %llu,\n",
+            result->graphNodes, result->pathCost, (unsigned long long)result->expanded);
+        fprintf(fp, "      \"expandedPerSecond\": %.0f,\n", expandedPerSecond(result));
+        for(int s = 0; s < numStages; s++)
+        {
+            fprintf(fp, "      \"%sMs\": {\"median\": %.4f, \"p99\": %.4f}%s\n", stageNames[s],
+                result->median[s], result->p99[s], (s + 1 < numStages) ? "," : "");
+        }
+        fprintf(fp, "    }%s\n", (i + 1 < count) ? "," : "");
+    }
+    fprintf(fp, "  ]\n}\n");
+    return fclose(fp) == 0;
+}
+
+int main(int argc, char* argv[])
+{
+    GRAPH_MODE mode = GRAPH_GRID;
+    char* modeName = "grid";
+    int repeat = 20;
+    char* jsonName = NULL;
+    char* outName = "bench_solved.bmp";
+    COST_TABLE costTable;
+    COST_TABLE* table = NULL;
+
+    int first = 1;
+    for(; first < argc && argv[first][0] == '-'; first++)
+    {
+        if(strcmp(argv[first], "-full") == 0)
+        {
+            mode = GRAPH_FULL;
+            modeName = "full";
+        }
+        else if(strcmp(argv[first], "-grid") == 0)
+        {
+            mode = GRAPH_GRID;
+            modeName = "grid";
+        }
+        else if(strcmp(argv[first], "-corridor") == 0)
+        {
+            mode = GRAPH_CORRIDOR;
+            modeName = "corridor";
+        }
+        else if(strcmp(argv[first], "-csr") == 0)
+        {
+            mode = GRAPH_CSR;
+            modeName = "csr";
+        }
+        else if(strcmp(argv[first], "-weights") == 0 && first + 2 < argc && atoi(argv[first + 1]) > 0 && atoi(argv[first + 2]) > 0)
+        {
+            costRamp(&costTable, atoi(argv[first + 1]), atoi(argv[first + 2]));
+            table = &costTable;
+            first += 2;
+        }
+        else if(strcmp(argv[first], "-repeat") == 0 && first + 1 < argc && atoi(argv[first + 1]) > 0)
+        {
+            repeat = atoi(argv[++first]);
+        }
+        else if(strcmp(argv[first], "-json") == 0 && first + 1 < argc)
+        {
+            jsonName = argv[++first];
+        }
+        else if(strcmp(argv[first], "-out") == 0 && first + 1 < argc)
+        {
+            outName = argv[++first];
+        }
+        else
+        {
+            break;
+        }
+    }
+    int count = argc - first;
+    if(count <= 0)
+    {
+        printf("Usage: %s [-full | -grid | -corridor | -csr] [-weights threshold maxCost] [-repeat N] [-json file] [-out file.bmp] maze.bmp ...\n", argv[0]);
+        return 1;
+    }
+
+    BENCH_RESULT* results = calloc(count, sizeof(BENCH_RESULT));
+    if(results == NULL)
+    {
+        return 1;
+    }
+    printf("Mode: %s, open set: %s, %d runs per maze, times in ms (median / p99)\n", modeName, queueBackend, repeat);
+    printf("%-36s %17s %17s %17s %17s %14s\n", "maze", "decode", "build", "search", "write", "expanded/s");
+    bool allSolved = true;
+    for(int i = 0; i < count; i++)
+    {
+        BENCH_RESULT* result = &(results[i]);
+        if(!benchMaze(argv[first + i], mode, table, repeat, outName, result))
+        {
+            printf("%-36s could not be solved\n", argv[first + i]);
+            allSolved = false;
+            continue;
+        }
+        printf("%-36s", result->name);
+        for(int s = 0; s < numStages; s++)
+        {
+            printf(" %8.3f /%7.3f", result->median[s], result->p99[s]);
+        }
+        printf(" %14.0f\n", expandedPerSecond(result));
+    }
+
+    if(jsonName != NULL && !writeJSON(jsonName, modeName, repeat, results, count))
+    {
+        errMsg("main", "Could not write JSON file!");
+        allSolved = false;
+    }
+    for(int i = 0; i < count; i++)
+    {
+        for(int s = 0; s < numStages; s++)
+        {
+            free(results[i].times[s]);
+        }
+    }
+    free(results);
+    return allSolved ? 0 : 1;
+}
@@ -0,0 +1,175 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "bmp.h"
+
+/*
+    Synthetic maze generator for the benchmarks.
+
+    Carves a perfect maze (exactly one path between any two cells) with a
+    randomized depth first search on a size x size 24 bit bitmap, where cells
+    sit on odd coordinates and the pixels between them are walls or passages.
+    openPercent of the walls between cells that are left after carving are then
+    knocked out as well: 0 keeps the long single corridors of a perfect maze,
+    higher values add loops and open areas, so there are fewer corridors and
+    more junctions. The start is in the top row and the end in the bottom row,
+    the same way the mazes in maze/ are drawn.
+
+    Usage: mazegen size openPercent out.bmp [seed]
+*/
+
+#define openColor 0xFFFFFF
+#define wallColor 0x000000
+
+// xorshift32, the same seed always gives the same maze
+static uint32_t nextRandom(uint32_t* state)
+{
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+static BMP* newMazeBMP(int size)
+{
+    BMP* toReturn = newBMP();
+    if(toReturn == NULL)
+    {
+        return NULL;
+    }
+    toReturn->dib.headerSize = 40;
+    toReturn->dib.bmpWidth = size;
+    toReturn->dib.bmpHeight = size;
+    toReturn->dib.colorPlanes = 1;
+    toReturn->dib.bitsPerPixel = 24;
+    toReturn->data.width = size;
+    toReturn->data.height = size;
+    toReturn->data.area = size * size;
+    toReturn->data.bitDepth = 24;
+    toReturn->dib.imageSize = bmpRowSize(toReturn) * size;
+
+    // Everything starts as a wall (zeroed)
+    toReturn->data.colorData = calloc((size_t)size * size, sizeof(PIXEL));
+    if(toReturn->data.colorData == NULL)
+    {
+        freeBMP(&toReturn);
+        return NULL;
+    }
+    return toReturn;
+}
+
+static void setOpen(BMP* maze, int x, int y)
+{
+    maze->data.colorData[x + ((size_t)maze->data.width * y)].value = openColor;
+}
+
+static bool isOpen(BMP* maze, int x, int y)
+{
+    return maze->data.colorData[x + ((size_t)maze->data.width * y)].value == openColor;
+}
+
+// Randomized depth first search over the cells, cell (cx, cy) is pixel (2cx + 1, 2cy + 1)
+static bool carve(BMP* maze, uint32_t* state)
+{
+    int cells = (maze->data.width - 1) / 2;
+    uint32_t* stack = malloc(sizeof(uint32_t) * cells * cells);
+    if(stack == NULL)
+    {
+        return false;
+    }
+    const int stepX[4] = {0, 0, -1, 1};
+    const int stepY[4] = {1, -1, 0, 0};
+
+    uint32_t depth = 0;
+    stack[depth++] = 0;
+    setOpen(maze, 1, 1);
+    while(depth > 0)
+    {
+        uint32_t cell = stack[depth - 1];
+        int cx = cell % cells;
+        int cy = cell / cells;
+
+        // Cells not carved into yet are still walls
+        int choices[4];
+        int count = 0;
+        for(int i = 0; i < 4; i++)
+        {
+            int nx = cx + stepX[i];
+            int ny = cy + stepY[i];
+            if(nx >= 0 && ny >= 0 && nx < cells && ny < cells && !isOpen(maze, (2 * nx) + 1, (2 * ny) + 1))
+            {
+                choices[count++] = i;
+            }
+        }
+        if(count == 0)
+        {
+            depth--;
+            continue;
+        }
+
+        int i = choices[nextRandom(state) % count];
+        int nx = cx + stepX[i];
+        int ny = cy + stepY[i];
+        setOpen(maze, (2 * cx) + 1 + stepX[i], (2 * cy) + 1 + stepY[i]);
+        setOpen(maze, (2 * nx) + 1, (2 * ny) + 1);
+        stack[depth++] = nx + (cells * ny);
+    }
+    free(stack);
+    return true;
+}
+
+// Knocks out openPercent of the walls left between two cells
+static void openWalls(BMP* maze, int openPercent, uint32_t* state)
+{
+    int size = maze->data.width;
+    for(int y = 1; y < size - 1; y++)
+    {
+        // Walls between cells are the pixels with one odd and one even coordinate
+        for(int x = (y % 2 == 0) ? 1 : 2; x < size - 1; x += 2)
+        {
+            if(!isOpen(maze, x, y) && (int)(nextRandom(state) % 100) < openPercent)
+            {
+                setOpen(maze, x, y);
+            }
+        }
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    if(argc < 4 || atoi(argv[1]) < 5 || atoi(argv[2]) < 0 || atoi(argv[2]) > 100)
+    {
+        printf("Usage: %s size openPercent out.bmp [seed]\n", argv[0]);
+        return 1;
+    }
+
+    // Cells need odd sizes so the outer wall is closed on every side
+    int size = atoi(argv[1]) | 1;
+    int openPercent = atoi(argv[2]);
+    uint32_t state = (argc > 4 && atoi(argv[4]) != 0) ? (uint32_t)atoi(argv[4]) : 1;
+
+    BMP* maze = newMazeBMP(size);
+    if(maze == NULL || !carve(maze, &state))
+    {
+        errMsg("main", "Out of memory!");
+        freeBMP(&maze);
+        return 1;
+    }
+    openWalls(maze, openPercent, &state);
+
+    // Openings in the top and bottom rows (y = 0 is the bottom row)
+    setOpen(maze, 1, size - 1);
+    setOpen(maze, size - 2, 0);
+
+    bool written = writeBMP(maze, argv[3]);
+    freeBMP(&maze);
+    if(!written)
+    {
+        errMsg("main", "Could not write maze file!");
+        return 1;
+    }
+    return 0;
+}
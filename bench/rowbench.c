@@ -0,0 +1,225 @@
+// Needed for clock_gettime under -std=c99
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+#include <time.h>
+#include "rowdecode.h"
+
+/*
+    Microbenchmark for the row decoders.
+    Decodes about 32 MB of random rows per bit depth with the per pixel fread loops
+    the decoders replaced (readDataBits and readDataBytes), with the scalar kernels
+    and with the kernels rowDecoder picks, and prints the throughput of all three in GB/s
+    (bytes of bitmap data read per second).
+
+    Before timing anything, every width from 1 to checkWidths and one odd large width
+    are decoded all three ways, so the tail loops of the SIMD kernels are checked too.
+*/
+
+#define benchWidth 4096
+#define benchBytes (32 * 1024 * 1024)
+#define benchRepeats 5
+
+// The per pixel loops are slow, so they only decode one in this many rows once
+#define perPixelShare 8
+
+// Widths checked one by one, plus an odd width that is not a multiple of any vector
+#define checkWidths 64
+#define oddWidth 4093
+#define checkRows 8
+
+static double nowSeconds()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + (now.tv_nsec / 1e9);
+}
+
+// Best time out of benchRepeats to decode every row once
+static double timeDecoder(ROW_DECODER decoder, const uint8_t* rows, int rowSize, int numRows, uint32_t* values)
+{
+    double best = 1e30;
+    for(int r = 0; r < benchRepeats; r++)
+    {
+        double start = nowSeconds();
+        for(int y = 0; y < numRows; y++)
+        {
+            decoder(rows + ((size_t)rowSize * y), values, benchWidth);
+        }
+        double elapsed = nowSeconds() - start;
+        if(elapsed < best)
+        {
+            best = elapsed;
+        }
+    }
+    return best;
+}
+
+// The loops from before the row decoders, one fread per pixel (or per byte below 8 bpp) from fp
+// 16 bpp values are widened afterwards, since the decoders now hand out 0xRRGGBB for them
+static bool perPixelDecode(FILE* fp, int bitDepth, int width, int rowSize, uint32_t* values)
+{
+    uint8_t buffer[4];
+    if(bitDepth < 8)
+    {
+        int bitsLeft = 0;
+        uint8_t bitMask = 0;
+        for(int x = 0; x < width; x++)
+        {
+            if(bitsLeft == 0)
+            {
+                if(fread(buffer, sizeof(uint8_t), 1, fp) != 1)
+                {
+                    return false;
+                }
+                bitsLeft = 8;
+                bitMask = 0xFF << (8 - bitDepth);
+            }
+            values[x] = (buffer[0] & bitMask) >> (bitsLeft - bitDepth);
+            bitMask >>= bitDepth;
+            bitsLeft -= bitDepth;
+        }
+        return fseek(fp, rowSize - (((width * bitDepth) + 7) / 8), SEEK_CUR) == 0;
+    }
+
+    int bytesPerPixel = bitDepth / 8;
+    for(int x = 0; x < width; x++)
+    {
+        if(fread(buffer, sizeof(uint8_t), bytesPerPixel, fp) != (size_t)bytesPerPixel)
+        {
+            return false;
+        }
+        uint32_t value = 0;
+        for(int i = bytesPerPixel - 1; i >= 0; i--)
+        {
+            value <<= 8;
+            value += buffer[i];
+        }
+        values[x] = (bitDepth == 16) ? expand555(value) : value;
+    }
+    return fseek(fp, rowSize - (width * bytesPerPixel), SEEK_CUR) == 0;
+}
+
+// Decodes checkRows rows of every checked width all three ways, false if any of them disagree
+static bool checkDecoders(int bitDepth, const uint8_t* rows, uint32_t* expected, uint32_t* values)
+{
+    ROW_DECODER scalar = scalarRowDecoder(bitDepth);
+    ROW_DECODER fast = rowDecoder(bitDepth);
+    for(int width = 1; width <= checkWidths + 1; width++)
+    {
+        int checkWidth = (width > checkWidths) ? oddWidth : width;
+        int rowSize = (((checkWidth * bitDepth) + 31) / 32) * 4;
+        FILE* fp = fmemopen((void*)rows, (size_t)rowSize * checkRows, "rb");
+        if(fp == NULL)
+        {
+            return false;
+        }
+        for(int y = 0; y < checkRows; y++)
+        {
+            const uint8_t* row = rows + ((size_t)rowSize * y);
+            bool same = perPixelDecode(fp, bitDepth, checkWidth, rowSize, expected);
+            scalar(row, values, checkWidth);
+            same = same && memcmp(expected, values, sizeof(uint32_t) * checkWidth) == 0;
+            fast(row, values, checkWidth);
+            same = same && memcmp(expected, values, sizeof(uint32_t) * checkWidth) == 0;
+            if(!same)
+            {
+                printf("%5d bpp decoders disagree at width %d, row %d\n", bitDepth, checkWidth, y);
+                fclose(fp);
+                return false;
+            }
+        }
+        fclose(fp);
+    }
+    return true;
+}
+
+// Time for the per pixel loops to decode one in perPixelShare of the rows, scaled up to all of them
+static double timePerPixel(int bitDepth, const uint8_t* rows, int rowSize, int numRows, uint32_t* values)
+{
+    int sampled = numRows / perPixelShare;
+    FILE* fp = fmemopen((void*)rows, (size_t)rowSize * sampled, "rb");
+    if(fp == NULL)
+    {
+        return 0;
+    }
+    double start = nowSeconds();
+    for(int y = 0; y < sampled && perPixelDecode(fp, bitDepth, benchWidth, rowSize, values); y++);
+    double elapsed = nowSeconds() - start;
+    fclose(fp);
+    return elapsed * ((double)numRows / sampled);
+}
+
+int main()
+{
+    const int depths[] = {1, 4, 8, 16, 24, 32};
+    const int numDepths = sizeof(depths) / sizeof(depths[0]);
+
+    uint8_t* rows = malloc(benchBytes);
+    uint32_t* scalarValues = malloc(sizeof(uint32_t) * benchWidth);
+    uint32_t* fastValues = malloc(sizeof(uint32_t) * benchWidth);
+    if(rows == NULL || scalarValues == NULL || fastValues == NULL)
+    {
+        printf("Out of memory\n");
+        return 1;
+    }
+    srand(1);
+    for(int i = 0; i < benchBytes; i++)
+    {
+        rows[i] = rand() & 0xFF;
+    }
+
+    // 16 bpp is 555, every channel has to come out 8 bits wide (white, black, red, green, blue)
+    const uint8_t fixture16[] = {0xFF, 0x7F, 0x00, 0x00, 0x00, 0x7C, 0xE0, 0x03, 0x1F, 0x00};
+    const uint32_t expected16[] = {0xFFFFFF, 0x000000, 0xFF0000, 0x00FF00, 0x0000FF};
+    rowDecoder(16)(fixture16, fastValues, 5);
+    if(memcmp(fastValues, expected16, sizeof(expected16)) != 0)
+    {
+        printf("16 bpp pixels decode to the wrong colors\n");
+        return 1;
+    }
+
+    printf("Row decoder throughput (%s kernels, %d pixel rows)\n", rowDecoderLevel(), benchWidth);
+    printf("%5s %15s %14s %14s %14s %14s\n", "bpp", "per pixel GB/s", "scalar GB/s", "dispatch GB/s",
+        "vs per pixel", "vs scalar");
+    for(int i = 0; i < numDepths; i++)
+    {
+        int bitDepth = depths[i];
+        int rowSize = (((benchWidth * bitDepth) + 31) / 32) * 4;
+        int numRows = benchBytes / rowSize;
+        ROW_DECODER scalar = scalarRowDecoder(bitDepth);
+        ROW_DECODER fast = rowDecoder(bitDepth);
+
+        // Every decoder has to agree before their speed means anything
+        if(!checkDecoders(bitDepth, rows, scalarValues, fastValues))
+        {
+            return 1;
+        }
+        for(int y = 0; y < numRows; y++)
+        {
+            scalar(rows + ((size_t)rowSize * y), scalarValues, benchWidth);
+            fast(rows + ((size_t)rowSize * y), fastValues, benchWidth);
+            if(memcmp(scalarValues, fastValues, sizeof(uint32_t) * benchWidth) != 0)
+            {
+                printf("%5d kernels disagree on row %d\n", bitDepth, y);
+                return 1;
+            }
+        }
+
+        double bytes = (double)rowSize * numRows;
+        double perPixelTime = timePerPixel(bitDepth, rows, rowSize, numRows, scalarValues);
+        double scalarTime = timeDecoder(scalar, rows, rowSize, numRows, scalarValues);
+        double fastTime = timeDecoder(fast, rows, rowSize, numRows, fastValues);
+        printf("%5d %15.2f %14.2f %14.2f %13.1fx %13.1fx\n", bitDepth, bytes / perPixelTime / 1e9, bytes / scalarTime / 1e9,
+            bytes / fastTime / 1e9, perPixelTime / fastTime, scalarTime / fastTime);
+    }
+
+    free(rows);
+    free(scalarValues);
+    free(fastValues);
+    return 0;
+}
@@ -1,10 +1,1201 @@
+// Needed for pthreads under -std=c99
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdlib.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <string.h>
+#include <pthread.h>
 #include "algos.h"
 #include "bmp.h"
+#include "landmarks.h"
+#include "hpa.h"
+#include "graphcache.h"
+
+GRAPH* graphFromBMP(BMP* toConvert, GRAPH_MODE mode, ARENA* arena, int numThreads)
+{
+    MAZE* maze = mazeFromBMP(toConvert, NULL, arena);
+    if(maze == NULL)
+    {
+        return NULL;
+    }
+    return graphFromMaze(maze, mode, numThreads);
+}
+
+/* NODE GRAPH BANDS */
+
+/*
+    NODE graphs are built in horizontal bands of rows, one per thread.
+    Every band numbers its own nodes from 0, then the ids are shifted by the
+    number of nodes in the bands below, so they come out in row major order
+    (the same ids one thread gives) whatever the thread count. Links that
+    stay inside a band are made by its own thread. Up links that run into the
+    band above (along a corridor they can skip whole bands) are left out and
+    stitched afterwards, one seam at a time.
+*/
+
+// Bands thinner than this are not worth a thread
+#define minBandRows 64
+
+// Weighted mazes get a node on every row and column that is a multiple of this,
+// so a corridor edge is at most 256 steps of cost 255 and still fits in a uint16_t
+#define weightedSpan 256
+
+typedef struct NODE_BUILD_STRUCT {
+    MAZE* maze;
+    GRAPH_MODE mode;
+    uint32_t* cellToNode;
+    NODE* nodes;
+
+    // Band b covers rows [bandRow[b], bandRow[b + 1])
+    int numBands;
+    int* bandRow;
+
+    // Nodes in each band, and then the id of the first node of each band
+    uint32_t* bandNodes;
+} NODE_BUILD;
+
+typedef struct BAND_JOB_STRUCT {
+    NODE_BUILD* build;
+    int band;
+    bool started;
+    pthread_t thread;
+} BAND_JOB;
+
+static bool isNodeCell(MAZE* maze, GRAPH_MODE mode, int x, int y)
+{
+    if(!mazeIsOpen(maze, x, y))
+    {
+        return false;
+    }
+
+    // Start and end always need a node, even in the middle of a corridor
+    uint32_t cell = x + (maze->width * y);
+    bool spanEnd = maze->costs != NULL && ((x % weightedSpan) == 0 || (y % weightedSpan) == 0);
+    return (mode != GRAPH_CORRIDOR && mode != GRAPH_CSR) || cell == maze->startCell || cell == maze->endCell
+        || spanEnd || !mazeIsCorridor(maze, x, y);
+}
+
+// Cost of walking steps cells from cell, stride apart (the length of the walk if the maze is unweighted)
+static uint32_t walkCost(MAZE* maze, uint32_t cell, int steps, uint32_t stride)
+{
+    if(maze->costs == NULL)
+    {
+        return steps;
+    }
+    uint32_t cost = 0;
+    for(int i = 0; i < steps; i++)
+    {
+        cost += mazeStepCost(maze, cell, cell + stride);
+        cell += stride;
+    }
+    return cost;
+}
+
+static void linkVertical(NODE* below, NODE* above, uint32_t cost)
+{
+    below->up = above;
+    below->upCost = cost;
+    above->down = below;
+    above->downCost = cost;
+}
+
+// Maps every cell of the band to its node index counted from the start of the band
+// (noCell for walls and collapsed corridor cells)
+static void* numberBand(void* arg)
+{
+    BAND_JOB* job = arg;
+    NODE_BUILD* build = job->build;
+    MAZE* maze = build->maze;
+    int width = maze->width;
+    uint32_t count = 0;
+    for(int y = build->bandRow[job->band]; y < build->bandRow[job->band + 1]; y++)
+    {
+        for(int x = 0; x < width; x++)
+        {
+            build->cellToNode[x + (width * y)] = isNodeCell(maze, build->mode, x, y) ? count++ : noCell;
+        }
+    }
+    build->bandNodes[job->band] = count;
+    return NULL;
+}
+
+// Moves the band's ids up to its first id and links every edge that stays inside the band
+static void* linkBand(void* arg)
+{
+    BAND_JOB* job = arg;
+    NODE_BUILD* build = job->build;
+    MAZE* maze = build->maze;
+    uint32_t* cellToNode = build->cellToNode;
+    NODE* nodes = build->nodes;
+    int width = maze->width;
+    int firstRow = build->bandRow[job->band];
+    int lastRow = build->bandRow[job->band + 1];
+
+    uint32_t firstId = build->bandNodes[job->band];
+    for(size_t cell = (size_t)width * firstRow; cell < (size_t)width * lastRow; cell++)
+    {
+        if(cellToNode[cell] != noCell)
+        {
+            cellToNode[cell] += firstId;
+        }
+    }
+
+    /*
+        Link every node to the next node to its right and above it.
+        The reverse links are filled in from the other end of the edge.
+        Without compression the next node is always the adjacent pixel,
+        with compression the walk runs down the corridor until it hits a node.
+        Corridor cells are only open in the direction of the walk,
+        so the walk can never leave the corridor or run into a wall.
+    */
+    for(int y = firstRow; y < lastRow; y++)
+    {
+        for(int x = 0; x < width; x++)
+        {
+            uint32_t index = cellToNode[x + (width * y)];
+            if(index == noCell)
+            {
+                continue;
+            }
+            NODE* current = &(nodes[index]);
+            current->x = x;
+            current->y = y;
+            current->cost = UINT32_MAX;
+
+            // Right (the padding bit past the last column is always a wall)
+            if(mazeIsOpen(maze, x + 1, y))
+            {
+                int nextX = x + 1;
+                while(cellToNode[nextX + (width * y)] == noCell)
+                {
+                    nextX++;
+                }
+                NODE* next = &(nodes[cellToNode[nextX + (width * y)]]);
+                uint32_t cost = walkCost(maze, x + (width * y), nextX - x, 1);
+                current->right = next;
+                current->rightCost = cost;
+                next->left = current;
+                next->leftCost = cost;
+            }
+
+            // Up is towards the top of the image, which is the next row in colorData
+            // Walks that reach the band above are stitched by stitchSeams
+            if(y + 1 < maze->height && mazeIsOpen(maze, x, y + 1))
+            {
+                int nextY = y + 1;
+                while(nextY < lastRow && cellToNode[x + (width * nextY)] == noCell)
+                {
+                    nextY++;
+                }
+                if(nextY < lastRow)
+                {
+                    linkVertical(current, &(nodes[cellToNode[x + (width * nextY)]]),
+                        walkCost(maze, x + (width * y), nextY - y, width));
+                }
+            }
+        }
+    }
+    return NULL;
+}
+
+// Links the up edges that cross from one band into the next
+static void stitchSeams(NODE_BUILD* build)
+{
+    MAZE* maze = build->maze;
+    uint32_t* cellToNode = build->cellToNode;
+    int width = maze->width;
+    for(int b = 1; b < build->numBands; b++)
+    {
+        int seam = build->bandRow[b];
+        for(int x = 0; x < width; x++)
+        {
+            if(!mazeIsOpen(maze, x, seam - 1) || !mazeIsOpen(maze, x, seam))
+            {
+                continue;
+            }
+
+            // Both ends walk along the corridor to the nearest node, a corridor
+            // across several seams is linked once for each (to the same nodes)
+            int lowY = seam - 1;
+            while(cellToNode[x + (width * lowY)] == noCell)
+            {
+                lowY--;
+            }
+            int highY = seam;
+            while(cellToNode[x + (width * highY)] == noCell)
+            {
+                highY++;
+            }
+            linkVertical(&(build->nodes[cellToNode[x + (width * lowY)]]),
+                &(build->nodes[cellToNode[x + (width * highY)]]), walkCost(maze, x + (width * lowY), highY - lowY, width));
+        }
+    }
+}
+
+// Runs worker on every band, band 0 on the calling thread and the rest on threads of their own
+// (a band whose thread can not be started runs on the calling thread too)
+static void runBands(BAND_JOB* jobs, int numBands, void* (*worker)(void*))
+{
+    for(int b = 1; b < numBands; b++)
+    {
+        jobs[b].started = pthread_create(&(jobs[b].thread), NULL, worker, &(jobs[b])) == 0;
+    }
+    for(int b = 0; b < numBands; b++)
+    {
+        if(b == 0 || !jobs[b].started)
+        {
+            worker(&(jobs[b]));
+        }
+    }
+    for(int b = 1; b < numBands; b++)
+    {
+        if(jobs[b].started)
+        {
+            pthread_join(jobs[b].thread, NULL);
+        }
+    }
+}
+
+/* CSR LAYOUT */
+
+// Renumbers the NODE graph breadth first and moves it into the CSR arrays (the NODEs are freed)
+static bool nodesToCSR(GRAPH* graph)
+{
+    ARENA* arena = graph->arena;
+    NODE* nodes = graph->nodes;
+    uint32_t numNodes = graph->size;
+    CSR* csr = &(graph->csr);
+
+    // order[k] is the NODE that gets id k, and doubles as the queue
+    uint32_t* newId = malloc(sizeof(uint32_t) * numNodes);
+    uint32_t* order = malloc(sizeof(uint32_t) * numNodes);
+    if(newId == NULL || order == NULL)
+    {
+        free(newId);
+        free(order);
+        return false;
+    }
+    for(uint32_t i = 0; i < numNodes; i++)
+    {
+        newId[i] = noCell;
+    }
+
+    // Out from the start first, then from every node it could not reach (in cell order)
+    uint32_t count = 0;
+    uint32_t head = 0;
+    uint32_t numEdges = 0;
+    for(uint32_t i = 0; i <= numNodes && count < numNodes; i++)
+    {
+        uint32_t root = (i == 0) ? (uint32_t)(graph->start - nodes) : i - 1;
+        if(newId[root] != noCell)
+        {
+            continue;
+        }
+        newId[root] = count;
+        order[count++] = root;
+        while(head < count)
+        {
+            NODE* node = &(nodes[order[head++]]);
+            NODE* links[4] = {node->up, node->down, node->left, node->right};
+            for(int j = 0; j < 4; j++)
+            {
+                if(links[j] == NULL)
+                {
+                    continue;
+                }
+                numEdges++;
+                uint32_t next = links[j] - nodes;
+                if(newId[next] == noCell)
+                {
+                    newId[next] = count;
+                    order[count++] = next;
+                }
+            }
+        }
+    }
+
+    csr->numEdges = numEdges;
+    csr->nodeCell = allocIn(arena, sizeof(uint32_t) * numNodes);
+    csr->cellOrder = allocIn(arena, sizeof(uint32_t) * numNodes);
+    csr->edgeStart = allocIn(arena, sizeof(uint32_t) * ((size_t)numNodes + 1));
+    csr->edgeTarget = allocIn(arena, sizeof(uint32_t) * numEdges);
+    csr->edgeCost = allocIn(arena, sizeof(uint16_t) * numEdges);
+    csr->state = callocIn(arena, numNodes, sizeof(CSR_STATE));
+    bool allocated = csr->nodeCell != NULL && csr->cellOrder != NULL && csr->edgeStart != NULL
+        && csr->edgeTarget != NULL && csr->edgeCost != NULL && csr->state != NULL;
+
+    uint32_t edge = 0;
+    for(uint32_t id = 0; allocated && id < numNodes; id++)
+    {
+        NODE* node = &(nodes[order[id]]);
+        NODE* links[4] = {node->up, node->down, node->left, node->right};
+        uint16_t costs[4] = {node->upCost, node->downCost, node->leftCost, node->rightCost};
+        csr->nodeCell[id] = node->x + (graph->width * node->y);
+        csr->state[id].x = node->x;
+        csr->state[id].y = node->y;
+        csr->state[id].cost = UINT32_MAX;
+        csr->edgeStart[id] = edge;
+        for(int j = 0; j < 4; j++)
+        {
+            if(links[j] != NULL)
+            {
+                csr->edgeTarget[edge] = newId[links[j] - nodes];
+                csr->edgeCost[edge] = costs[j];
+                edge++;
+            }
+        }
+
+        // NODEs were numbered in cell order
+        csr->cellOrder[order[id]] = id;
+    }
+    if(allocated)
+    {
+        csr->edgeStart[numNodes] = edge;
+        csr->startNode = newId[graph->start - nodes];
+        csr->endNode = newId[graph->end - nodes];
+        freeIn(arena, nodes);
+        graph->nodes = NULL;
+        graph->start = NULL;
+        graph->end = NULL;
+    }
+    free(newId);
+    free(order);
+    return allocated;
+}
+
+GRAPH* graphFromMaze(MAZE* maze, GRAPH_MODE mode, int numThreads)
+{
+    if(maze == NULL)
+    {
+        return NULL;
+    }
+
+    int width = maze->width;
+    int height = maze->height;
+    uint32_t area = (uint32_t)width * (uint32_t)height;
+
+    ARENA* arena = maze->arena;
+    GRAPH* toReturn = callocIn(arena, 1, sizeof(GRAPH));
+    if(toReturn == NULL)
+    {
+        freeMaze(&maze);
+        return NULL;
+    }
+    toReturn->arena = arena;
+    toReturn->mode = mode;
+    toReturn->width = width;
+    toReturn->height = height;
+    toReturn->maze = maze;
+    toReturn->startCell = maze->startCell;
+    toReturn->endCell = maze->endCell;
+    toReturn->openCells = maze->openCells;
+
+    if(mode == GRAPH_GRID)
+    {
+        GRID* grid = &(toReturn->grid);
+        grid->width = width;
+        grid->height = height;
+        grid->maze = maze;
+
+        // The search arrays are left for gridSearchState, searches that
+        // never touch them (HPA*) can then run on mazes they would not fit for
+        toReturn->size = maze->openCells;
+        return toReturn;
+    }
+
+    /* GRAPH_FULL and GRAPH_CORRIDOR */
+
+    // Coordinates are stored as uint16_t in NODE
+    if(width > UINT16_MAX || height > UINT16_MAX)
+    {
+        errMsg("graphFromMaze", "Maze is too large for a NODE graph!");
+        freeGraph(&toReturn);
+        return NULL;
+    }
+
+    int numBands = height / minBandRows;
+    numBands = (numThreads < numBands) ? numThreads : numBands;
+    numBands = (numBands > 1) ? numBands : 1;
+
+    // Maps every cell to its node index (noCell for walls and collapsed corridor cells)
+    NODE_BUILD build = {maze, mode, NULL, NULL, numBands, NULL, NULL};
+    build.cellToNode = allocIn(arena, sizeof(uint32_t) * area);
+    build.bandRow = malloc(sizeof(int) * (numBands + 1));
+    build.bandNodes = malloc(sizeof(uint32_t) * numBands);
+    BAND_JOB* jobs = malloc(sizeof(BAND_JOB) * numBands);
+    if(build.cellToNode == NULL || build.bandRow == NULL || build.bandNodes == NULL || jobs == NULL)
+    {
+        freeIn(arena, build.cellToNode);
+        free(build.bandRow);
+        free(build.bandNodes);
+        free(jobs);
+        freeGraph(&toReturn);
+        return NULL;
+    }
+    for(int b = 0; b <= numBands; b++)
+    {
+        build.bandRow[b] = ((int64_t)height * b) / numBands;
+    }
+    for(int b = 0; b < numBands; b++)
+    {
+        jobs[b].build = &build;
+        jobs[b].band = b;
+        jobs[b].started = false;
+    }
+
+    runBands(jobs, numBands, numberBand);
+    uint32_t numNodes = 0;
+    for(int b = 0; b < numBands; b++)
+    {
+        uint32_t count = build.bandNodes[b];
+        build.bandNodes[b] = numNodes;
+        numNodes += count;
+    }
+
+    build.nodes = callocIn(arena, numNodes, sizeof(NODE));
+    if(build.nodes != NULL)
+    {
+        runBands(jobs, numBands, linkBand);
+        stitchSeams(&build);
+    }
+    free(build.bandRow);
+    free(build.bandNodes);
+    free(jobs);
+    if(build.nodes == NULL)
+    {
+        freeIn(arena, build.cellToNode);
+        freeGraph(&toReturn);
+        return NULL;
+    }
+
+    NODE* nodes = build.nodes;
+    uint32_t* cellToNode = build.cellToNode;
+    toReturn->nodes = nodes;
+    toReturn->size = numNodes;
+    toReturn->start = &(nodes[cellToNode[toReturn->startCell]]);
+    toReturn->end = &(nodes[cellToNode[toReturn->endCell]]);
+
+    freeIn(arena, cellToNode);
+
+    toReturn->open = newQueue(numNodes, arena);
+    if(toReturn->open == NULL || (mode == GRAPH_CSR && !nodesToCSR(toReturn)))
+    {
+        freeGraph(&toReturn);
+        return NULL;
+    }
+    return toReturn;
+}
+
+void freeGraph(GRAPH** toFree)
+{
+    GRAPH* temp = (*toFree);
+    if(temp == NULL)
+    {
+        return;
+    }
+    // First, so nothing mapped from a cache file is freed below
+    closeGraphCache(temp);
+
+    ARENA* arena = temp->arena;
+    freeIn(arena, temp->nodes);
+    freeIn(arena, temp->grid.cost);
+    freeIn(arena, temp->grid.from);
+    freeIn(arena, temp->grid.stamp);
+    freeIn(arena, temp->csr.nodeCell);
+    freeIn(arena, temp->csr.cellOrder);
+    freeIn(arena, temp->csr.edgeStart);
+    freeIn(arena, temp->csr.edgeTarget);
+    freeIn(arena, temp->csr.edgeCost);
+    freeIn(arena, temp->csr.state);
+    freeQueue(&(temp->open));
+    freeLandmarks(&(temp->landmarks));
+    freeHPA(&(temp->hpa));
+    freeMaze(&(temp->maze));
+    freeIn(arena, temp);
+    (*toFree) = NULL;
+}
+
+int gridNeighbours(GRID* grid, uint32_t cell, uint32_t neighbours[4])
+{
+    int width = grid->width;
+    int x = cell % width;
+    int y = cell / width;
+    int count = 0;
+
+    // Same order as the NODE pointers: up, down, left, right
+    // The padding bit past the last column is a wall, so right needs no bounds check
+    MAZE* maze = grid->maze;
+    if(y + 1 < grid->height && mazeIsOpen(maze, x, y + 1))
+    {
+        neighbours[count++] = cell + width;
+    }
+    if(y > 0 && mazeIsOpen(maze, x, y - 1))
+    {
+        neighbours[count++] = cell - width;
+    }
+    if(x > 0 && mazeIsOpen(maze, x - 1, y))
+    {
+        neighbours[count++] = cell - 1;
+    }
+    if(mazeIsOpen(maze, x + 1, y))
+    {
+        neighbours[count++] = cell + 1;
+    }
+
+    return count;
+}
+
+bool gridSearchState(GRAPH* graph)
+{
+    if(graph->mode != GRAPH_GRID || graph->open != NULL)
+    {
+        return true;
+    }
+
+    GRID* grid = &(graph->grid);
+    ARENA* arena = graph->arena;
+    uint32_t area = (uint32_t)grid->width * (uint32_t)grid->height;
+    grid->cost = allocIn(arena, sizeof(uint32_t) * area);
+    grid->from = allocIn(arena, sizeof(uint32_t) * area);
+    grid->stamp = allocIn(arena, sizeof(uint32_t) * area);
+    graph->open = newQueue(area, arena);
+    if(grid->cost == NULL || grid->from == NULL || grid->stamp == NULL || graph->open == NULL)
+    {
+        errMsg("gridSearchState", "Could not allocate the grid search arrays!");
+        freeIn(arena, grid->cost);
+        freeIn(arena, grid->from);
+        freeIn(arena, grid->stamp);
+        freeQueue(&(graph->open));
+        grid->cost = NULL;
+        grid->from = NULL;
+        grid->stamp = NULL;
+        return false;
+    }
+    resetGrid(grid);
+    return true;
+}
+
+void resetGrid(GRID* grid)
+{
+    uint32_t area = (uint32_t)grid->width * (uint32_t)grid->height;
+    memset(grid->stamp, 0, sizeof(uint32_t) * area);
+}
+
+uint32_t nextGeneration(GRAPH* graph)
+{
+    // Stamps use two values per generation, so they run out at half the range
+    if(graph->generation >= (UINT32_MAX / 2) - 1)
+    {
+        if(graph->mode == GRAPH_GRID)
+        {
+            resetGrid(&(graph->grid));
+        }
+        for(uint32_t i = 0; graph->nodes != NULL && i < graph->size; i++)
+        {
+            graph->nodes[i].stamp = 0;
+        }
+        for(uint32_t i = 0; graph->csr.state != NULL && i < graph->size; i++)
+        {
+            graph->csr.state[i].stamp = 0;
+        }
+        graph->generation = 0;
+    }
+    graph->generation++;
+    return 2 * graph->generation;
+}
+
+uint32_t cellDistance(uint32_t a, uint32_t b, int width)
+{
+    int dx = (int)(a % width) - (int)(b % width);
+    int dy = (int)(a / width) - (int)(b / width);
+    return abs(dx) + abs(dy);
+}
 
-GRAPH* graphFromBMP(BMP* toConvert)
+NODE* nodeAtCell(GRAPH* graph, uint32_t cell)
 {
+    if(graph->nodes == NULL)
+    {
+        return NULL;
+    }
+
+    // Nodes are created in cell order, so a binary search finds them
+    int width = graph->width;
+    uint32_t low = 0;
+    uint32_t high = graph->size;
+    while(low < high)
+    {
+        uint32_t middle = low + ((high - low) / 2);
+        NODE* node = &(graph->nodes[middle]);
+        uint32_t nodeCell = node->x + (width * node->y);
+        if(nodeCell == cell)
+        {
+            return node;
+        }
+        if(nodeCell < cell)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
     return NULL;
-}
\ No newline at end of file
+}
+
+uint32_t graphIds(GRAPH* graph)
+{
+    if(graph->mode == GRAPH_GRID)
+    {
+        return (uint32_t)graph->width * (uint32_t)graph->height;
+    }
+    return graph->size;
+}
+
+uint32_t cellId(GRAPH* graph, uint32_t cell)
+{
+    if(graph->mode == GRAPH_GRID)
+    {
+        return cell;
+    }
+    if(graph->mode == GRAPH_CSR)
+    {
+        CSR* csr = &(graph->csr);
+        uint32_t low = 0;
+        uint32_t high = graph->size;
+        while(low < high)
+        {
+            uint32_t middle = low + ((high - low) / 2);
+            uint32_t id = csr->cellOrder[middle];
+            if(csr->nodeCell[id] == cell)
+            {
+                return id;
+            }
+            if(csr->nodeCell[id] < cell)
+            {
+                low = middle + 1;
+            }
+            else
+            {
+                high = middle;
+            }
+        }
+        return noCell;
+    }
+    NODE* node = nodeAtCell(graph, cell);
+    return (node == NULL) ? noCell : (uint32_t)(node - graph->nodes);
+}
+
+uint32_t idCell(GRAPH* graph, uint32_t id)
+{
+    if(graph->mode == GRAPH_GRID)
+    {
+        return id;
+    }
+    if(graph->mode == GRAPH_CSR)
+    {
+        return graph->csr.nodeCell[id];
+    }
+    NODE* node = &(graph->nodes[id]);
+    return node->x + (graph->width * node->y);
+}
+
+int idNeighbours(GRAPH* graph, uint32_t id, uint32_t neighbours[4], uint16_t costs[4])
+{
+    if(graph->mode == GRAPH_GRID)
+    {
+        int count = gridNeighbours(&(graph->grid), id, neighbours);
+        for(int i = 0; i < count; i++)
+        {
+            costs[i] = mazeStepCost(graph->maze, id, neighbours[i]);
+        }
+        return count;
+    }
+    if(graph->mode == GRAPH_CSR)
+    {
+        CSR* csr = &(graph->csr);
+        int count = 0;
+        for(uint32_t e = csr->edgeStart[id]; e < csr->edgeStart[id + 1]; e++)
+        {
+            neighbours[count] = csr->edgeTarget[e];
+            costs[count] = csr->edgeCost[e];
+            count++;
+        }
+        return count;
+    }
+
+    NODE* node = &(graph->nodes[id]);
+    NODE* links[4] = {node->up, node->down, node->left, node->right};
+    uint16_t linkCosts[4] = {node->upCost, node->downCost, node->leftCost, node->rightCost};
+    int count = 0;
+    for(int i = 0; i < 4; i++)
+    {
+        if(links[i] != NULL)
+        {
+            neighbours[count] = links[i] - graph->nodes;
+            costs[count] = linkCosts[i];
+            count++;
+        }
+    }
+    return count;
+}
+
+bool solveGraph(GRAPH* graph, PATH* path, SEARCH_STATS* stats)
+{
+    if(graph == NULL)
+    {
+        return false;
+    }
+    return solveBetween(graph, graph->startCell, graph->endCell, path, stats);
+}
+
+bool solveBetween(GRAPH* graph, uint32_t startCell, uint32_t endCell, PATH* path, SEARCH_STATS* stats)
+{
+    if(graph == NULL || path == NULL)
+    {
+        return false;
+    }
+    uint32_t area = (uint32_t)graph->width * (uint32_t)graph->height;
+    if(startCell >= area || endCell >= area || !mazeCellIsOpen(graph->maze, startCell) || !mazeCellIsOpen(graph->maze, endCell))
+    {
+        errMsg("solveBetween", "Start and end have to be open cells!");
+        return false;
+    }
+
+    if(graph->mode == GRAPH_GRID)
+    {
+        return solveGrid(graph, startCell, endCell, path, stats);
+    }
+    if(graph->mode == GRAPH_CSR)
+    {
+        uint32_t startId = cellId(graph, startCell);
+        uint32_t endId = cellId(graph, endCell);
+        if(startId == noCell || endId == noCell)
+        {
+            errMsg("solveBetween", "Start and end have to be graph nodes (not the middle of a corridor)!");
+            return false;
+        }
+        return solveCSR(graph, startId, endId, path, stats);
+    }
+
+    NODE* start = nodeAtCell(graph, startCell);
+    NODE* end = nodeAtCell(graph, endCell);
+    if(start == NULL || end == NULL)
+    {
+        errMsg("solveBetween", "Start and end have to be graph nodes (not the middle of a corridor)!");
+        return false;
+    }
+    return solveNodes(graph, start, end, path, stats);
+}
+
+uint32_t solveQueries(GRAPH* graph, QUERY* queries, uint32_t count)
+{
+    uint32_t found = 0;
+    for(uint32_t i = 0; i < count; i++)
+    {
+        QUERY* query = &(queries[i]);
+        SEARCH_STATS stats = {0};
+        freePath(&(query->path));
+        query->found = solveBetween(graph, query->startCell, query->endCell, &(query->path), &stats);
+        query->expanded = stats.expanded;
+        found += query->found;
+    }
+    return found;
+}
+
+bool solveNodes(GRAPH* graph, NODE* start, NODE* end, PATH* path, SEARCH_STATS* stats)
+{
+    NODE* nodes = graph->nodes;
+    int width = graph->width;
+
+    // The queue can still hold nodes from the last search if it stopped early
+    PQUEUE* open = graph->open;
+    queueClear(open);
+
+    // Nodes with an older stamp have not been touched by this search yet
+    uint32_t touched = nextGeneration(graph);
+    uint32_t closed = touched + 1;
+
+    LANDMARKS* landmarks = graph->landmarks;
+    uint32_t endId = end - nodes;
+
+    uint64_t expanded = 0;
+    start->stamp = touched;
+    start->cost = 0;
+    start->from = NULL;
+    queuePush(open, start - nodes, 0);
+
+    while(!queueEmpty(open))
+    {
+        NODE* current = &(nodes[queuePop(open)]);
+        current->stamp = closed;
+        expanded++;
+        if(current == end)
+        {
+            break;
+        }
+
+        NODE* neighbours[4] = {current->up, current->down, current->left, current->right};
+        uint16_t stepCosts[4] = {current->upCost, current->downCost, current->leftCost, current->rightCost};
+        for(int i = 0; i < 4; i++)
+        {
+            NODE* next = neighbours[i];
+            if(next == NULL || next->stamp == closed)
+            {
+                continue;
+            }
+            uint32_t newCost = current->cost + stepCosts[i];
+            if(next->stamp == touched && newCost >= next->cost)
+            {
+                continue;
+            }
+            next->stamp = touched;
+            next->cost = newCost;
+            next->from = current;
+
+            // Manhattan distance works as a heuristic because every edge is a straight line
+            uint32_t id = next - nodes;
+            uint32_t estimate = abs((int)next->x - (int)end->x) + abs((int)next->y - (int)end->y);
+            if(landmarks != NULL)
+            {
+                uint32_t bound = landmarkBound(landmarks, id, endId);
+                estimate = (bound > estimate) ? bound : estimate;
+            }
+            uint32_t key = newCost + estimate;
+            bool queued = queueContains(open, id) ? queueDecrease(open, id, key) : queuePush(open, id, key);
+            if(!queued)
+            {
+                errMsg("solveGraph", "Open set ran out of memory!");
+                return false;
+            }
+        }
+    }
+
+    if(stats != NULL)
+    {
+        stats->expanded = expanded;
+        stats->forwardExpanded = expanded;
+        stats->backwardExpanded = 0;
+    }
+    if(end->stamp != closed)
+    {
+        return false;
+    }
+
+    // Walk back from the end to count the path, then fill it in from the back
+    uint32_t length = 0;
+    for(NODE* current = end; current != NULL; current = current->from)
+    {
+        length++;
+    }
+    path->arena = graph->arena;
+    path->cells = allocIn(path->arena, sizeof(uint32_t) * length);
+    if(path->cells == NULL)
+    {
+        return false;
+    }
+    path->length = length;
+    path->cost = end->cost;
+    for(NODE* current = end; current != NULL; current = current->from)
+    {
+        length--;
+        path->cells[length] = current->x + (width * current->y);
+    }
+
+    return true;
+}
+
+bool solveGrid(GRAPH* graph, uint32_t startCell, uint32_t endCell, PATH* path, SEARCH_STATS* stats)
+{
+    if(!gridSearchState(graph))
+    {
+        return false;
+    }
+    GRID* grid = &(graph->grid);
+    int width = grid->width;
+
+    PQUEUE* open = graph->open;
+    queueClear(open);
+
+    uint32_t touched = nextGeneration(graph);
+    uint32_t closed = touched + 1;
+
+    LANDMARKS* landmarks = graph->landmarks;
+
+    uint64_t expanded = 0;
+    grid->stamp[startCell] = touched;
+    grid->cost[startCell] = 0;
+    grid->from[startCell] = noCell;
+    queuePush(open, startCell, 0);
+
+    uint32_t neighbours[4];
+    while(!queueEmpty(open))
+    {
+        uint32_t current = queuePop(open);
+        grid->stamp[current] = closed;
+        expanded++;
+        if(current == endCell)
+        {
+            break;
+        }
+
+        uint32_t currentCost = grid->cost[current];
+        int count = gridNeighbours(grid, current, neighbours);
+        for(int i = 0; i < count; i++)
+        {
+            uint32_t next = neighbours[i];
+            uint32_t newCost = currentCost + mazeStepCost(grid->maze, current, next);
+            uint32_t stamp = grid->stamp[next];
+            if(stamp == closed || (stamp == touched && newCost >= grid->cost[next]))
+            {
+                continue;
+            }
+            grid->stamp[next] = touched;
+            grid->cost[next] = newCost;
+            grid->from[next] = current;
+
+            uint32_t estimate = cellDistance(next, endCell, width);
+            if(landmarks != NULL)
+            {
+                uint32_t bound = landmarkBound(landmarks, next, endCell);
+                estimate = (bound > estimate) ? bound : estimate;
+            }
+            uint32_t key = newCost + estimate;
+            bool queued = queueContains(open, next) ? queueDecrease(open, next, key) : queuePush(open, next, key);
+            if(!queued)
+            {
+                errMsg("solveGraph", "Open set ran out of memory!");
+                return false;
+            }
+        }
+    }
+
+    if(stats != NULL)
+    {
+        stats->expanded = expanded;
+        stats->forwardExpanded = expanded;
+        stats->backwardExpanded = 0;
+    }
+    if(grid->stamp[endCell] != closed)
+    {
+        return false;
+    }
+
+    // Walk back from the end to count the path (cost + 1 cells, unless the maze is weighted)
+    uint32_t length = 0;
+    for(uint32_t current = endCell; current != noCell; current = grid->from[current])
+    {
+        length++;
+    }
+    path->arena = graph->arena;
+    path->cells = allocIn(path->arena, sizeof(uint32_t) * length);
+    if(path->cells == NULL)
+    {
+        return false;
+    }
+    path->length = length;
+    path->cost = grid->cost[endCell];
+    uint32_t current = endCell;
+    for(uint32_t i = length; i > 0; i--)
+    {
+        path->cells[i - 1] = current;
+        current = grid->from[current];
+    }
+
+    return true;
+}
+
+bool solveCSR(GRAPH* graph, uint32_t startId, uint32_t endId, PATH* path, SEARCH_STATS* stats)
+{
+    CSR* csr = &(graph->csr);
+    CSR_STATE* state = csr->state;
+
+    PQUEUE* open = graph->open;
+    queueClear(open);
+
+    uint32_t touched = nextGeneration(graph);
+    uint32_t closed = touched + 1;
+
+    LANDMARKS* landmarks = graph->landmarks;
+    int endX = state[endId].x;
+    int endY = state[endId].y;
+
+    uint64_t expanded = 0;
+    state[startId].stamp = touched;
+    state[startId].cost = 0;
+    state[startId].from = noCell;
+    queuePush(open, startId, 0);
+
+    while(!queueEmpty(open))
+    {
+        uint32_t current = queuePop(open);
+        state[current].stamp = closed;
+        expanded++;
+        if(current == endId)
+        {
+            break;
+        }
+
+        uint32_t currentCost = state[current].cost;
+        uint32_t lastEdge = csr->edgeStart[current + 1];
+        for(uint32_t e = csr->edgeStart[current]; e < lastEdge; e++)
+        {
+            uint32_t next = csr->edgeTarget[e];
+            CSR_STATE* nextState = &(state[next]);
+            if(nextState->stamp == closed)
+            {
+                continue;
+            }
+            uint32_t newCost = currentCost + csr->edgeCost[e];
+            if(nextState->stamp == touched && newCost >= nextState->cost)
+            {
+                continue;
+            }
+            nextState->stamp = touched;
+            nextState->cost = newCost;
+            nextState->from = current;
+
+            uint32_t estimate = abs((int)nextState->x - endX) + abs((int)nextState->y - endY);
+            if(landmarks != NULL)
+            {
+                uint32_t bound = landmarkBound(landmarks, next, endId);
+                estimate = (bound > estimate) ? bound : estimate;
+            }
+            uint32_t key = newCost + estimate;
+            bool queued = queueContains(open, next) ? queueDecrease(open, next, key) : queuePush(open, next, key);
+            if(!queued)
+            {
+                errMsg("solveGraph", "Open set ran out of memory!");
+                return false;
+            }
+        }
+    }
+
+    if(stats != NULL)
+    {
+        stats->expanded = expanded;
+        stats->forwardExpanded = expanded;
+        stats->backwardExpanded = 0;
+    }
+    if(state[endId].stamp != closed)
+    {
+        return false;
+    }
+
+    // Walk back from the end to count the path, then fill it in from the back
+    uint32_t length = 0;
+    for(uint32_t current = endId; current != noCell; current = state[current].from)
+    {
+        length++;
+    }
+    path->arena = graph->arena;
+    path->cells = allocIn(path->arena, sizeof(uint32_t) * length);
+    if(path->cells == NULL)
+    {
+        return false;
+    }
+    path->length = length;
+    path->cost = state[endId].cost;
+    for(uint32_t current = endId; current != noCell; current = state[current].from)
+    {
+        length--;
+        path->cells[length] = csr->nodeCell[current];
+    }
+
+    return true;
+}
+
+void freePath(PATH* toFree)
+{
+    if(toFree == NULL)
+    {
+        return;
+    }
+    freeIn(toFree->arena, toFree->cells);
+    toFree->cells = NULL;
+    toFree->length = 0;
+}
+
+bool drawPath(BMP* toDraw, PATH* path, uint32_t color)
+{
+    if(toDraw == NULL || path == NULL || toDraw->data.colorData == NULL)
+    {
+        return false;
+    }
+
+    // Indexed bitmaps have no color to draw with
+    if(toDraw->data.HasCTable || toDraw->data.bitDepth < 16)
+    {
+        errMsg("drawPath", "Paths can only be drawn on 16, 24 or 32 bit bitmaps!");
+        return false;
+    }
+
+    int width = toDraw->data.width;
+    for(uint32_t i = 0; i < path->length; i++)
+    {
+        uint32_t current = path->cells[i];
+        toDraw->data.colorData[current].value = color;
+        if(i + 1 == path->length)
+        {
+            break;
+        }
+
+        // Fill in the straight line to the next cell
+        uint32_t next = path->cells[i + 1];
+        int step = 0;
+        if(next / width == current / width)
+        {
+            step = (next > current) ? 1 : -1;
+        }
+        else
+        {
+            step = (next > current) ? width : -width;
+        }
+        while(current != next)
+        {
+            current += step;
+            toDraw->data.colorData[current].value = color;
+        }
+    }
+
+    return true;
+}
+
+uint64_t* pathMask(PATH* path, int width, int height)
+{
+    if(path == NULL || width <= 0 || height <= 0)
+    {
+        return NULL;
+    }
+    size_t area = (size_t)width * height;
+    uint64_t* toReturn = calloc((area + 63) / 64, sizeof(uint64_t));
+    if(toReturn == NULL)
+    {
+        return NULL;
+    }
+
+    // Same walk as drawPath, filling in the straight line between path cells
+    for(uint32_t i = 0; i < path->length; i++)
+    {
+        uint32_t current = path->cells[i];
+        uint32_t next = (i + 1 < path->length) ? path->cells[i + 1] : current;
+        int step = 0;
+        if(next / width == current / width)
+        {
+            step = (next > current) ? 1 : -1;
+        }
+        else
+        {
+            step = (next > current) ? width : -width;
+        }
+        toReturn[current >> 6] |= (uint64_t)1 << (current & 63);
+        while(current != next)
+        {
+            current += step;
+            toReturn[current >> 6] |= (uint64_t)1 << (current & 63);
+        }
+    }
+
+    return toReturn;
+}
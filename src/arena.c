@@ -0,0 +1,159 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "arena.h"
+
+ARENA* newArena(size_t blockSize)
+{
+    ARENA* toReturn = calloc(1, sizeof(ARENA));
+    if(toReturn == NULL)
+    {
+        return NULL;
+    }
+    toReturn->blockSize = (blockSize > 0) ? blockSize : 1 << 20;
+    return toReturn;
+}
+
+void freeArena(ARENA** toFree)
+{
+    ARENA* temp = (*toFree);
+    if(temp == NULL)
+    {
+        return;
+    }
+    ARENA_BLOCK* block = temp->first;
+    while(block != NULL)
+    {
+        ARENA_BLOCK* next = block->next;
+        free(block);
+        block = next;
+    }
+    free(temp);
+    (*toFree) = NULL;
+}
+
+// Adds a block big enough for size right after the current one
+static ARENA_BLOCK* addBlock(ARENA* arena, size_t size)
+{
+    size_t blockSize = arena->blockSize;
+    if(arena->current != NULL)
+    {
+        blockSize = arena->current->size * 2;
+    }
+    while(blockSize < size)
+    {
+        blockSize *= 2;
+    }
+
+    ARENA_BLOCK* block = malloc(arenaHeaderSize + blockSize);
+    if(block == NULL)
+    {
+        return NULL;
+    }
+    block->size = blockSize;
+    block->used = 0;
+    arena->reserved += blockSize;
+
+    if(arena->current == NULL)
+    {
+        block->next = arena->first;
+        arena->first = block;
+    }
+    else
+    {
+        block->next = arena->current->next;
+        arena->current->next = block;
+    }
+    return block;
+}
+
+void* arenaAlloc(ARENA* arena, size_t size)
+{
+    size = (size + arenaAlign - 1) & ~(size_t)(arenaAlign - 1);
+
+    ARENA_BLOCK* block = arena->current;
+    if(block == NULL || block->size - block->used < size)
+    {
+        // Blocks after current are empty, use the next one if it is big enough
+        ARENA_BLOCK* next = (block == NULL) ? arena->first : block->next;
+        if(next == NULL || next->size < size)
+        {
+            next = addBlock(arena, size);
+            if(next == NULL)
+            {
+                return NULL;
+            }
+        }
+        next->used = 0;
+        arena->current = next;
+        block = next;
+    }
+
+    void* toReturn = (uint8_t*)block + arenaHeaderSize + block->used;
+    block->used += size;
+    return toReturn;
+}
+
+void arenaReset(ARENA* arena)
+{
+    if(arena == NULL)
+    {
+        return;
+    }
+    arena->current = NULL;
+}
+
+ARENA_MARK arenaMark(ARENA* arena)
+{
+    ARENA_MARK mark = {NULL, 0};
+    if(arena != NULL && arena->current != NULL)
+    {
+        mark.block = arena->current;
+        mark.used = arena->current->used;
+    }
+    return mark;
+}
+
+void arenaRelease(ARENA* arena, ARENA_MARK mark)
+{
+    if(arena == NULL)
+    {
+        return;
+    }
+    arena->current = mark.block;
+    if(mark.block != NULL)
+    {
+        mark.block->used = mark.used;
+    }
+}
+
+void* allocIn(ARENA* arena, size_t size)
+{
+    if(arena == NULL)
+    {
+        return malloc(size);
+    }
+    return arenaAlloc(arena, size);
+}
+
+void* callocIn(ARENA* arena, size_t count, size_t size)
+{
+    if(arena == NULL)
+    {
+        return calloc(count, size);
+    }
+    void* toReturn = arenaAlloc(arena, count * size);
+    if(toReturn != NULL)
+    {
+        memset(toReturn, 0, count * size);
+    }
+    return toReturn;
+}
+
+void freeIn(ARENA* arena, void* toFree)
+{
+    if(arena == NULL)
+    {
+        free(toFree);
+    }
+}
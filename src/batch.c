@@ -0,0 +1,1062 @@
+// Needed for pthreads and clock_gettime under -std=c99
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "batch.h"
+#include "algos.h"
+#include "bmp.h"
+#include "bidir.h"
+#include "jps.h"
+#include "hpa.h"
+#include "bmpstream.h"
+#include "graphcache.h"
+#include "stats.h"
+#include "distances.h"
+#include "replan.h"
+#include "solvecache.h"
+
+double nowMs()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec * 1000.0) + (now.tv_nsec / 1e6);
+}
+
+LANDMARKS* landmarksFor(GRAPH* graph, char* inName, uint32_t count, bool* loaded)
+{
+    *loaded = false;
+    char altName[longestPath];
+    bool named = landmarkFileName(inName, altName, sizeof(altName));
+    if(named)
+    {
+        LANDMARKS* landmarks = loadLandmarks(graph, altName);
+        if(landmarks != NULL && landmarks->count == count)
+        {
+            *loaded = true;
+            return landmarks;
+        }
+        freeLandmarks(&landmarks);
+    }
+
+    LANDMARKS* landmarks = buildLandmarks(graph, count);
+    if(landmarks != NULL && named)
+    {
+        saveLandmarks(graph, landmarks, altName);
+    }
+    return landmarks;
+}
+
+bool solveWith(GRAPH* graph, SEARCH_MODE search, PATH* path, SEARCH_STATS* stats)
+{
+    switch(search)
+    {
+        case SEARCH_BIDIR: return solveBidirectional(graph, path, stats, false);
+        case SEARCH_BIDIR_THREADED: return solveBidirectional(graph, path, stats, true);
+        case SEARCH_JPS: return solveJPS(graph, path, stats);
+        case SEARCH_HPA: return solveHPA(graph, graph->startCell, graph->endCell, path, stats);
+        default: return solveGraph(graph, path, stats);
+    }
+}
+
+// Key of a mapped maze in the solve cache, false if it has no openings
+static bool solveKey(BMP* maze, SOLVE_OPTIONS* options, SOLVE_KEY* key)
+{
+    memset(key, 0, sizeof(SOLVE_KEY));
+    if(!bmpEndpoints(maze, options->costTable, &(key->startCell), &(key->endCell)))
+    {
+        return false;
+    }
+    key->payload = bmpPayloadHash(maze);
+
+    // FNV-1a over the options that change which path comes out
+    uint64_t hash = 14695981039346656037ULL;
+    COST_TABLE* table = options->costTable;
+    uint64_t settings[5] = {(uint64_t)options->mode, (uint64_t)options->search,
+        (options->search == SEARCH_HPA) ? options->clusterSize : 0, table != NULL, (table != NULL) && table->byIndex};
+    for(int i = 0; i < 5; i++)
+    {
+        hash = (hash ^ settings[i]) * 1099511628211ULL;
+    }
+    for(int i = 0; table != NULL && i < costLevels; i++)
+    {
+        hash = (hash ^ table->cost[i]) * 1099511628211ULL;
+    }
+    key->settings = hash;
+    return true;
+}
+
+// Writes the path over a width x height maze to outName (maze is NULL in stream mode, where the file is read again)
+static void writeSolution(char* inName, char* outName, SOLVE_OPTIONS* options, BMP* maze, PATH* path,
+    int width, int height, SOLVE_RESULT* result)
+{
+    double stageStart = nowMs();
+    if(outName != NULL && options->stream)
+    {
+        // The input is read a second time, a window at a time, instead of being kept around
+        uint64_t* marked = result->solved ? pathMask(path, width, height) : NULL;
+        if(marked != NULL || !result->solved)
+        {
+            result->written = streamCopyBMP(inName, outName, marked, 0xFF0000);
+        }
+        free(marked);
+    }
+    else if(outName != NULL)
+    {
+        if(readData(maze))
+        {
+            if(result->solved)
+            {
+                drawPath(maze, path, 0xFF0000);
+            }
+            result->written = options->mapWrite ? mapWriteBMP(maze, outName) : writeBMP(maze, outName);
+        }
+    }
+    result->writeMs = nowMs() - stageStart;
+}
+
+bool solveMazeFile(char* inName, char* outName, SOLVE_OPTIONS* options, SOLVE_RESULT* result, ARENA* arena)
+{
+    if(inName == NULL || options == NULL || result == NULL)
+    {
+        return false;
+    }
+    memset(result, 0, sizeof(SOLVE_RESULT));
+    arenaReset(arena);
+
+    // The graph is built straight from the mapped file, pixels are only decoded for the output
+    // Streams read the rows while the wall bitset is built, so loading is part of the build time
+    double stageStart = nowMs();
+    BMP* maze = NULL;
+    if(!options->stream)
+    {
+        maze = mapBMP(inName);
+    }
+
+    // A path from the solve cache skips everything but the output
+    // (streams never have all of the pixels mapped to hash, so they always miss)
+    PATH path = {0};
+    SOLVE_KEY key;
+    bool keyed = maze != NULL && options->solveCache != NULL && solveKey(maze, options, &key);
+    if(keyed && solveCacheFind(options->solveCache, &key, &path, arena))
+    {
+        result->loadMs = nowMs() - stageStart;
+        result->loaded = true;
+        result->solved = true;
+        result->solveCached = true;
+        result->pathCost = path.cost;
+        writeSolution(inName, outName, options, maze, &path, maze->data.width, maze->data.height, result);
+        freePath(&path);
+        freeBMP(&maze);
+        if(arena != NULL)
+        {
+            result->arenaBytes = arena->reserved;
+        }
+        return true;
+    }
+
+    // An up to date graph cache skips decoding and building (the bitmap is still mapped for the output)
+    // Cell costs are not in the cache file, so weighted mazes are always decoded to check it
+    GRAPH* graph = NULL;
+    if(options->graphCache && options->costTable == NULL)
+    {
+        graph = loadGraphCache(inName, options->mode, NULL, arena);
+    }
+    BMP_STREAM* stream = NULL;
+    if(options->stream && graph == NULL)
+    {
+        stream = openBMPStream(inName, 0);
+    }
+    result->loadMs = nowMs() - stageStart;
+    if(options->stream ? (stream == NULL && graph == NULL) : (maze == NULL))
+    {
+        freeGraph(&graph);
+        return false;
+    }
+    result->loaded = true;
+
+    stageStart = nowMs();
+    result->cacheLoaded = graph != NULL;
+    if(graph == NULL)
+    {
+        MAZE* walls = NULL;
+        if(stream != NULL)
+        {
+            walls = mazeFromStream(stream, options->costTable, arena);
+            closeBMPStream(&stream);
+        }
+        else
+        {
+            maze->arena = arena;
+            walls = mazeFromBMP(maze, options->costTable, arena);
+        }
+
+        // The cache still holds for a file that was only touched or copied, as long as the walls match
+        if(options->graphCache && walls != NULL)
+        {
+            graph = loadGraphCache(inName, options->mode, walls, arena);
+            result->cacheLoaded = graph != NULL;
+        }
+        if(graph == NULL)
+        {
+            graph = graphFromMaze(walls, options->mode, options->buildThreads);
+            if(graph != NULL && options->graphCache)
+            {
+                saveGraphCache(graph, inName);
+            }
+        }
+    }
+    result->buildMs = nowMs() - stageStart;
+    if(graph == NULL)
+    {
+        freeBMP(&maze);
+        return false;
+    }
+    result->openCells = graph->openCells;
+    result->graphNodes = graph->size;
+    result->mazeBytes = mazeBytes(graph->maze);
+
+    if(options->landmarks > 0)
+    {
+        stageStart = nowMs();
+        graph->landmarks = landmarksFor(graph, inName, options->landmarks, &(result->landmarksLoaded));
+        result->landmarkMs = nowMs() - stageStart;
+        if(graph->landmarks != NULL)
+        {
+            result->landmarkBytes = landmarkBytes(graph->landmarks);
+        }
+    }
+
+    if(options->search == SEARCH_HPA)
+    {
+        stageStart = nowMs();
+        graph->hpa = buildHPA(graph, options->clusterSize, options->buildThreads);
+        result->hpaMs = nowMs() - stageStart;
+        if(graph->hpa != NULL)
+        {
+            result->hpaNodes = graph->hpa->numNodes;
+            result->hpaBytes = hpaBytes(graph->hpa);
+        }
+    }
+
+    // Grid search arrays come from the arena before the mark, so repeats do not hand them back
+    // (HPA* never uses them)
+    if(options->search != SEARCH_HPA && !gridSearchState(graph))
+    {
+        freeGraph(&graph);
+        freeBMP(&maze);
+        return false;
+    }
+
+    SEARCH_STATS stats = {0};
+    int repeat = (options->repeat > 0) ? options->repeat : 1;
+    // Every repeat gets the same arena space back
+    ARENA_MARK searchMark = arenaMark(arena);
+    stageStart = nowMs();
+    for(int i = 0; i < repeat; i++)
+    {
+        freePath(&path);
+        arenaRelease(arena, searchMark);
+        result->solved = solveWith(graph, options->search, &path, &stats);
+    }
+    result->searchMs = (nowMs() - stageStart) / repeat;
+    result->expanded = stats.expanded;
+    result->forwardExpanded = stats.forwardExpanded;
+    result->backwardExpanded = stats.backwardExpanded;
+    result->pathCost = path.cost;
+    int width = graph->width;
+    int height = graph->height;
+    if(keyed && result->solved)
+    {
+        solveCacheStore(options->solveCache, &key, &path, width);
+    }
+    freeGraph(&graph);
+
+    writeSolution(inName, outName, options, maze, &path, width, height, result);
+    freePath(&path);
+    freeBMP(&maze);
+    if(arena != NULL)
+    {
+        result->arenaBytes = arena->reserved;
+    }
+    return result->solved;
+}
+
+/* MULTI QUERY */
+
+// xorshift32, so runs with the same seed ask the same questions everywhere
+static uint32_t nextRandom(uint32_t* state)
+{
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+// Picks a random cell that solveBetween accepts as an endpoint
+static uint32_t randomEndpoint(GRAPH* graph, uint32_t* state)
+{
+    if(graph->mode != GRAPH_GRID)
+    {
+        // The k-th node in cell order, so GRAPH_CSR gets the same questions as GRAPH_CORRIDOR
+        uint32_t k = nextRandom(state) % graph->size;
+        return idCell(graph, (graph->mode == GRAPH_CSR) ? graph->csr.cellOrder[k] : k);
+    }
+
+    uint32_t area = (uint32_t)graph->width * (uint32_t)graph->height;
+    while(true)
+    {
+        uint32_t cell = nextRandom(state) % area;
+        if(mazeCellIsOpen(graph->maze, cell))
+        {
+            return cell;
+        }
+    }
+}
+
+// solveQueries on the cluster abstraction in graph->hpa
+static uint32_t solveQueriesHPA(GRAPH* graph, QUERY* queries, uint32_t count)
+{
+    uint32_t found = 0;
+    for(uint32_t i = 0; i < count; i++)
+    {
+        QUERY* query = &(queries[i]);
+        SEARCH_STATS stats = {0};
+        freePath(&(query->path));
+        query->found = solveHPA(graph, query->startCell, query->endCell, &(query->path), &stats);
+        query->expanded = stats.expanded;
+        found += query->found;
+    }
+    return found;
+}
+
+bool runQueries(char* inName, SOLVE_OPTIONS* options, uint32_t count, uint32_t seed)
+{
+    if(inName == NULL || options == NULL || count == 0)
+    {
+        return false;
+    }
+
+    BMP* maze = mapBMP(inName);
+    if(maze == NULL)
+    {
+        return false;
+    }
+    double buildStart = nowMs();
+    GRAPH* graph = graphFromMaze(mazeFromBMP(maze, options->costTable, NULL), options->mode, options->buildThreads);
+    double buildMs = nowMs() - buildStart;
+    freeBMP(&maze);
+    if(graph == NULL)
+    {
+        return false;
+    }
+
+    QUERY* queries = calloc(count, sizeof(QUERY));
+    if(queries == NULL)
+    {
+        freeGraph(&graph);
+        return false;
+    }
+    uint32_t state = (seed != 0) ? seed : 1;
+    for(uint32_t i = 0; i < count; i++)
+    {
+        queries[i].startCell = randomEndpoint(graph, &state);
+        queries[i].endCell = randomEndpoint(graph, &state);
+    }
+
+    printf("Graph build: %.3f ms, %u graph nodes\n", buildMs, graph->size);
+
+    // Same questions plain, and then with the landmark tables or on the cluster abstraction
+    bool withHPA = options->search == SEARCH_HPA;
+    uint32_t* plainCosts = malloc(sizeof(uint32_t) * count);
+    if(plainCosts == NULL)
+    {
+        free(queries);
+        freeGraph(&graph);
+        return false;
+    }
+    uint32_t plainFound = 0;
+    uint64_t plainCost = 0;
+    double plainMs = 0;
+    bool matched = true;
+    for(int pass = 0; pass < 2; pass++)
+    {
+        if(pass == 1 && withHPA)
+        {
+            double hpaStart = nowMs();
+            graph->hpa = buildHPA(graph, options->clusterSize, options->buildThreads);
+            if(graph->hpa == NULL)
+            {
+                errMsg("runQueries", "Could not build the cluster abstraction!");
+                matched = false;
+                break;
+            }
+            HPA* hpa = graph->hpa;
+            int hpaThreads = (options->buildThreads > 1) ? options->buildThreads : 1;
+            printf("Clusters: %ux%u of %u pixels, abstract nodes: %u, tables: %.1f KB, built in %.3f ms on %d thread%s\n",
+                hpa->clustersX, hpa->clustersY, hpa->clusterSize, hpa->numNodes, hpaBytes(hpa) / 1024.0,
+                nowMs() - hpaStart, hpaThreads, (hpaThreads == 1) ? "" : "s");
+        }
+        else if(pass == 1)
+        {
+            if(options->landmarks == 0)
+            {
+                break;
+            }
+            bool loaded = false;
+            double landmarkStart = nowMs();
+            graph->landmarks = landmarksFor(graph, inName, options->landmarks, &loaded);
+            if(graph->landmarks == NULL)
+            {
+                errMsg("runQueries", "Could not build landmark tables!");
+                break;
+            }
+            printf("Landmarks: %u, tables: %.1f KB, %s in %.3f ms\n", options->landmarks,
+                landmarkBytes(graph->landmarks) / 1024.0, loaded ? "loaded" : "built", nowMs() - landmarkStart);
+        }
+
+        double queryStart = nowMs();
+        uint32_t found = (pass == 1 && withHPA) ? solveQueriesHPA(graph, queries, count) : solveQueries(graph, queries, count);
+        double queryMs = nowMs() - queryStart;
+
+        uint64_t expanded = 0;
+        uint64_t pathCost = 0;
+        double worstExcess = 0;
+        for(uint32_t i = 0; i < count; i++)
+        {
+            expanded += queries[i].expanded;
+            pathCost += queries[i].path.cost;
+            if(pass == 0)
+            {
+                plainCosts[i] = queries[i].path.cost;
+            }
+            else if(queries[i].found && plainCosts[i] > 0)
+            {
+                double excess = ((double)queries[i].path.cost / plainCosts[i]) - 1;
+                worstExcess = (excess > worstExcess) ? excess : worstExcess;
+            }
+            freePath(&(queries[i].path));
+        }
+
+        const char* name = (pass == 0) ? (withHPA ? "Flat A*" : "Manhattan") : (withHPA ? "HPA*" : "ALT");
+        printf("%s queries: %u, paths found: %u, total path length: %llu\n", name,
+            count, found, (unsigned long long)pathCost);
+        printf("Query time: %.3f ms total, %.2f us per query, %.1f nodes expanded per query\n",
+            queryMs, 1000.0 * queryMs / count, (double)expanded / count);
+        if(pass == 0)
+        {
+            plainFound = found;
+            plainCost = pathCost;
+            plainMs = queryMs;
+        }
+        else if(withHPA)
+        {
+            // HPA* paths may be longer, but it has to find one whenever there is one
+            matched = found == plainFound;
+            printf("Speedup: %.2fx, path length: +%.2f%% in total, +%.2f%% at worst%s\n", plainMs / queryMs,
+                (plainCost > 0) ? 100.0 * ((double)pathCost / plainCost - 1) : 0.0, 100.0 * worstExcess,
+                matched ? "" : " (PATHS MISSING)");
+        }
+        else
+        {
+            matched = pathCost == plainCost;
+            printf("Speedup: %.2fx%s\n", plainMs / queryMs, matched ? "" : " (PATH LENGTHS DIFFER)");
+        }
+    }
+
+    free(plainCosts);
+    free(queries);
+    freeGraph(&graph);
+    return matched;
+}
+
+bool runDistances(char* inName, SOLVE_OPTIONS* options, uint32_t count, int numThreads, uint32_t seed, char* matrixName)
+{
+    if(inName == NULL || options == NULL || count == 0)
+    {
+        return false;
+    }
+
+    BMP* maze = mapBMP(inName);
+    if(maze == NULL)
+    {
+        return false;
+    }
+    double buildStart = nowMs();
+    GRAPH* graph = graphFromMaze(mazeFromBMP(maze, options->costTable, NULL), options->mode, options->buildThreads);
+    double buildMs = nowMs() - buildStart;
+    freeBMP(&maze);
+    uint32_t* points = malloc(sizeof(uint32_t) * count);
+    uint32_t* plainCosts = malloc(sizeof(uint32_t) * count);
+    uint32_t* distances = malloc(sizeof(uint32_t) * count);
+    if(graph == NULL || !gridSearchState(graph) || points == NULL || plainCosts == NULL || distances == NULL)
+    {
+        free(points);
+        free(plainCosts);
+        free(distances);
+        freeGraph(&graph);
+        return false;
+    }
+    uint32_t state = (seed != 0) ? seed : 1;
+    for(uint32_t i = 0; i < count; i++)
+    {
+        points[i] = randomEndpoint(graph, &state);
+    }
+    printf("Graph build: %.3f ms, %u graph nodes\n", buildMs, graph->size);
+
+    // One to many, A* once per goal against one sweep that stops at the last goal
+    uint64_t plainExpanded = 0;
+    double plainStart = nowMs();
+    for(uint32_t i = 0; i < count; i++)
+    {
+        PATH path = {0};
+        SEARCH_STATS stats = {0};
+        plainCosts[i] = solveBetween(graph, points[0], points[i], &path, &stats) ? path.cost : noDistance;
+        plainExpanded += stats.expanded;
+        freePath(&path);
+    }
+    double plainMs = nowMs() - plainStart;
+
+    DISTANCE_SWEEP* sweep = newDistanceSweep(graph);
+    DISTANCE_TARGETS* targets = newDistanceTargets(graph, points, count);
+    SEARCH_STATS sweepStats = {0};
+    double sweepStart = nowMs();
+    bool matched = sweep != NULL && targets != NULL && sweepDistances(graph, sweep, points[0], targets, distances, &sweepStats);
+    double sweepMs = nowMs() - sweepStart;
+    freeDistanceSweep(&sweep);
+    freeDistanceTargets(&targets);
+    matched = matched && memcmp(plainCosts, distances, sizeof(uint32_t) * count) == 0;
+    printf("One to many: %u goals, A* per goal %.3f ms (%llu expanded), one sweep %.3f ms (%llu expanded), speedup %.2fx%s\n",
+        count, plainMs, (unsigned long long)plainExpanded, sweepMs, (unsigned long long)sweepStats.expanded,
+        plainMs / sweepMs, matched ? "" : " (DISTANCES DIFFER)");
+
+    // Many to many, the first row has to be the same as the sweep above
+    double matrixStart = nowMs();
+    DISTANCE_MATRIX* matrix = distanceMatrix(graph, points, count, points, count, numThreads);
+    double matrixMs = nowMs() - matrixStart;
+    if(matrix == NULL)
+    {
+        matched = false;
+    }
+    else
+    {
+        uint32_t reachable = 0;
+        for(size_t i = 0; i < (size_t)count * count; i++)
+        {
+            reachable += matrix->distances[i] != noDistance;
+        }
+        bool sameRow = memcmp(matrix->distances, distances, sizeof(uint32_t) * count) == 0;
+        matched = matched && sameRow;
+        int matrixThreads = (numThreads > 1) ? numThreads : 1;
+        printf("Many to many: %ux%u on %d thread%s in %.3f ms, %.2f us per pair, %u pairs connected, %llu nodes expanded%s\n",
+            count, count, matrixThreads, (matrixThreads == 1) ? "" : "s", matrixMs, 1000.0 * matrixMs / ((double)count * count), reachable,
+            (unsigned long long)matrix->expanded, sameRow ? "" : " (DISTANCES DIFFER)");
+    }
+
+    if(matrix != NULL && matrixName != NULL)
+    {
+        bool saved = saveDistanceMatrix(matrix, matrixName);
+        DISTANCE_MATRIX* loaded = saved ? loadDistanceMatrix(matrixName) : NULL;
+        saved = loaded != NULL && memcmp(loaded->distances, matrix->distances, sizeof(uint32_t) * count * count) == 0;
+        printf("Matrix %s %s\n", saved ? "saved to" : "could not be saved to", matrixName);
+        matched = matched && saved;
+        freeDistanceMatrix(&loaded);
+    }
+
+    freeDistanceMatrix(&matrix);
+    free(points);
+    free(plainCosts);
+    free(distances);
+    freeGraph(&graph);
+    return matched;
+}
+
+/* REPLANNING */
+
+bool runReplan(char* inName, char* editedName, SOLVE_OPTIONS* options, char* outName)
+{
+    if(inName == NULL || editedName == NULL || options == NULL)
+    {
+        return false;
+    }
+
+    BMP* maze = mapBMP(inName);
+    BMP* edited = mapBMP(editedName);
+    GRAPH* graph = (maze == NULL) ? NULL : graphFromBMP(maze, GRAPH_GRID, NULL, options->buildThreads);
+    MAZE* editedMaze = (edited == NULL) ? NULL : mazeFromBMP(edited, NULL, NULL);
+    freeBMP(&maze);
+    REPLAN* replan = newReplan(graph);
+    if(replan == NULL || editedMaze == NULL || editedMaze->width != graph->width || editedMaze->height != graph->height)
+    {
+        errMsg("runReplan", "Could not load both mazes, or they are not the same size!");
+        freeReplan(&replan);
+        freeMaze(&editedMaze);
+        freeGraph(&graph);
+        freeBMP(&edited);
+        return false;
+    }
+
+    PATH path = {0};
+    SEARCH_STATS stats = {0};
+    double start = nowMs();
+    bool found = replanPath(replan, &path, &stats);
+    double firstMs = nowMs() - start;
+    printf("First search: path length %u, %llu nodes expanded, %.3f ms\n", found ? path.cost : 0,
+        (unsigned long long)stats.expanded, firstMs);
+    freePath(&path);
+
+    uint32_t changed = 0;
+    start = nowMs();
+    bool replanned = replanMaze(replan, editedMaze, &changed);
+    found = replanned && replanPath(replan, &path, &stats);
+    double replanMs = nowMs() - start;
+    printf("Replan: %u pixels changed, ", changed);
+    if(found)
+    {
+        printf("path length %u, ", path.cost);
+    }
+    else
+    {
+        printf("no path, ");
+    }
+    printf("%llu nodes expanded, %.3f ms\n", (unsigned long long)stats.expanded, replanMs);
+
+    // The edited maze from scratch, between the same two cells
+    uint32_t startCell = replan->startCell;
+    uint32_t endCell = replan->endCell;
+    GRAPH* fresh = graphFromMaze(editedMaze, GRAPH_GRID, options->buildThreads);
+    PATH freshPath = {0};
+    SEARCH_STATS freshStats = {0};
+    start = nowMs();
+    bool freshFound = fresh != NULL && gridSearchState(fresh) && solveBetween(fresh, startCell, endCell, &freshPath, &freshStats);
+    double freshMs = nowMs() - start;
+    bool matched = replanned && found == freshFound && (!found || path.cost == freshPath.cost);
+    printf("From scratch: %llu nodes expanded, %.3f ms, replanning was %.2fx faster%s\n",
+        (unsigned long long)freshStats.expanded, freshMs, freshMs / replanMs, matched ? "" : " (PATHS DIFFER)");
+
+    if(found && outName != NULL)
+    {
+        bool written = readData(edited) && drawPath(edited, &path, 0xFF0000) && writeBMP(edited, outName);
+        matched = matched && written;
+    }
+
+    freePath(&path);
+    freePath(&freshPath);
+    freeGraph(&fresh);
+    freeReplan(&replan);
+    freeGraph(&graph);
+    freeBMP(&edited);
+    return matched;
+}
+
+/* WORKER POOL */
+
+typedef struct BATCH_JOBS_STRUCT {
+    char** names;
+    int count;
+    SOLVE_OPTIONS* options;
+    char* outDir;
+
+    // Next maze to hand out, guarded by lock
+    int next;
+    pthread_mutex_t lock;
+
+    SOLVE_RESULT* results;
+} BATCH_JOBS;
+
+static void* batchWorker(void* arg)
+{
+    BATCH_JOBS* jobs = arg;
+    char outName[longestPath];
+
+    // Grows to fit the biggest maze this thread sees, then gets reused for the rest
+    // If it cannot be made every maze just goes through malloc
+    ARENA* arena = newArena(1 << 20);
+
+    while(true)
+    {
+        pthread_mutex_lock(&(jobs->lock));
+        int job = jobs->next;
+        jobs->next++;
+        pthread_mutex_unlock(&(jobs->lock));
+        if(job >= jobs->count)
+        {
+            break;
+        }
+
+        char* inName = jobs->names[job];
+        if(!batchOutputName(inName, jobs->outDir, outName, sizeof(outName)))
+        {
+            errMsg("runBatch", "Output file name is too long!");
+            memset(&(jobs->results[job]), 0, sizeof(SOLVE_RESULT));
+            continue;
+        }
+        if(!solveMazeFile(inName, outName, jobs->options, &(jobs->results[job]), arena))
+        {
+            printf("Could not solve %s\n", inName);
+        }
+    }
+
+    freeArena(&arena);
+    return NULL;
+}
+
+typedef struct BATCH_OUTPUT_STRUCT {
+    char* outName;
+    int index;
+} BATCH_OUTPUT;
+
+// Sorts by output file, and by place in the list for the same file
+static int compareOutputs(const void* a, const void* b)
+{
+    const BATCH_OUTPUT* first = a;
+    const BATCH_OUTPUT* second = b;
+    int order = strcmp(first->outName, second->outName);
+    return (order != 0) ? order : first->index - second->index;
+}
+
+// Lists every maze that gets solved, so no two threads ever write the same output file
+// A repeat of an earlier line is dropped, and a different maze with the same output file
+// as an earlier one is left out and counted in collided
+static char** queueOutputs(char** names, int count, char* outDir, int* queued, int* collided)
+{
+    *queued = 0;
+    *collided = 0;
+    BATCH_OUTPUT* outputs = calloc(count, sizeof(BATCH_OUTPUT));
+    bool* keep = malloc(sizeof(bool) * count);
+    char** toReturn = malloc(sizeof(char*) * count);
+    char* outName = malloc(longestPath);
+    bool named = outputs != NULL && keep != NULL && toReturn != NULL && outName != NULL;
+    for(int i = 0; named && i < count; i++)
+    {
+        // Names that are too long are left for the worker to report
+        outputs[i].index = i;
+        outputs[i].outName = strdup(batchOutputName(names[i], outDir, outName, longestPath) ? outName : names[i]);
+        named = outputs[i].outName != NULL;
+        keep[i] = true;
+    }
+    if(named)
+    {
+        qsort(outputs, count, sizeof(BATCH_OUTPUT), compareOutputs);
+        int first = 0;
+        for(int i = 1; i < count; i++)
+        {
+            if(strcmp(outputs[first].outName, outputs[i].outName) != 0)
+            {
+                first = i;
+                continue;
+            }
+            char* firstName = names[outputs[first].index];
+            char* name = names[outputs[i].index];
+            keep[outputs[i].index] = false;
+            if(strcmp(firstName, name) != 0)
+            {
+                printf("Could not solve %s, %s writes the same output file\n", name, firstName);
+                (*collided)++;
+            }
+        }
+        for(int i = 0; i < count; i++)
+        {
+            if(keep[i])
+            {
+                toReturn[(*queued)++] = names[i];
+            }
+        }
+    }
+
+    for(int i = 0; outputs != NULL && i < count; i++)
+    {
+        free(outputs[i].outName);
+    }
+    free(outputs);
+    free(keep);
+    free(outName);
+    if(!named)
+    {
+        free(toReturn);
+        return NULL;
+    }
+    return toReturn;
+}
+
+bool runBatch(char** names, int count, SOLVE_OPTIONS* options, int numThreads, char* outDir)
+{
+    if(names == NULL || options == NULL || count <= 0)
+    {
+        return false;
+    }
+
+    // The first maze is always queued, so there is at least one
+    int collided = 0;
+    int queued = 0;
+    char** queue = queueOutputs(names, count, outDir, &queued, &collided);
+    if(queue == NULL)
+    {
+        return false;
+    }
+    int numMazes = queued + collided;
+    if(numThreads < 1)
+    {
+        numThreads = 1;
+    }
+    if(numThreads > queued)
+    {
+        numThreads = queued;
+    }
+
+    BATCH_JOBS jobs;
+    jobs.names = queue;
+    jobs.count = queued;
+    jobs.options = options;
+    jobs.outDir = outDir;
+    jobs.next = 0;
+    jobs.results = calloc(queued, sizeof(SOLVE_RESULT));
+    pthread_t* threads = malloc(sizeof(pthread_t) * numThreads);
+    if(jobs.results == NULL || threads == NULL)
+    {
+        free(queue);
+        free(jobs.results);
+        free(threads);
+        return false;
+    }
+    pthread_mutex_init(&(jobs.lock), NULL);
+
+    double batchStart = nowMs();
+    int started = 0;
+    for(int i = 0; i < numThreads; i++)
+    {
+        if(pthread_create(&(threads[i]), NULL, batchWorker, &jobs) != 0)
+        {
+            break;
+        }
+        started++;
+    }
+    // If no thread could be started the work still gets done on this one
+    if(started == 0)
+    {
+        batchWorker(&jobs);
+    }
+    for(int i = 0; i < started; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+    double batchMs = nowMs() - batchStart;
+
+    /* SUMMARY */
+
+    int solved = 0;
+    uint64_t cells = 0;
+    uint64_t expanded = 0;
+    size_t arenaBytes = 0;
+    double loadMs = 0, buildMs = 0, searchMs = 0, writeMs = 0;
+    for(int i = 0; i < queued; i++)
+    {
+        SOLVE_RESULT* result = &(jobs.results[i]);
+        solved += result->solved;
+        cells += result->openCells;
+        expanded += result->expanded;
+        loadMs += result->loadMs;
+        buildMs += result->buildMs;
+        searchMs += result->searchMs;
+        writeMs += result->writeMs;
+        if(result->arenaBytes > arenaBytes)
+        {
+            arenaBytes = result->arenaBytes;
+        }
+    }
+
+    int workers = (started > 0) ? started : 1;
+    printf("Batch: %d mazes, %d solved, %d failed, %d thread%s\n", numMazes, solved, numMazes - solved, workers,
+        (workers == 1) ? "" : "s");
+    printf("Wall time: %.3f ms, %.1f mazes/s, %.2f M open cells/s, %.2f M nodes expanded/s\n",
+        batchMs, queued / (batchMs / 1000.0), cells / (batchMs * 1000.0), expanded / (batchMs * 1000.0));
+    printf("Stage totals (summed over threads): load %.3f ms, build %.3f ms, search %.3f ms, write %.3f ms\n",
+        loadMs, buildMs, searchMs, writeMs);
+    printf("Largest arena: %.2f MB per thread\n", arenaBytes / (1024.0 * 1024.0));
+    if(options->solveCache != NULL)
+    {
+        SOLVE_CACHE_COUNTS counts = solveCacheCounts(options->solveCache);
+        printf("Solve cache: %llu hits, %llu misses, %llu stored, %llu evicted, %u paths in %.1f KB\n",
+            (unsigned long long)counts.hits, (unsigned long long)counts.misses, (unsigned long long)counts.stores,
+            (unsigned long long)counts.evictions, counts.entries, counts.bytes / 1024.0);
+    }
+    if(options->stats)
+    {
+        reportStats(jobs.results, queued, options->repeat, options->statsJSON);
+    }
+
+    pthread_mutex_destroy(&(jobs.lock));
+    free(queue);
+    free(jobs.results);
+    free(threads);
+    return solved == numMazes;
+}
+
+bool reportStats(SOLVE_RESULT* results, int count, int repeat, char* jsonName)
+{
+    if(results == NULL || count <= 0)
+    {
+        return false;
+    }
+
+    // Summed over every maze, searchMs is already the average of the repeats
+    int solved = 0;
+    uint64_t expanded = 0;
+    double loadMs = 0, buildMs = 0, searchMs = 0, writeMs = 0;
+    for(int i = 0; i < count; i++)
+    {
+        solved += results[i].solved;
+        expanded += results[i].expanded;
+        loadMs += results[i].loadMs;
+        buildMs += results[i].buildMs + results[i].landmarkMs + results[i].hpaMs;
+        searchMs += results[i].searchMs;
+        writeMs += results[i].writeMs;
+    }
+    SOLVER_STATS counters = readStats();
+
+    if(jsonName == NULL)
+    {
+        printf("Stats: %d mazes, %d solved, %d searches each\n", count, solved, repeat);
+        printf("Stage time: load %.3f ms, build %.3f ms, search %.3f ms, write %.3f ms\n", loadMs, buildMs, searchMs, writeMs);
+        printf("Nodes expanded: %llu\n", (unsigned long long)expanded);
+        if(!instrumented)
+        {
+            printf("Counters: not compiled in (make clean; make INSTRUMENT=1)\n");
+            return true;
+        }
+        printf("Open set: %llu pushes, %llu decrease-keys, peak %llu\n", (unsigned long long)counters.queuePushes,
+            (unsigned long long)counters.decreaseKeys, (unsigned long long)counters.openPeak);
+        printf("I/O: %llu bytes read, %llu bytes written, %llu calls\n", (unsigned long long)counters.bytesRead,
+            (unsigned long long)counters.bytesWritten, (unsigned long long)counters.syscalls);
+        return true;
+    }
+
+    FILE* fp = fopen(jsonName, "w");
+    if(fp == NULL)
+    {
+        errMsg("reportStats", "Could not open stats file!");
+        return false;
+    }
+    fprintf(fp, "{\n  \"mazes\": %d,\n  \"solved\": %d,\n  \"repeat\": %d,\n  \"queue\": \"%s\",\n", count, solved, repeat, queueBackend);
+    fprintf(fp, "  \"loadMs\": %.4f,\n  \"buildMs\": %.4f,\n  \"searchMs\": %.4f,\n  \"writeMs\": %.4f,\n",
+        loadMs, buildMs, searchMs, writeMs);
+    fprintf(fp, "  \"expanded\": %llu,\n  \"instrumented\": %s", (unsigned long long)expanded, instrumented ? "true" : "false");
+    if(instrumented)
+    {
+        fprintf(fp, ",\n  \"queuePushes\": %llu,\n  \"decreaseKeys\": %llu,\n  \"openPeak\": %llu,\n",
+            (unsigned long long)counters.queuePushes, (unsigned long long)counters.decreaseKeys, (unsigned long long)counters.openPeak);
+        fprintf(fp, "  \"bytesRead\": %llu,\n  \"bytesWritten\": %llu,\n  \"syscalls\": %llu",
+            (unsigned long long)counters.bytesRead, (unsigned long long)counters.bytesWritten, (unsigned long long)counters.syscalls);
+    }
+    fprintf(fp, "\n}\n");
+    return fclose(fp) == 0;
+}
+
+bool batchOutputName(char* inName, char* outDir, char* outName, size_t size)
+{
+    if(inName == NULL || outName == NULL)
+    {
+        return false;
+    }
+
+    // Drop the directory if the output goes somewhere else, and always drop ".bmp"
+    char* base = inName;
+    if(outDir != NULL)
+    {
+        char* slash = strrchr(inName, '/');
+        base = (slash == NULL) ? inName : slash + 1;
+    }
+    int baseLength = strlen(base);
+    if(endsWith(base, ".bmp"))
+    {
+        baseLength -= 4;
+    }
+
+    int written = 0;
+    if(outDir != NULL)
+    {
+        written = snprintf(outName, size, "%s/%.*s_solved.bmp", outDir, baseLength, base);
+    }
+    else
+    {
+        written = snprintf(outName, size, "%.*s_solved.bmp", baseLength, base);
+    }
+    return written > 0 && (size_t)written < size;
+}
+
+char** readPathList(FILE* fp, int* count)
+{
+    if(fp == NULL || count == NULL)
+    {
+        return NULL;
+    }
+
+    int capacity = 64;
+    char** names = malloc(sizeof(char*) * capacity);
+    char* line = malloc(longestPath);
+    if(names == NULL || line == NULL)
+    {
+        free(names);
+        free(line);
+        return NULL;
+    }
+
+    *count = 0;
+    while(fgets(line, longestPath, fp) != NULL)
+    {
+        // Trim the newline and any trailing whitespace
+        int length = strlen(line);
+        while(length > 0 && (line[length - 1] == '\n' || line[length - 1] == '\r' || line[length - 1] == ' '))
+        {
+            length--;
+        }
+        line[length] = 0;
+        if(length == 0 || line[0] == '#')
+        {
+            continue;
+        }
+
+        if(*count == capacity)
+        {
+            capacity *= 2;
+            char** bigger = realloc(names, sizeof(char*) * capacity);
+            if(bigger == NULL)
+            {
+                break;
+            }
+            names = bigger;
+        }
+        names[*count] = malloc(length + 1);
+        if(names[*count] == NULL)
+        {
+            break;
+        }
+        memcpy(names[*count], line, length + 1);
+        (*count)++;
+    }
+
+    free(line);
+    return names;
+}
+
+void freePathList(char*** toFree, int count)
+{
+    char** temp = (*toFree);
+    if(temp == NULL)
+    {
+        return;
+    }
+    for(int i = 0; i < count; i++)
+    {
+        free(temp[i]);
+    }
+    free(temp);
+    (*toFree) = NULL;
+}
@@ -0,0 +1,343 @@
+// Needed for pthreads under -std=c99
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <pthread.h>
+#include "bidir.h"
+#include "algos.h"
+#include "pqueue.h"
+
+/* SHARED STATE */
+
+typedef struct BIDIR_SEARCH_STRUCT {
+    GRAPH* graph;
+
+    // Number of ids (nodes, or cells in GRAPH_GRID mode)
+    uint32_t numIds;
+
+    // Cost of the best path found so far, and the edge where its two halves meet
+    // Written under lock, read with atomics
+    uint32_t mu;
+    uint32_t meetForward;
+    uint32_t meetBackward;
+    pthread_mutex_t lock;
+
+    // Set by the first side to finish, so the other one stops too
+    bool done;
+
+    // Set when an open set runs out of memory
+    bool failed;
+
+    // Manhattan distance from start to end, added to every key
+    uint32_t offset;
+} BIDIR_SEARCH;
+
+typedef struct BIDIR_SIDE_STRUCT {
+    BIDIR_SEARCH* search;
+    struct BIDIR_SIDE_STRUCT* other;
+    bool forward;
+
+    PQUEUE* open;
+    uint32_t* cost;
+    uint32_t* from;
+    uint64_t* closed;
+
+    // Where this side starts, and the cells the potential is taken from
+    uint32_t source;
+    uint32_t sourceCell;
+    uint32_t targetCell;
+
+    // Key of the last node taken off the open set, read by the other side
+    uint32_t lastKey;
+
+    uint64_t expanded;
+} BIDIR_SIDE;
+
+/* SIDES */
+
+/*
+    Each side uses half the difference of the two Manhattan distances as its potential,
+    so the potentials of the two sides add up to a constant. That is what makes
+    the stopping rule below work; with plain front to end heuristics each side would
+    have to stop on its own, which on mazes usually means expanding more than one way A*.
+    Keys are doubled to stay integers, and offset by the start to end distance so they never go negative.
+*/
+static inline uint32_t sideKey(BIDIR_SIDE* side, uint32_t cost, uint32_t id)
+{
+    GRAPH* graph = side->search->graph;
+    uint32_t cell = idCell(graph, id);
+    uint32_t toTarget = cellDistance(cell, side->targetCell, graph->width);
+    uint32_t toSource = cellDistance(cell, side->sourceCell, graph->width);
+    return (2 * cost) + toTarget + side->search->offset - toSource;
+}
+
+static bool initSide(BIDIR_SIDE* side, BIDIR_SEARCH* search, uint32_t source, uint32_t sourceCell, uint32_t targetCell)
+{
+    uint32_t numIds = search->numIds;
+    memset(side, 0, sizeof(BIDIR_SIDE));
+    side->search = search;
+    side->source = source;
+    side->sourceCell = sourceCell;
+    side->targetCell = targetCell;
+    ARENA* arena = search->graph->arena;
+    side->open = newQueue(numIds, arena);
+    side->cost = allocIn(arena, sizeof(uint32_t) * numIds);
+    side->from = allocIn(arena, sizeof(uint32_t) * numIds);
+    side->closed = callocIn(arena, (numIds + 63) / 64, sizeof(uint64_t));
+    if(side->open == NULL || side->cost == NULL || side->from == NULL || side->closed == NULL)
+    {
+        return false;
+    }
+    for(uint32_t i = 0; i < numIds; i++)
+    {
+        side->cost[i] = UINT32_MAX;
+        side->from[i] = noCell;
+    }
+
+    side->cost[source] = 0;
+    side->lastKey = sideKey(side, 0, source);
+    return queuePush(side->open, source, side->lastKey);
+}
+
+static void freeSide(BIDIR_SIDE* side)
+{
+    ARENA* arena = side->search->graph->arena;
+    freeQueue(&(side->open));
+    freeIn(arena, side->cost);
+    freeIn(arena, side->from);
+    freeIn(arena, side->closed);
+}
+
+// Records a path through the edge forwardId -> backwardId if it beats mu
+static void offerPath(BIDIR_SEARCH* search, uint32_t cost, uint32_t forwardId, uint32_t backwardId)
+{
+    if(cost >= __atomic_load_n(&(search->mu), __ATOMIC_ACQUIRE))
+    {
+        return;
+    }
+    pthread_mutex_lock(&(search->lock));
+    if(cost < search->mu)
+    {
+        search->meetForward = forwardId;
+        search->meetBackward = backwardId;
+        __atomic_store_n(&(search->mu), cost, __ATOMIC_RELEASE);
+    }
+    pthread_mutex_unlock(&(search->lock));
+}
+
+// Takes one node off the open set and relaxes its edges
+// Returns false once this side is finished
+static bool expandSide(BIDIR_SIDE* side)
+{
+    BIDIR_SEARCH* search = side->search;
+    GRAPH* graph = search->graph;
+
+    /*
+        For a path through v the two keys of v add up to 2 * cost + 2 * offset,
+        so once the smallest keys of both sides add up to 2 * (mu + offset)
+        no path left can beat mu. The other side's lastKey can only be lower
+        than its real smallest key, so reading an old value just means stopping later.
+    */
+    if(queueEmpty(side->open))
+    {
+        return false;
+    }
+    uint64_t topKeys = (uint64_t)queueTopKey(side->open) + __atomic_load_n(&(side->other->lastKey), __ATOMIC_ACQUIRE);
+    uint64_t mu = __atomic_load_n(&(search->mu), __ATOMIC_ACQUIRE);
+    if(topKeys >= 2 * (mu + search->offset))
+    {
+        return false;
+    }
+
+    __atomic_store_n(&(side->lastKey), queueTopKey(side->open), __ATOMIC_RELEASE);
+    uint32_t current = queuePop(side->open);
+    side->closed[current / 64] |= (1ULL << (current % 64));
+    side->expanded++;
+
+    uint32_t currentCost = side->cost[current];
+    uint32_t neighbours[4];
+    uint16_t costs[4];
+    int count = idNeighbours(graph, current, neighbours, costs);
+    for(int i = 0; i < count; i++)
+    {
+        uint32_t next = neighbours[i];
+        uint32_t newCost = currentCost + costs[i];
+
+        // The other side may be writing this cost right now
+        // Each side stores its own costs and then loads the other's, so acquire and release would let
+        // both loads see the old value and miss the meeting edge, sequential consistency rules that out
+        uint32_t otherCost = __atomic_load_n(&(side->other->cost[next]), __ATOMIC_SEQ_CST);
+        if(otherCost != UINT32_MAX)
+        {
+            if(side->forward)
+            {
+                offerPath(search, newCost + otherCost, current, next);
+            }
+            else
+            {
+                offerPath(search, newCost + otherCost, next, current);
+            }
+        }
+
+        if((side->closed[next / 64] >> (next % 64)) & 1)
+        {
+            continue;
+        }
+        if(newCost >= side->cost[next])
+        {
+            continue;
+        }
+        side->from[next] = current;
+        __atomic_store_n(&(side->cost[next]), newCost, __ATOMIC_SEQ_CST);
+
+        uint32_t key = sideKey(side, newCost, next);
+        bool queued = queueContains(side->open, next) ? queueDecrease(side->open, next, key) : queuePush(side->open, next, key);
+        if(!queued)
+        {
+            errMsg("solveBidirectional", "Open set ran out of memory!");
+            __atomic_store_n(&(search->failed), true, __ATOMIC_RELEASE);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static void* sideWorker(void* arg)
+{
+    BIDIR_SIDE* side = arg;
+    BIDIR_SEARCH* search = side->search;
+    while(!__atomic_load_n(&(search->done), __ATOMIC_ACQUIRE) && expandSide(side))
+    {
+    }
+    __atomic_store_n(&(search->done), true, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+/* PATH */
+
+static bool buildPath(BIDIR_SEARCH* search, BIDIR_SIDE* forward, BIDIR_SIDE* backward, PATH* path)
+{
+    GRAPH* graph = search->graph;
+
+    // The meeting ids are the same when start and end are
+    uint32_t meetBackward = search->meetBackward;
+    if(meetBackward == search->meetForward)
+    {
+        meetBackward = backward->from[meetBackward];
+    }
+
+    uint32_t forwardLength = 0;
+    for(uint32_t id = search->meetForward; id != noCell; id = forward->from[id])
+    {
+        forwardLength++;
+    }
+    uint32_t length = forwardLength;
+    for(uint32_t id = meetBackward; id != noCell; id = backward->from[id])
+    {
+        length++;
+    }
+
+    path->arena = graph->arena;
+    path->cells = allocIn(path->arena, sizeof(uint32_t) * length);
+    if(path->cells == NULL)
+    {
+        return false;
+    }
+    path->length = length;
+    path->cost = search->mu;
+
+    // Start half is walked back to front, end half front to back
+    uint32_t index = forwardLength;
+    for(uint32_t id = search->meetForward; id != noCell; id = forward->from[id])
+    {
+        index--;
+        path->cells[index] = idCell(graph, id);
+    }
+    index = forwardLength;
+    for(uint32_t id = meetBackward; id != noCell; id = backward->from[id])
+    {
+        path->cells[index] = idCell(graph, id);
+        index++;
+    }
+
+    return true;
+}
+
+bool solveBidirectional(GRAPH* graph, PATH* path, SEARCH_STATS* stats, bool threaded)
+{
+    if(graph == NULL || path == NULL)
+    {
+        return false;
+    }
+
+    BIDIR_SEARCH search;
+    memset(&search, 0, sizeof(BIDIR_SEARCH));
+    search.graph = graph;
+    search.mu = UINT32_MAX;
+    search.meetForward = noCell;
+    search.meetBackward = noCell;
+
+    search.numIds = graphIds(graph);
+    uint32_t startId = cellId(graph, graph->startCell);
+    uint32_t endId = cellId(graph, graph->endCell);
+
+    search.offset = cellDistance(graph->startCell, graph->endCell, graph->width);
+
+    BIDIR_SIDE forward;
+    BIDIR_SIDE backward;
+    bool ready = initSide(&forward, &search, startId, graph->startCell, graph->endCell);
+    ready = initSide(&backward, &search, endId, graph->endCell, graph->startCell) && ready;
+    if(!ready)
+    {
+        freeSide(&forward);
+        freeSide(&backward);
+        return false;
+    }
+    forward.forward = true;
+    forward.other = &backward;
+    backward.other = &forward;
+    pthread_mutex_init(&(search.lock), NULL);
+
+    // Start and end are one node apart before either side has moved
+    if(startId == endId)
+    {
+        offerPath(&search, 0, startId, endId);
+    }
+
+    pthread_t backwardThread;
+    if(threaded && pthread_create(&backwardThread, NULL, sideWorker, &backward) == 0)
+    {
+        sideWorker(&forward);
+        pthread_join(backwardThread, NULL);
+    }
+    else
+    {
+        // Expand whichever side has the smaller open set
+        while(true)
+        {
+            BIDIR_SIDE* side = (forward.open->size <= backward.open->size) ? &forward : &backward;
+            if(!expandSide(side))
+            {
+                break;
+            }
+        }
+    }
+
+    if(stats != NULL)
+    {
+        stats->expanded = forward.expanded + backward.expanded;
+        stats->forwardExpanded = forward.expanded;
+        stats->backwardExpanded = backward.expanded;
+    }
+
+    bool found = !search.failed && search.mu != UINT32_MAX && buildPath(&search, &forward, &backward, path);
+
+    pthread_mutex_destroy(&(search.lock));
+    freeSide(&forward);
+    freeSide(&backward);
+    return found;
+}
@@ -1,8 +1,17 @@
+// Needed for mmap, fstat and friends under -std=c99
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
 #include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "bmp.h"
+#include "rowdecode.h"
+#include "stats.h"
 
 //TODO: ADD ERROR MESSAGES TO ALL FUNCTIONS
 void errMsg(char func[],char err[])
@@ -14,21 +23,68 @@ void errMsg(char func[],char err[])
 void freeBMP(BMP** toFree)
 {
     BMP* temp = (*toFree);
+    if(temp == NULL)
+    {
+        return;
+    }
     if(temp->data.colorData != NULL)
     {
-        free(temp->data.colorData);
+        freeIn(temp->arena, temp->data.colorData);
+    }
+    if(temp->data.HasCTable)
+    {
+        free(temp->data.cTable.entries);
+    }
+    if(temp->mapping != NULL)
+    {
+        munmap((void*)temp->mapping, temp->mappingSize);
+        countStat(syscalls, 1);
     }
     free(*toFree);
+    (*toFree) = NULL;
 }
 
 BMP* newBMP()
 {
-    BMP* toReturn = malloc(sizeof(BMP));
-    toReturn->data.colorData = NULL;
+    // Everything starts zeroed so freeBMP knows what has been allocated
+    BMP* toReturn = calloc(1, sizeof(BMP));
+    return toReturn;
+}
+
+// Unaligned little endian reads straight out of the mapped file
+static uint16_t get16(const uint8_t* at)
+{
+    uint16_t toReturn = 0;
+    memcpy(&toReturn, at, sizeof(uint16_t));
+    return toReturn;
+}
+
+static uint32_t get32(const uint8_t* at)
+{
+    uint32_t toReturn = 0;
+    memcpy(&toReturn, at, sizeof(uint32_t));
     return toReturn;
 }
 
 BMP* readBMP(char* fileName) 
+{
+    BMP* toReturn = mapBMP(fileName);
+    if(toReturn == NULL)
+    {
+        return NULL;
+    }
+
+    // Read data
+    if(!readData(toReturn))
+    {
+        freeBMP(&toReturn);
+        return NULL;
+    }
+
+    return toReturn;
+}
+
+BMP* mapBMP(char* fileName)
 {
     /* INITIALIZATION AND ERROR CHECKING */
 
@@ -41,58 +97,68 @@ BMP* readBMP(char* fileName)
         return NULL;
     }
 
-    // Open bitmap file to read
-    FILE* fp = NULL;
-    fp = fopen(fileName, "rb");
-    if(fp == NULL)
+    // Map the whole bitmap file, the mapping stays valid after the file is closed
+    int fd = open(fileName, O_RDONLY);
+    if(fd < 0)
+    {
+        return NULL;
+    }
+    struct stat fileInfo;
+    if(fstat(fd, &fileInfo) != 0 || fileInfo.st_size < 54)
+    {
+        close(fd);
+        return NULL;
+    }
+    size_t fileSize = fileInfo.st_size;
+    void* mapping = mmap(NULL, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    countStat(syscalls, 4);
+    if(mapping == MAP_FAILED)
     {
         return NULL;
     }
+    countStat(bytesRead, fileSize);
 
     // Allocate memory for bitmap struct
     BMP* toReturn = newBMP();
     if(toReturn == NULL)
     {
-        fclose(fp);
+        munmap(mapping, fileSize);
         return NULL;
     }
+    toReturn->mapping = mapping;
+    toReturn->mappingSize = fileSize;
 
     // Read headers
-    if(!readHeader(toReturn,fp))
+    if(!readHeader(toReturn, toReturn->mapping, fileSize))
     {
         freeBMP(&toReturn);
-        fclose(fp);
         return NULL;
     }
-    if(!readDIB(toReturn,fp))
+    if(!readDIB(toReturn, toReturn->mapping, fileSize))
     {
         freeBMP(&toReturn);
-        fclose(fp);
         return NULL;
     }
 
-    if(!readColorTable(toReturn,fp))
+    if(!readColorTable(toReturn, toReturn->mapping, fileSize))
     {
         freeBMP(&toReturn);
-        fclose(fp);
         return NULL;
     }
 
-    // Read data
-    if(!readData(toReturn,fp))
+    if(!readRows(toReturn, toReturn->mapping, fileSize))
     {
         freeBMP(&toReturn);
-        fclose(fp);
+        return NULL;
     }
 
-
-    fclose(fp);
     return toReturn;
 }
 
-bool readHeader(BMP* toReturn, FILE* fp)
+bool readHeader(BMP* toReturn, const uint8_t* file, size_t fileSize)
 {
-    if(toReturn == NULL || fp == NULL)
+    if(toReturn == NULL || file == NULL || fileSize < 54)
     {
         return false;
     }
@@ -109,75 +175,41 @@ bool readHeader(BMP* toReturn, FILE* fp)
             - Has no compression
     */
 
-    // Used to check the return value of various file functions
-    int returnChk = 0;
-
-    // Actual fileSize stored here - to compare against listedSize for verification of size
-    long fileSize = 0;
-
-    // Temp variables
-    uint16_t signiture = 0;
-    uint32_t listedSize = 0;
-    uint32_t headerSize = 0;
-    uint32_t compression = 0;
-    uint16_t bitDepth = 0;
-
-    // Start reading at the beginning of the file
-    rewind(fp);
-
     // Check for bitmap header signature at beginning of file
-    returnChk = fread(&signiture, sizeof(uint16_t), 1, fp);
-    if (returnChk != 1 || signiture != bmpSignature)
+    uint16_t signiture = get16(file);
+    if (signiture != bmpSignature)
     {
         return false;
     }
 
-    // Seek to end of file to find actual length
-    fseek(fp, 0, SEEK_END);
-    fileSize = ftell(fp);
-
-    // Seek to 0x2 (long) (position of fileSize)
-    fseek(fp, 0x2L, SEEK_SET);
-    returnChk = fread(&listedSize, sizeof(uint32_t), 1, fp);
-    if(returnChk != 1)
-    {
-        return NULL;
-    }
+    // fileSize at 0x2
+    uint32_t listedSize = get32(file + 0x2);
     if(listedSize != fileSize)
     {
         //WARNING MESSAGE GOES HERE
         printf("\n[WARNING] BITMAP HEADER LISTED SIZE NOT EQUAL TO ACTUAL SIZE [WARNING]\n");
-        printf("\nActual file size = %ld\nFile Size in BMP Head = %d\n", fileSize, listedSize);
+        printf("\nActual file size = %lu\nFile Size in BMP Head = %u\n", (unsigned long)fileSize, listedSize);
         printf("\n[WARNING] BITMAP HEADER LISTED SIZE NOT EQUAL TO ACTUAL SIZE [WARNING]\n");
     }
 
     //Check if header is BITMAPINFOHEADER or newer
-    fseek(fp, 0x0EL, SEEK_SET);
-    returnChk = fread(&headerSize, sizeof(uint32_t), 1, fp);
-    if(returnChk != 1 || headerSize < 40)
+    uint32_t headerSize = get32(file + 0x0E);
+    if(headerSize < 40)
     {
         return false;
     }
     
     // Check file compression
-    fseek(fp, 0x1EL, SEEK_SET);
-    returnChk = fread(&compression, sizeof(uint32_t), 1, fp);
-    if (returnChk != 1 || compression != 0x0)
+    uint32_t compression = get32(file + 0x1E);
+    if (compression != 0x0)
     {
         return false;
     }
 
     //Check bit depth
-    fseek(fp, 0x1CL, SEEK_SET);
-    returnChk = fread(&bitDepth, sizeof(uint16_t), 1, fp);
-    if (returnChk != 1)
-    {
-        return false;
-    }
+    uint16_t bitDepth = get16(file + 0x1C);
 
     //TODO: TEST IF 16, 12, and 8 bpp bitmaps work with reading/writing (they should with little to no change)
-    //TODO: ACTUALLY TO ADD LESSER COLORS YOU NEED TO ADD SUPPORT FOR THE COLOR TABLE
-    //TODO: ADD SUPPORT FOR THE COLOR TABLE
     if(bitDepth != 1 && bitDepth != 2 && bitDepth != 4 && bitDepth != 8 && bitDepth != 16 && bitDepth != 24 && bitDepth != 32)
     {
         printf("BITMAP DEPTH = %d\n", bitDepth);
@@ -197,9 +229,9 @@ bool readHeader(BMP* toReturn, FILE* fp)
     return true;
 }
 
-bool readDIB(BMP* toReturn, FILE* fp)
+bool readDIB(BMP* toReturn, const uint8_t* file, size_t fileSize)
 {
-    if(toReturn == NULL || fp == NULL)
+    if(toReturn == NULL || file == NULL || fileSize < 54)
     {
         return false;
     }
@@ -207,61 +239,19 @@ bool readDIB(BMP* toReturn, FILE* fp)
 
     /*
         Pass 2 is meant to fill the BMP struct with all data from the bitmap file.
-        Some data stored redundantly; the total memory size of all structs 
-        should be around 1.5 - 2.2x the size of the file.
+        Every field is read straight out of the mapped file,
+        readHeader already made sure the file is long enough to hold them.
     */
 
-    // Used to check the return value of various file functions
-    int returnChk = 0;
-
-    // Grab the rest of the header/DIB
-    // General format as follows:
-    // Seek to data location -> Grab data -> Check if data grabbed -> Put in struct
-
-    // offset
-    fseek(fp, 0xAL, SEEK_SET);
-    returnChk = fread(&(toReturn->head.offset), sizeof(uint32_t), 1, fp);
-    if(returnChk != 1) {return false;}
-
-    // bmpWidth
-    fseek(fp, 0x12L, SEEK_SET);
-    returnChk = fread(&(toReturn->dib.bmpWidth), sizeof(uint32_t), 1, fp);
-    if(returnChk != 1) {return false;}
-
-    // bmpHeight
-    fseek(fp, 0x16L, SEEK_SET);
-    returnChk = fread(&(toReturn->dib.bmpHeight),sizeof(uint32_t), 1, fp);
-    if(returnChk != 1) {return false;}
-
-    // colorPlanes
-    fseek(fp, 0x1AL, SEEK_SET);
-    returnChk = fread(&(toReturn->dib.colorPlanes), sizeof(uint16_t), 1, fp);
-    if(returnChk != 1) {return false;}
-
-    // imageSize
-    fseek(fp, 0x22L, SEEK_SET);
-    returnChk = fread(&(toReturn->dib.imageSize), sizeof(uint32_t), 1, fp);
-    if(returnChk != 1) {return false;}
-
-    // resWidthPPM
-    fseek(fp, 0x26L, SEEK_SET);
-    returnChk = fread(&(toReturn->dib.resWidthPPM), sizeof(uint32_t), 1, fp);
-    if(returnChk != 1) {return false;}
-
-    // resHeightPPM
-    fseek(fp, 0x2AL, SEEK_SET);
-    returnChk = fread(&(toReturn->dib.resHeightPPM), sizeof(uint32_t), 1, fp);
-    if(returnChk != 1) {return false;}
-
-    // colorPalette
-    fseek(fp, 0x2EL, SEEK_SET);
-    returnChk = fread(&(toReturn->dib.colorPalette), sizeof(uint32_t), 1, fp);
-    if(returnChk != 1) {return false;}
-
-    // importantColors
-    fseek(fp, 0x32L, SEEK_SET);
-    returnChk = fread(&(toReturn->dib.importantColors), sizeof(uint32_t), 1, fp);
-    if(returnChk != 1) {return false;}
+    toReturn->head.offset = get32(file + 0xA);
+    toReturn->dib.bmpWidth = (int32_t)get32(file + 0x12);
+    toReturn->dib.bmpHeight = (int32_t)get32(file + 0x16);
+    toReturn->dib.colorPlanes = get16(file + 0x1A);
+    toReturn->dib.imageSize = get32(file + 0x22);
+    toReturn->dib.resWidthPPM = (int32_t)get32(file + 0x26);
+    toReturn->dib.resHeightPPM = (int32_t)get32(file + 0x2A);
+    toReturn->dib.colorPalette = get32(file + 0x2E);
+    toReturn->dib.importantColors = get32(file + 0x32);
 
     /*
         Just your daily reminder that height and width are signed.
@@ -271,46 +261,40 @@ bool readDIB(BMP* toReturn, FILE* fp)
         return false;
     }
 
-    return true;
-}
-
-bool readData(BMP* toReturn, FILE* fp)
-{
-    if(toReturn == NULL || fp == NULL)
+    // The pixels can not start inside the headers (64 bit, a huge headerSize would wrap around in 32)
+    if((uint64_t)toReturn->head.offset < 14 + (uint64_t)toReturn->dib.headerSize)
     {
         return false;
     }
 
-    bool success = true;
-    if(toReturn->dib.bitsPerPixel < 8)
-    {
-        success = readDataBits(toReturn, fp);
-    }
-    else
-    {
-        success = readDataBytes(toReturn, fp);
-    }
-    
-    return success;
+    return true;
 }
 
-bool readDataBits(BMP* toReturn, FILE* fp)
+bool readRows(BMP* toReturn, const uint8_t* file, size_t fileSize)
 {
-    if(toReturn == NULL || fp == NULL)
+    if(toReturn == NULL || file == NULL)
     {
         return false;
     }
 
-    int rowSize = 0;
-    int rowPadding = 0;
+    /*
+        NOTE: This rowSize calculation looks complicated because
+        I did not want to link the math library, and as such abused
+        the fact that c uses a floor function to force division into ints.
+        The proper rowSize calculation is as follows:
+        RowSize = (ceil(BitsPerPixel * ImageWidth)/32) * 4
 
-    rowSize = ((toReturn->dib.bmpWidth * toReturn->dib.bitsPerPixel) + 31) / 32;
+        This rounds the RowSize up to a multiple of 4 bytes.
+    */
+    uint64_t rowSize = (((uint64_t)toReturn->dib.bmpWidth * toReturn->dib.bitsPerPixel) + 31) / 32;
     rowSize = rowSize * 4;
 
-    //rowSize is in bytes, and we want it in bits
-    rowSize = rowSize * 8;
-
-    rowPadding = rowSize - (toReturn->dib.bmpWidth * toReturn->dib.bitsPerPixel);
+    // Every row has to be inside the file
+    if(toReturn->head.offset > fileSize || rowSize * toReturn->dib.bmpHeight > fileSize - toReturn->head.offset)
+    {
+        errMsg("readRows", "Bitmap data runs past the end of the file!");
+        return false;
+    }
 
     /* START FILLING IN BMPDATA*/
     toReturn->data.width = toReturn->dib.bmpWidth;
@@ -318,157 +302,176 @@ bool readDataBits(BMP* toReturn, FILE* fp)
     toReturn->data.area = toReturn->data.width * toReturn->data.height;
     toReturn->data.bitDepth = toReturn->dib.bitsPerPixel;
     // TODO: hasAlpha, bitsForAlpha
-    
-    int tempHeight = toReturn->data.height;
-    int tempWidth = toReturn->data.width;
-    int tempBPP = toReturn->data.bitDepth;
-    int returnChk = 0;
-    int bitsUntilBufferEnd = 0;
-    
-    uint8_t bufferByte = 0;
-    uint8_t bitMask = (0xFF << (8 - tempBPP));
 
-    PIXEL* pixArray = malloc(sizeof(PIXEL) * toReturn->data.area);
+    toReturn->data.rowSize = rowSize;
+    toReturn->data.rows = file + toReturn->head.offset;
 
-    fseek(fp, toReturn->head.offset, SEEK_SET);
-    for(int y = 0; y < tempHeight; y++)
+    return true;
+}
+
+const uint8_t* bmpRow(BMP* toRead, int y)
+{
+    return toRead->data.rows + ((size_t)toRead->data.rowSize * y);
+}
+
+uint32_t bmpPixel(BMP* toRead, int x, int y)
+{
+    if(toRead->data.colorData != NULL)
     {
-        for (int x = 0; x < tempWidth; x++)
-        {
-            if(bitsUntilBufferEnd == 0)
-            {
-                returnChk = fread(&bufferByte, sizeof(uint8_t), 1, fp);
-                if(returnChk != 1)
-                {
-                    return false;
-                }
-                bitsUntilBufferEnd = 8;
-                bitMask = (0xFF << (8 - tempBPP));
-            };
-            pixArray[x + (tempWidth * y)].value = (bufferByte & bitMask)>>(bitsUntilBufferEnd - tempBPP);
-            bitMask >>= tempBPP;
-            bitsUntilBufferEnd -= tempBPP;
-        }
-        if(rowPadding/8 > 0)
-        {
-            // For some reason fseeking to skip the filler bytes does not work
-            //fseek(fp, (rowPadding/8), SEEK_CUR);
-            fread(&bufferByte, sizeof(uint8_t), rowPadding/8, fp);
-            bufferByte = 0;
-        }
+        return (toRead->data.colorData)[x + (toRead->data.width * y)].value;
     }
 
-    toReturn->data.colorData = pixArray;
-
-    // for(int y = 0; y < tempHeight; y++)
-    // {
-    //     printf("y = %d - ", y);
-    //     for (int x = 0; x < tempWidth; x++)
-    //     {
-    //         printf("%x ",(toReturn->data.colorData)[x + (tempWidth * y)].value);
-    //     }
-    //     printf("\n");
-    // }
-    
+    const uint8_t* row = bmpRow(toRead, y);
+    int bitDepth = toRead->data.bitDepth;
+    if(bitDepth < 8)
+    {
+        // Pixels are packed from the most significant bit down
+        int bitOffset = x * bitDepth;
+        uint8_t packed = row[bitOffset / 8];
+        return (packed >> (8 - bitDepth - (bitOffset % 8))) & ((1 << bitDepth) - 1);
+    }
 
-    return true;
+    // Bytes are little endian, so the first byte is the lowest
+    int bytesPerPixel = bitDepth / 8;
+    const uint8_t* pixel = row + (x * bytesPerPixel);
+    uint32_t toReturn = 0;
+    for(int i = bytesPerPixel - 1; i >= 0; i--)
+    {
+        toReturn <<= 8;
+        toReturn += pixel[i];
+    }
+    return (bitDepth == 16) ? expand555(toReturn) : toReturn;
 }
 
-bool readDataBytes(BMP* toReturn, FILE* fp)
+bool decodeRow(BMP* toRead, int y, uint32_t* values)
 {
-    if(toReturn == NULL || fp == NULL)
+    if(toRead == NULL || values == NULL)
     {
         return false;
     }
-    /* READ IN BMP PIXEL DATA */
-
-    /*
-        NOTE: This rowSize calculation looks complicated because
-        I did not want to link the math library, and as such abused
-        the fact that c uses a floor function to force division into ints.
-        The proper rowSize calculation is as follows:
-        RowSize = (ceil(BitsPerPixel * ImageWidth)/32) * 4
-
-        This rounds the RowSize up to a multiple of 4 bytes.
-    */
-    int rowSize = 0;
-    int rowPadding = 0;
-    int bytesPerPixel = toReturn->dib.bitsPerPixel/8;
 
-    rowSize = ((toReturn->dib.bmpWidth * toReturn->dib.bitsPerPixel) + 31) / 32;
-    rowSize = rowSize * 4;
-
-    // Padding is equal to the (bytes) rowsize
-    // minus the amount of bytes used to store the pixel data
-    rowPadding = rowSize - (toReturn->dib.bmpWidth * (bytesPerPixel));
-
-    /* START FILLING IN BMPDATA*/
-    toReturn->data.width = toReturn->dib.bmpWidth;
-    toReturn->data.height = toReturn->dib.bmpHeight;
-    toReturn->data.area = toReturn->data.width * toReturn->data.height;
-    toReturn->data.bitDepth = toReturn->dib.bitsPerPixel;
-    // TODO: hasAlpha, bitsForAlpha
+    int width = toRead->data.width;
+    if(toRead->data.colorData != NULL)
+    {
+        PIXEL* row = toRead->data.colorData + ((size_t)width * y);
+        for(int x = 0; x < width; x++)
+        {
+            values[x] = row[x].value;
+        }
+        return true;
+    }
+    if(toRead->data.rows == NULL)
+    {
+        return false;
+    }
 
-    PIXEL* pixArray = malloc(sizeof(PIXEL) * toReturn->data.area);
+    // Picks the SIMD kernel for this bit depth if the CPU has one
+    ROW_DECODER decoder = rowDecoder(toRead->data.bitDepth);
+    if(decoder == NULL)
+    {
+        return false;
+    }
+    decoder(bmpRow(toRead, y), values, width);
+    return true;
+}
 
-    // Start at beginning of color data
-    fseek(fp, toReturn->head.offset, SEEK_SET);
+bool readData(BMP* toReturn)
+{
+    if(toReturn == NULL || toReturn->data.rows == NULL)
+    {
+        return false;
+    }
+    if(toReturn->data.colorData != NULL)
+    {
+        return true;
+    }
+    /* READ IN BMP PIXEL DATA */
 
     // Used so for loops dont have to do pointer junk every iteration
     int tempHeight = toReturn->data.height;
     int tempWidth = toReturn->data.width;
 
-    int returnChk = 0;
-    uint32_t tempInt = 0;
-    uint8_t* byteBuffer = malloc(sizeof(uint8_t)* 8);
-    // Read in all pixel data
+    ARENA* arena = toReturn->arena;
+    PIXEL* pixArray = allocIn(arena, sizeof(PIXEL) * toReturn->data.area);
+    uint32_t* rowValues = allocIn(arena, sizeof(uint32_t) * tempWidth);
+    if(pixArray == NULL || rowValues == NULL)
+    {
+        freeIn(arena, pixArray);
+        freeIn(arena, rowValues);
+        return false;
+    }
+
+    // Rows come straight from the mapped file, so padding is skipped for free
     for(int y = 0; y < tempHeight; y++)
     {
-        for (int x = 0; x < tempWidth; x++)
+        if(!decodeRow(toReturn, y, rowValues))
+        {
+            freeIn(arena, pixArray);
+            freeIn(arena, rowValues);
+            return false;
+        }
+
+        PIXEL* row = pixArray + ((size_t)tempWidth * y);
+        for(int x = 0; x < tempWidth; x++)
         {
-            // Grab pixel
-            returnChk = fread(byteBuffer, sizeof(uint8_t), bytesPerPixel, fp);
-            if(returnChk != bytesPerPixel)
-            {
-                return false;
-            }
-
-            //Swap endianness of byteBuffer
-            tempInt = 0x0;
-            for(int i = bytesPerPixel - 1; i >= 0; i--)
-            {
-                // Bitshift by 8 to bump the previous byte added up one byte
-                // EXAMPLE: 0000000011111111 --> 1111111100000000
-                tempInt <<= 8;
-                tempInt += byteBuffer[i];
-            }
-            //Save to array
-            pixArray[x + (tempWidth * y)].value = tempInt;
+            row[x].value = rowValues[x];
+            row[x].red = 0;
+            row[x].green = 0;
+            row[x].blue = 0;
+            row[x].alpha = 0;
         }
-        // Skip row padding
-        fseek(fp, rowPadding, SEEK_CUR);
     }
-    
+    freeIn(arena, rowValues);
+
     toReturn->data.colorData = pixArray;
-    
-    // TODO: Remove this test print statement
-    // for(int y = 0; y < tempHeight; y++)
-    // {
-    //     printf("y = %d - ", y);
-    //     for (int x = 0; x < tempWidth; x++)
-    //     {
-    //         printf("%x ",(toReturn->data.colorData)[x + (tempWidth * y)].value);
-    //     }
-    //     printf("\n");
-    // }
-    
 
     return true;
 }
 
-bool readColorTable(BMP* toReturn, FILE* fp)
+uint64_t bmpPayloadHash(BMP* toHash)
+{
+    if(toHash == NULL || toHash->data.rows == NULL)
+    {
+        return 0;
+    }
+    const uint64_t prime1 = 0x9E3779B185EBCA87ULL;
+    const uint64_t prime2 = 0xC2B2AE3D27D4EB4FULL;
+
+    // Four lanes of multiply and rotate, so no multiply waits on the one before it
+    BMP_DATA* data = &(toHash->data);
+    uint64_t lanes[4] = {(uint64_t)data->width, (uint64_t)data->height, (uint64_t)data->bitDepth, data->cTable.length};
+    size_t size = (size_t)data->rowSize * data->height;
+    size_t at = 0;
+    for(; at + 32 <= size; at += 32)
+    {
+        for(int lane = 0; lane < 4; lane++)
+        {
+            uint64_t word = 0;
+            memcpy(&word, data->rows + at + (8 * lane), sizeof(uint64_t));
+            lanes[lane] += word * prime2;
+            lanes[lane] = ((lanes[lane] << 31) | (lanes[lane] >> 33)) * prime1;
+        }
+    }
+    uint64_t hash = lanes[0] ^ (lanes[1] * prime1) ^ (lanes[2] * prime2) ^ ((lanes[3] << 17) | (lanes[3] >> 47));
+    for(; at < size; at++)
+    {
+        hash = (hash ^ data->rows[at]) * prime1;
+    }
+
+    // Indexed pixels mean nothing without the colors they point at
+    for(uint32_t i = 0; data->HasCTable && i < data->cTable.length; i++)
+    {
+        hash = (hash ^ data->cTable.entries[i]) * prime1;
+    }
+    hash ^= hash >> 33;
+    hash *= prime2;
+    hash ^= hash >> 29;
+    return hash;
+}
+
+bool readColorTable(BMP* toReturn, const uint8_t* file, size_t fileSize)
 {
-    if(toReturn == NULL || fp == NULL)
+    if(toReturn == NULL || file == NULL)
     {
         return false;
     }
@@ -480,7 +483,7 @@ bool readColorTable(BMP* toReturn, FILE* fp)
         return true;
     }
 
-    int numColors = toReturn->dib.colorPalette;
+    uint32_t numColors = toReturn->dib.colorPalette;
 
     if(numColors == 0)
     {
@@ -490,10 +493,11 @@ bool readColorTable(BMP* toReturn, FILE* fp)
     // If the need to change this comes up, just un constant the variable
     const int numBytesPerEntry = 4;
 
-    // The amount of available space between the bitmap DIB and the start of the data
-    int spaceForColorTable = toReturn->head.offset - (14 + toReturn->dib.headerSize);
+    // The table has to fit between the DIB header and the start of the data, all in 64 bit so nothing wraps
+    uint64_t tableStart = 14 + (uint64_t)toReturn->dib.headerSize;
+    uint64_t tableEnd = tableStart + (numBytesPerEntry * (uint64_t)numColors);
 
-    if(numBytesPerEntry * numColors > spaceForColorTable)
+    if(tableEnd > toReturn->head.offset || toReturn->head.offset > fileSize)
     {
         if(toReturn->dib.colorPalette == 0)
         {
@@ -507,24 +511,13 @@ bool readColorTable(BMP* toReturn, FILE* fp)
         }
     }
     uint32_t* colorValues = malloc(sizeof(uint32_t) * numColors);
-    int returnChk = 0;
-    uint32_t tempVal = 0;
-    fseek(fp, (14 + toReturn->dib.headerSize), SEEK_SET);;
-    for(int i = 0; i < numColors; i++)
-    {
-        tempVal = 0;
-        returnChk = fread(&tempVal, numBytesPerEntry, 1, fp);
-        if(returnChk != 1)
-        {
-            free(colorValues);
-            return false;
-        }
-        colorValues[i] = tempVal;
+    if(colorValues == NULL)
+    {
+        return false;
     }
-    // for(int i = 0; i < numColors; i++)
-    // {
-    //     printf("COLOR TABLE %d - %x\n", i, colorValues[i]);
-    // }
+
+    // The table sits right after the DIB header and is already in the right byte order
+    memcpy(colorValues, file + tableStart, sizeof(uint32_t) * numColors);
 
     toReturn->data.HasCTable = true;
     toReturn->data.cTable.length = numColors;
@@ -567,17 +560,41 @@ bool endsWith(char* toCheck, char* ending)
 }
 
 
+// Rows are gathered into a buffer this big (or one row, if that is bigger) before every fwrite
+#define writeBufferSize (1 << 20)
+
 bool writeBMP(BMP* toWrite, char* fileName)
 {
     /* INITIALIZATION AND ERROR CHECKING */
 
-    if(fileName == NULL || toWrite == NULL)
+    if(fileName == NULL || toWrite == NULL || toWrite->data.colorData == NULL)
     {
-        return NULL;
+        return false;
     }
     if(!endsWith(fileName,".bmp"))
     {
-        return NULL;
+        return false;
+    }
+
+    uint32_t offset = bmpDataOffset(toWrite);
+    uint32_t rowSize = bmpRowSize(toWrite);
+    uint32_t fileSize = offset + (rowSize * toWrite->data.height);
+
+    // Whole rows are assembled in one buffer, which is reused for the header too
+    uint32_t rowsPerFlush = writeBufferSize / rowSize;
+    if(rowsPerFlush == 0)
+    {
+        rowsPerFlush = 1;
+    }
+    size_t bufferSize = (size_t)rowsPerFlush * rowSize;
+    if(bufferSize < offset)
+    {
+        bufferSize = offset;
+    }
+    uint8_t* buffer = malloc(bufferSize);
+    if(buffer == NULL)
+    {
+        return false;
     }
 
     // Open new file
@@ -585,298 +602,255 @@ bool writeBMP(BMP* toWrite, char* fileName)
     fp = fopen(fileName, "wb");
     if(fp == NULL)
     {
-        return NULL;
+        free(buffer);
+        return false;
     }
 
-    // Used to check the return value of various file functions
-    int returnChk = 0;
-    
-    // Set file pointer to beginning of file (unnessisary)
-    fseek(fp, 0x0, SEEK_SET);
-
-    // Used to store the new file size as stuff is written
-    uint32_t fileSize = 0x0;
-
-    // Temp variables used in fwrite to write static data
-    uint16_t toWrite16 = 0x0;
-    uint32_t toWrite32 = 0x0;
-
     /* START WRITING TO FILE */
-    fseek(fp, 0x0, SEEK_SET);
-
-    // Write BMP signiture
-    toWrite16 = bmpSignature;
-    returnChk = fwrite(&toWrite16, sizeof(uint16_t), 1, fp);
-    if(returnChk != 1) { goto writeError; }
-    fileSize += sizeof(uint16_t); 
-
-    // Skip filesize, reserved and offset, go to BMP header 
-    fseek(fp, 0x0E, SEEK_SET);
-    fileSize += sizeof(uint32_t) * 3;
-
-    // Write header size (40 for BITMAPINFOHEADER)
-    toWrite32 = 0x28; // 40 in decimal
-    returnChk = fwrite(&toWrite32, sizeof(uint32_t), 1, fp);
-    if(returnChk != 1) { goto writeError; }
-    fileSize += sizeof(uint32_t);
-
-    // Write bmpWidth
-    toWrite32 = toWrite->dib.bmpWidth;
-    returnChk = fwrite(&toWrite32, sizeof(uint32_t), 1, fp);
-    if(returnChk != 1) { goto writeError; }
-    fileSize += sizeof(uint32_t);
-    
-    // Write bmpHeight
-    toWrite32 = toWrite->dib.bmpHeight;
-    returnChk = fwrite(&toWrite32, sizeof(uint32_t), 1, fp);
-    if(returnChk != 1) { goto writeError; }
-    fileSize += sizeof(uint32_t);
-    
-    // Write colorPlanes
-    toWrite16 = 1; // Must be 1 according to spec
-    returnChk = fwrite(&toWrite16, sizeof(uint16_t), 1, fp);
-    if(returnChk != 1) { goto writeError; }
-    fileSize += sizeof(uint16_t);
-
-    // Write bitsPerPixel
-    toWrite16 = toWrite->dib.bitsPerPixel;
-    returnChk = fwrite(&toWrite16, sizeof(uint16_t), 1, fp);
-    if(returnChk != 1) { goto writeError; }
-    fileSize += sizeof(uint16_t);
-
-    // Write compression
-    toWrite32 = 0; // No compression
-    returnChk = fwrite(&toWrite32, sizeof(uint32_t), 1, fp);
-    if(returnChk != 1) { goto writeError; }
-    fileSize += sizeof(uint32_t);
-
-    // Write imageSize
-    toWrite32 = toWrite->dib.imageSize;
-    returnChk = fwrite(&toWrite32, sizeof(uint32_t), 1, fp);
-    if(returnChk != 1) { goto writeError; }
-    fileSize += sizeof(uint32_t);
-
-    // Write resWidthPPM
-    toWrite32 = 0; // This is dumb and nobody uses this
-    returnChk = fwrite(&toWrite32, sizeof(uint32_t), 1, fp);
-    if(returnChk != 1) { goto writeError; }
-    fileSize += sizeof(uint32_t);
-
-    // Write resHeightPPM
-    toWrite32 = 0; // This is dumb and nobody uses this
-    returnChk = fwrite(&toWrite32, sizeof(uint32_t), 1, fp);
-    if(returnChk != 1) { goto writeError; }
-    fileSize += sizeof(uint32_t);
-
-    // Write colorPalette
-    toWrite32 = toWrite->dib.colorPalette; 
-    returnChk = fwrite(&toWrite32, sizeof(uint32_t), 1, fp);
-    if(returnChk != 1) { goto writeError; }
-    fileSize += sizeof(uint32_t);
-
-    // Write importantColors
-    toWrite32 = toWrite->dib.importantColors; 
-    returnChk = fwrite(&toWrite32, sizeof(uint32_t), 1, fp);
-    if(returnChk != 1) { goto writeError; }
-    fileSize += sizeof(uint32_t);
-
-    if(!writeColorTable(toWrite, fp, &fileSize))
-    {
-        goto writeError;
-    }
-
-    /*
-        According to wikipedia specs the color data needs to start on an even multiple of 4 bytes
-        However, BMP readers seem to not like this extra padding
-        So I have commented it out
-    */
-
-    // toWrite32 = 0;
-    // while((ftell(fp) % 4) != 0)
-    // {
-    //     fwrite(&toWrite32, sizeof(uint8_t), 1, fp);
-    //     fileSize += sizeof(uint8_t);
-    // }
 
-    // Go to and write offset
-    fseek(fp, 0x0A, SEEK_SET);
+    writeHeaders(toWrite, buffer, fileSize);
+    countStat(syscalls, 3);
+    countStat(bytesWritten, offset);
+    if(fwrite(buffer, offset, 1, fp) != 1) { goto writeError; }
 
-    toWrite32 = fileSize; 
-    returnChk = fwrite(&toWrite32, sizeof(uint32_t), 1, fp);
-    if(returnChk != 1) { goto writeError; }
-
-    if(!writeData(toWrite, fp, &fileSize))
+    if(!writeData(toWrite, fp, buffer, rowsPerFlush))
     {
         goto writeError;
     }
 
-    // Go to and write file size
-    fseek(fp, 0x02, SEEK_SET);
-
-    toWrite32 = fileSize; 
-    returnChk = fwrite(&toWrite32, sizeof(uint32_t), 1, fp);
-    if(returnChk != 1) { goto writeError; }
-
+    free(buffer);
     fclose(fp);
     return true;
 
     writeError:
+    free(buffer);
     fclose(fp);
     errMsg("writeBMP", "Writing to BMP file failed!");
     return false;
 }
 
-bool writeData(BMP* toWrite, FILE* fp, uint32_t* fileSize)
+bool mapWriteBMP(BMP* toWrite, char* fileName)
 {
-    if(toWrite == NULL || fp == NULL || fileSize == NULL)
+    if(fileName == NULL || toWrite == NULL || toWrite->data.colorData == NULL)
+    {
+        return false;
+    }
+    if(!endsWith(fileName,".bmp"))
     {
         return false;
     }
 
-    bool success = true;
-    if(toWrite->dib.bitsPerPixel < 8)
+    uint32_t offset = bmpDataOffset(toWrite);
+    uint32_t rowSize = bmpRowSize(toWrite);
+    uint32_t fileSize = offset + (rowSize * toWrite->data.height);
+
+    // Size the file up front, then encode straight into the page cache
+    int fd = open(fileName, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if(fd < 0)
     {
-        success = writeDataBits(toWrite, fp, fileSize);
+        return false;
     }
-    else
+    if(ftruncate(fd, fileSize) != 0)
     {
-        success = writeDataBytes(toWrite, fp, fileSize);
+        close(fd);
+        errMsg("mapWriteBMP", "Could not size the BMP file!");
+        return false;
+    }
+    uint8_t* file = mmap(NULL, fileSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    countStat(syscalls, 5);
+    if(file == MAP_FAILED)
+    {
+        errMsg("mapWriteBMP", "Could not map the BMP file!");
+        return false;
+    }
+
+    writeHeaders(toWrite, file, fileSize);
+    for(int y = 0; y < toWrite->data.height; y++)
+    {
+        writeRow(toWrite, y, file + offset + ((size_t)rowSize * y));
+    }
+
+    bool success = (munmap(file, fileSize) == 0);
+    countStat(bytesWritten, fileSize);
+    if(!success)
+    {
+        errMsg("mapWriteBMP", "Writing to BMP file failed!");
     }
-    
     return success;
 }
 
-bool writeDataBits(BMP* toWrite, FILE* fp, uint32_t* fileSize)
+uint32_t bmpRowSize(BMP* toWrite)
+{
+    // Same rounding up to a multiple of 4 bytes as when reading
+    uint32_t rowSize = ((toWrite->data.width * toWrite->dib.bitsPerPixel) + 31) / 32;
+    return rowSize * 4;
+}
+
+uint32_t bmpDataOffset(BMP* toWrite)
 {
-    if(toWrite == NULL || fp == NULL || fileSize == NULL)
+    /*
+        According to wikipedia specs the color data needs to start on an even multiple of 4 bytes
+        However, BMP readers seem to not like this extra padding
+        So the data starts right after the color table
+    */
+    uint32_t offset = 14 + 40;
+    if(toWrite->data.HasCTable)
     {
-        return false;
+        offset += sizeof(uint32_t) * toWrite->data.cTable.length;
     }
+    return offset;
+}
 
-    // Return to current position and start writing pixel data
-    fseek(fp, (*fileSize), SEEK_SET);
-
-    int returnChk = 0;
-
-    int rowSize = 0;
+// Little endian stores into the header buffer
+static void put16(uint8_t* at, uint16_t value)
+{
+    memcpy(at, &value, sizeof(uint16_t));
+}
 
-    rowSize = ((toWrite->dib.bmpWidth * toWrite->dib.bitsPerPixel) + 31) / 32;
-    rowSize = rowSize * 4;
+static void put32(uint8_t* at, uint32_t value)
+{
+    memcpy(at, &value, sizeof(uint32_t));
+}
 
-    //rowSize is in bytes, and we want it in bits
-    rowSize = rowSize * 8;
+void writeHeaders(BMP* toWrite, uint8_t* dst, uint32_t fileSize)
+{
+    // File header
+    put16(dst + 0x00, bmpSignature);
+    put32(dst + 0x02, fileSize);
+    put16(dst + 0x06, 0); // reserved1
+    put16(dst + 0x08, 0); // reserved2
+    put32(dst + 0x0A, bmpDataOffset(toWrite));
+
+    // BITMAPINFOHEADER
+    put32(dst + 0x0E, 0x28); // 40 in decimal
+    put32(dst + 0x12, toWrite->dib.bmpWidth);
+    put32(dst + 0x16, toWrite->dib.bmpHeight);
+    put16(dst + 0x1A, 1); // Must be 1 according to spec
+    put16(dst + 0x1C, toWrite->dib.bitsPerPixel);
+    put32(dst + 0x1E, 0); // No compression
+    put32(dst + 0x22, toWrite->dib.imageSize);
+    put32(dst + 0x26, 0); // This is dumb and nobody uses this
+    put32(dst + 0x2A, 0); // This is dumb and nobody uses this
+    put32(dst + 0x2E, toWrite->dib.colorPalette);
+    put32(dst + 0x32, toWrite->dib.importantColors);
+
+    writeColorTable(toWrite, dst + 14 + 40);
+}
 
-    uint8_t packedByte = 0;
-    int currentBitsInByte = 8;
-    int rowTarget = rowSize;
+bool writeData(BMP* toWrite, FILE* fp, uint8_t* buffer, uint32_t rowsPerFlush)
+{
+    if(toWrite == NULL || fp == NULL || buffer == NULL)
+    {
+        return false;
+    }
 
-    int tempBPP = toWrite->data.bitDepth;
+    uint32_t rowSize = bmpRowSize(toWrite);
     int numRows = toWrite->data.height;
-    int pixelsPerRow = toWrite->data.width;
 
+    // Fill the buffer with as many whole rows as fit, then write them all at once
+    uint32_t rowsInBuffer = 0;
     for(int y = 0; y < numRows; y++)
     {
-        rowTarget = rowSize;
-        currentBitsInByte = 8;
-        for(int x = 0; x < pixelsPerRow; x++)
-        {
-            rowTarget -= tempBPP;
-            packedByte <<= tempBPP;
-            packedByte += (toWrite->data.colorData)[x + (pixelsPerRow * y)].value;
-            currentBitsInByte -= tempBPP;
-
-            if(currentBitsInByte <= 0)
-            {
-                returnChk = fwrite(&packedByte, sizeof(uint8_t), 1, fp);
-                if(returnChk != 1) { return false; }
-                (*fileSize) += 1;
-                currentBitsInByte = 8;
-                packedByte = 0;
-            }
-
-        }
-        while(rowTarget > 0)
+        writeRow(toWrite, y, buffer + ((size_t)rowSize * rowsInBuffer));
+        rowsInBuffer++;
+        if(rowsInBuffer == rowsPerFlush || y + 1 == numRows)
         {
-            rowTarget -= tempBPP;
-            packedByte <<= tempBPP;
-            currentBitsInByte -= tempBPP;
-
-            if(currentBitsInByte <= 0)
-            {
-                returnChk = fwrite(&packedByte, sizeof(uint8_t), 1, fp);
-                if(returnChk != 1) { return false; }
-                (*fileSize) += 1;
-                currentBitsInByte = 8;
-                packedByte = 0;
-            }
+            countStat(syscalls, 1);
+            countStat(bytesWritten, (size_t)rowSize * rowsInBuffer);
+            if(fwrite(buffer, (size_t)rowSize * rowsInBuffer, 1, fp) != 1) { return false; }
+            rowsInBuffer = 0;
         }
-
     }
 
     return true;
 }
 
-bool writeDataBytes(BMP* toWrite, FILE* fp, uint32_t* fileSize)
+void writeRow(BMP* toWrite, int y, uint8_t* dst)
 {
-    if(toWrite == NULL || fp == NULL || fileSize == NULL)
+    const PIXEL* row = toWrite->data.colorData + ((size_t)toWrite->data.width * y);
+    const uint8_t* values = (const uint8_t*)&(row->value);
+    if(toWrite->dib.bitsPerPixel < 8)
     {
-        return false;
+        writeDataBits(toWrite, values, sizeof(PIXEL), dst);
+    }
+    else
+    {
+        writeDataBytes(toWrite, values, sizeof(PIXEL), dst);
+    }
+}
+
+void encodeRow(BMP* toWrite, const uint32_t* values, uint8_t* dst)
+{
+    if(toWrite->dib.bitsPerPixel < 8)
+    {
+        writeDataBits(toWrite, (const uint8_t*)values, sizeof(uint32_t), dst);
     }
-    // Return to current position and start writing pixel data
-    fseek(fp, (*fileSize), SEEK_SET);
+    else
+    {
+        writeDataBytes(toWrite, (const uint8_t*)values, sizeof(uint32_t), dst);
+    }
+}
 
-    const uint32_t zero = 0x0;
-    int returnChk = 0x0;
+// Value of pixel x in a row of values that are stride bytes apart
+static uint32_t rowValue(const uint8_t* values, size_t stride, int x)
+{
+    uint32_t value = 0;
+    memcpy(&value, values + (stride * x), sizeof(uint32_t));
+    return value;
+}
 
-    int rowSize = 0;
-    int rowPadding = 0;
-    int pixelsPerRow = toWrite->dib.bmpWidth;
-    int numRows = toWrite->dib.bmpHeight;
+void writeDataBits(BMP* toWrite, const uint8_t* values, size_t stride, uint8_t* dst)
+{
+    int tempBPP = toWrite->dib.bitsPerPixel;
+    int pixelsPerRow = toWrite->data.width;
+    uint32_t rowSize = bmpRowSize(toWrite);
+    uint8_t valueMask = (1 << tempBPP) - 1;
 
+    // Padding bits and bytes are all zero
+    memset(dst, 0, rowSize);
+
+    // Pixels are packed from the most significant bit down
+    int pixelsPerByte = 8 / tempBPP;
+    for(int x = 0; x < pixelsPerRow; x++)
+    {
+        int shift = 8 - tempBPP - ((x % pixelsPerByte) * tempBPP);
+        dst[x / pixelsPerByte] |= (rowValue(values, stride, x) & valueMask) << shift;
+    }
+}
+
+void writeDataBytes(BMP* toWrite, const uint8_t* values, size_t stride, uint8_t* dst)
+{
     int bytesPerPixel = toWrite->dib.bitsPerPixel/8;
-    rowSize = ((toWrite->dib.bmpWidth * toWrite->dib.bitsPerPixel) + 31) / 32;
-    rowSize = rowSize * 4;
-    rowPadding = rowSize - (toWrite->dib.bmpWidth * (bytesPerPixel));
-    for(int y = 0; y < numRows; y++)
+    int pixelsPerRow = toWrite->data.width;
+    uint32_t rowSize = bmpRowSize(toWrite);
+
+    // Values are written back out little endian, the same way they were read
+    // (16 bpp values were widened to 0xRRGGBB, so they go back to 555 first)
+    bool packed = toWrite->dib.bitsPerPixel == 16;
+    uint8_t* out = dst;
+    for(int x = 0; x < pixelsPerRow; x++)
     {
-        for(int x = 0; x < pixelsPerRow; x++)
+        uint32_t value = packed ? pack555(rowValue(values, stride, x)) : rowValue(values, stride, x);
+        for(int i = 0; i < bytesPerPixel; i++)
         {
-            returnChk = fwrite(&((toWrite->data.colorData)[x + (pixelsPerRow * y)].value), bytesPerPixel, 1, fp);
-            if(returnChk != 1) { return false; }
-            (*fileSize) += bytesPerPixel;
+            out[i] = value & 0xFF;
+            value >>= 8;
         }
-        if(rowPadding != 0)
-        {
-            returnChk = fwrite(&zero, rowPadding, 1, fp); // Writes zeros for padding
-            if(returnChk != 1) { return false; }
-            (*fileSize) += rowPadding;
-        }
-
+        out += bytesPerPixel;
     }
-    return true;
+
+    // Writes zeros for padding
+    memset(out, 0, rowSize - (pixelsPerRow * bytesPerPixel));
 }
 
-bool writeColorTable(BMP* toWrite, FILE* fp, uint32_t* fileSize)
+void writeColorTable(BMP* toWrite, uint8_t* dst)
 {
-    if(toWrite == NULL || fp == NULL || fileSize == NULL)
-    {
-        return false;
-    }
     if(!toWrite->data.HasCTable)
     {
-        return true;
+        return;
     }
-
-    int numColors = toWrite->data.cTable.length;
-    int returnChk = 0;
-    
-    for(int i = 0; i < numColors; i++)
-    {
-        returnChk = fwrite(&((toWrite->data.cTable.entries)[i]), sizeof(uint32_t), 1, fp);
-        if(returnChk != 1){ return false; }
-        (*fileSize) += sizeof(uint32_t);
-    }
-    return true;
+    memcpy(dst, toWrite->data.cTable.entries, sizeof(uint32_t) * toWrite->data.cTable.length);
 }
 
 /*
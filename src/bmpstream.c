@@ -0,0 +1,265 @@
+// Needed for fseeko under -std=c99
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <sys/types.h>
+#include "bmpstream.h"
+#include "bmp.h"
+#include "rowdecode.h"
+#include "stats.h"
+
+BMP_STREAM* openBMPStream(char* fileName, int windowRows)
+{
+    if(fileName == NULL || !endsWith(fileName, ".bmp"))
+    {
+        return NULL;
+    }
+    BMP_STREAM* toReturn = calloc(1, sizeof(BMP_STREAM));
+    if(toReturn == NULL)
+    {
+        return NULL;
+    }
+    toReturn->fp = fopen(fileName, "rb");
+    toReturn->bmp = newBMP();
+    if(toReturn->fp == NULL || toReturn->bmp == NULL || fseeko(toReturn->fp, 0, SEEK_END) != 0)
+    {
+        closeBMPStream(&toReturn);
+        return NULL;
+    }
+    off_t fileSize = ftello(toReturn->fp);
+
+    // Only the headers and the color table are read up front, the rows start at offset
+    uint8_t first[54];
+    BMP* bmp = toReturn->bmp;
+    bool read = fileSize >= 54 && fseeko(toReturn->fp, 0, SEEK_SET) == 0 && fread(first, sizeof(first), 1, toReturn->fp) == 1
+        && readHeader(bmp, first, fileSize) && readDIB(bmp, first, fileSize)
+        && bmp->head.offset >= sizeof(first) && (off_t)bmp->head.offset <= fileSize;
+    uint8_t* headers = read ? malloc(bmp->head.offset) : NULL;
+    read = headers != NULL && fseeko(toReturn->fp, 0, SEEK_SET) == 0 && fread(headers, bmp->head.offset, 1, toReturn->fp) == 1
+        && readColorTable(bmp, headers, fileSize) && readRows(bmp, headers, fileSize);
+    free(headers);
+    countStat(syscalls, 7);
+    countStat(bytesRead, read ? sizeof(first) + bmp->head.offset : 0);
+
+    // readRows points rows into the header buffer, they are read through the window instead
+    bmp->data.rows = NULL;
+    toReturn->decoder = rowDecoder(bmp->data.bitDepth);
+    if(!read || toReturn->decoder == NULL)
+    {
+        closeBMPStream(&toReturn);
+        return NULL;
+    }
+
+    int rowSize = bmp->data.rowSize;
+    if(windowRows <= 0)
+    {
+        windowRows = streamWindowBytes / rowSize;
+    }
+    toReturn->windowRows = (windowRows > 0) ? windowRows : 1;
+    toReturn->window = malloc((size_t)rowSize * toReturn->windowRows);
+    toReturn->values = malloc(sizeof(uint32_t) * bmp->data.width);
+    if(toReturn->window == NULL || toReturn->values == NULL || fseeko(toReturn->fp, bmp->head.offset, SEEK_SET) != 0)
+    {
+        closeBMPStream(&toReturn);
+        return NULL;
+    }
+    return toReturn;
+}
+
+void closeBMPStream(BMP_STREAM** toFree)
+{
+    BMP_STREAM* temp = (*toFree);
+    if(temp == NULL)
+    {
+        return;
+    }
+    if(temp->fp != NULL)
+    {
+        fclose(temp->fp);
+        countStat(syscalls, 1);
+    }
+    if(temp->bmp != NULL)
+    {
+        freeBMP(&(temp->bmp));
+    }
+    free(temp->window);
+    free(temp->values);
+    free(temp);
+    (*toFree) = NULL;
+}
+
+const uint32_t* nextStreamRow(BMP_STREAM* stream, int* y)
+{
+    BMP_DATA* data = &(stream->bmp->data);
+    if(stream->nextRow >= data->height)
+    {
+        return NULL;
+    }
+
+    // Refill the window once every row in it has been handed out
+    if(stream->nextRow >= stream->windowFirst + stream->windowCount)
+    {
+        int rows = data->height - stream->nextRow;
+        rows = (rows < stream->windowRows) ? rows : stream->windowRows;
+        countStat(syscalls, 1);
+        if(fread(stream->window, (size_t)data->rowSize * rows, 1, stream->fp) != 1)
+        {
+            errMsg("nextStreamRow", "Bitmap data runs past the end of the file!");
+            return NULL;
+        }
+        countStat(bytesRead, (size_t)data->rowSize * rows);
+        stream->windowFirst = stream->nextRow;
+        stream->windowCount = rows;
+    }
+
+    const uint8_t* row = stream->window + ((size_t)data->rowSize * (stream->nextRow - stream->windowFirst));
+    stream->decoder(row, stream->values, data->width);
+    if(y != NULL)
+    {
+        (*y) = stream->nextRow;
+    }
+    stream->nextRow++;
+    return stream->values;
+}
+
+bool streamTiles(char* fileName, int tileWidth, int tileHeight, TILE_CALLBACK callback, void* context)
+{
+    if(tileWidth <= 0 || tileHeight <= 0 || callback == NULL)
+    {
+        return false;
+    }
+    BMP_STREAM* stream = openBMPStream(fileName, tileHeight);
+    if(stream == NULL)
+    {
+        return false;
+    }
+
+    // One band of decoded rows, cut into tiles once it is full
+    int width = stream->bmp->data.width;
+    int height = stream->bmp->data.height;
+    uint32_t* band = malloc(sizeof(uint32_t) * width * tileHeight);
+    bool success = band != NULL;
+    for(int bandY = 0; success && bandY < height; bandY += tileHeight)
+    {
+        int rows = (height - bandY < tileHeight) ? height - bandY : tileHeight;
+        for(int j = 0; success && j < rows; j++)
+        {
+            const uint32_t* values = nextStreamRow(stream, NULL);
+            success = values != NULL;
+            if(success)
+            {
+                memcpy(band + ((size_t)width * j), values, sizeof(uint32_t) * width);
+            }
+        }
+
+        for(int x = 0; success && x < width; x += tileWidth)
+        {
+            BMP_TILE tile;
+            tile.x = x;
+            tile.y = bandY;
+            tile.width = (width - x < tileWidth) ? width - x : tileWidth;
+            tile.height = rows;
+            tile.values = band + x;
+            tile.stride = width;
+            success = callback(&tile, context);
+        }
+    }
+
+    free(band);
+    closeBMPStream(&stream);
+    return success;
+}
+
+size_t streamBytes(BMP_STREAM* stream)
+{
+    BMP_DATA* data = &(stream->bmp->data);
+    return ((size_t)data->rowSize * stream->windowRows) + (sizeof(uint32_t) * data->width);
+}
+
+bool streamCopyBMP(char* inName, char* outName, const uint64_t* marked, uint32_t color)
+{
+    if(outName == NULL || !endsWith(outName, ".bmp"))
+    {
+        return false;
+    }
+    BMP_STREAM* stream = openBMPStream(inName, 0);
+    if(stream == NULL)
+    {
+        return false;
+    }
+    BMP* bmp = stream->bmp;
+    int width = bmp->data.width;
+    int height = bmp->data.height;
+
+    // Indexed bitmaps have no color to draw with
+    if(marked != NULL && (bmp->data.HasCTable || bmp->data.bitDepth < 16))
+    {
+        errMsg("streamCopyBMP", "Paths can only be drawn on 16, 24 or 32 bit bitmaps!");
+        marked = NULL;
+    }
+
+    // Output rows go through a window the same size as the input one
+    uint32_t offset = bmpDataOffset(bmp);
+    uint32_t rowSize = bmpRowSize(bmp);
+    uint32_t fileSize = offset + (rowSize * height);
+    size_t bufferSize = (size_t)rowSize * stream->windowRows;
+    bufferSize = (bufferSize < offset) ? offset : bufferSize;
+    uint8_t* buffer = malloc(bufferSize);
+    uint32_t* values = malloc(sizeof(uint32_t) * width);
+    FILE* fp = (buffer != NULL && values != NULL) ? fopen(outName, "wb") : NULL;
+    if(fp == NULL)
+    {
+        free(buffer);
+        free(values);
+        closeBMPStream(&stream);
+        return false;
+    }
+
+    writeHeaders(bmp, buffer, fileSize);
+    bool success = fwrite(buffer, offset, 1, fp) == 1;
+    countStat(syscalls, 3);
+    countStat(bytesWritten, offset);
+    int rowsInBuffer = 0;
+    int y = 0;
+    const uint32_t* row = NULL;
+    while(success && (row = nextStreamRow(stream, &y)) != NULL)
+    {
+        memcpy(values, row, sizeof(uint32_t) * width);
+        if(marked != NULL)
+        {
+            size_t first = (size_t)width * y;
+            for(int x = 0; x < width; x++)
+            {
+                size_t cell = first + x;
+                if((marked[cell >> 6] >> (cell & 63)) & 1)
+                {
+                    values[x] = color;
+                }
+            }
+        }
+        encodeRow(bmp, values, buffer + ((size_t)rowSize * rowsInBuffer));
+        rowsInBuffer++;
+        if(rowsInBuffer == stream->windowRows || y + 1 == height)
+        {
+            success = fwrite(buffer, (size_t)rowSize * rowsInBuffer, 1, fp) == 1;
+            countStat(syscalls, 1);
+            countStat(bytesWritten, (size_t)rowSize * rowsInBuffer);
+            rowsInBuffer = 0;
+        }
+    }
+    success = success && y + 1 == height && stream->nextRow == height;
+
+    free(buffer);
+    free(values);
+    closeBMPStream(&stream);
+    if(fclose(fp) != 0 || !success)
+    {
+        errMsg("streamCopyBMP", "Writing to BMP file failed!");
+        return false;
+    }
+    return true;
+}
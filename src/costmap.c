@@ -0,0 +1,168 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "costmap.h"
+#include "bmp.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define COSTMAP_X86
+#include <immintrin.h>
+#endif
+
+void costRamp(COST_TABLE* table, int threshold, int maxCost)
+{
+    threshold = (threshold < 1) ? 1 : threshold;
+    threshold = (threshold > 256) ? 256 : threshold;
+    maxCost = (maxCost < 1) ? 1 : maxCost;
+    maxCost = (maxCost > 255) ? 255 : maxCost;
+
+    // Levels are sums of three channels, so the threshold is too
+    int wallLevel = 3 * threshold;
+    for(int level = 0; level < costLevels; level++)
+    {
+        table->cost[level] = (level >= wallLevel) ? 0 : 1 + ((level * (maxCost - 1)) / wallLevel);
+    }
+    table->byIndex = false;
+}
+
+void costLookupFromBMP(BMP* toCheck, COST_TABLE* table, COST_LOOKUP* lookup)
+{
+    memset(lookup, 0, sizeof(COST_LOOKUP));
+    lookup->indexed = toCheck->data.bitDepth <= 8;
+    if(!lookup->indexed)
+    {
+        for(int level = 0; level < costLevels; level++)
+        {
+            lookup->cost[level] = table->cost[level];
+        }
+        return;
+    }
+
+    for(int i = 0; i < 256; i++)
+    {
+        if(table->byIndex)
+        {
+            lookup->cost[i] = table->cost[i];
+        }
+        else if(toCheck->data.HasCTable)
+        {
+            // Indices past the end of the color table are walls, same as openTableFromBMP
+            COLOR_TABLE* colors = &(toCheck->data.cTable);
+            lookup->cost[i] = ((uint32_t)i < colors->length) ? table->cost[colorLevel(colors->entries[i])] : 0;
+        }
+        else
+        {
+            // No color to go off of, so 0 is a wall and anything else is white
+            lookup->cost[i] = (i != 0) ? table->cost[0] : 0;
+        }
+    }
+}
+
+/* SCALAR KERNELS */
+
+// Pixels from firstX on, so the AVX2 kernels can hand over the end of the row
+static void costColorsFrom(const uint32_t* values, uint8_t* costs, uint64_t* walls, int firstX, int width,
+    const uint32_t* lookup)
+{
+    for(int x = firstX; x < width; x++)
+    {
+        uint32_t cost = lookup[colorLevel(values[x])];
+        costs[x] = cost;
+        walls[x >> 6] &= ~((uint64_t)(cost != 0) << (x & 63));
+    }
+}
+
+static void costIndicesFrom(const uint32_t* values, uint8_t* costs, uint64_t* walls, int firstX, int width,
+    const uint32_t* lookup)
+{
+    for(int x = firstX; x < width; x++)
+    {
+        uint32_t cost = lookup[values[x] & 0xFF];
+        costs[x] = cost;
+        walls[x >> 6] &= ~((uint64_t)(cost != 0) << (x & 63));
+    }
+}
+
+static void costColorsScalar(const uint32_t* values, uint8_t* costs, uint64_t* walls, int width, const uint32_t* lookup)
+{
+    costColorsFrom(values, costs, walls, 0, width, lookup);
+}
+
+static void costIndicesScalar(const uint32_t* values, uint8_t* costs, uint64_t* walls, int width, const uint32_t* lookup)
+{
+    costIndicesFrom(values, costs, walls, 0, width, lookup);
+}
+
+#ifdef COSTMAP_X86
+
+/* AVX2 KERNELS */
+
+// Stores the costs of the 8 pixels from x (each at most 255) as bytes, and clears the wall bits of the open ones
+__attribute__((target("avx2")))
+static inline void storeCosts(__m256i cost, uint8_t* costs, uint64_t* walls, int x)
+{
+    // Packing works per 128 bit lane, so pixels 0 - 3 end up in dword 0 and 4 - 7 in dword 4
+    __m256i words = _mm256_packus_epi32(cost, cost);
+    __m256i bytes = _mm256_packus_epi16(words, words);
+    __m256i joined = _mm256_permutevar8x32_epi32(bytes, _mm256_setr_epi32(0, 4, 0, 0, 0, 0, 0, 0));
+    _mm_storel_epi64((__m128i*)(costs + x), _mm256_castsi256_si128(joined));
+
+    // x is a multiple of 8, so the 8 bits never straddle two words
+    uint32_t wallBits = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(cost, _mm256_setzero_si256())));
+    walls[x >> 6] &= ~((uint64_t)(~wallBits & 0xFF) << (x & 63));
+}
+
+__attribute__((target("avx2")))
+static void costColorsAVX2(const uint32_t* values, uint8_t* costs, uint64_t* walls, int width, const uint32_t* lookup)
+{
+    const __m256i channelMask = _mm256_set1_epi32(0xFF);
+    const __m256i black = _mm256_set1_epi32(765);
+
+    int x = 0;
+    for(; x + 8 <= width; x += 8)
+    {
+        __m256i pixels = _mm256_loadu_si256((const __m256i*)(values + x));
+        __m256i blue = _mm256_and_si256(pixels, channelMask);
+        __m256i green = _mm256_and_si256(_mm256_srli_epi32(pixels, 8), channelMask);
+        __m256i red = _mm256_and_si256(_mm256_srli_epi32(pixels, 16), channelMask);
+        __m256i level = _mm256_sub_epi32(black, _mm256_add_epi32(_mm256_add_epi32(blue, green), red));
+        storeCosts(_mm256_i32gather_epi32((const int*)lookup, level, 4), costs, walls, x);
+    }
+    costColorsFrom(values, costs, walls, x, width, lookup);
+}
+
+__attribute__((target("avx2")))
+static void costIndicesAVX2(const uint32_t* values, uint8_t* costs, uint64_t* walls, int width, const uint32_t* lookup)
+{
+    const __m256i indexMask = _mm256_set1_epi32(0xFF);
+
+    int x = 0;
+    for(; x + 8 <= width; x += 8)
+    {
+        __m256i index = _mm256_and_si256(_mm256_loadu_si256((const __m256i*)(values + x)), indexMask);
+        storeCosts(_mm256_i32gather_epi32((const int*)lookup, index, 4), costs, walls, x);
+    }
+    costIndicesFrom(values, costs, walls, x, width, lookup);
+}
+
+#endif
+
+ROW_COSTER scalarRowCoster(bool indexed)
+{
+    return indexed ? costIndicesScalar : costColorsScalar;
+}
+
+ROW_COSTER rowCoster(bool indexed)
+{
+#ifdef COSTMAP_X86
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2"))
+    {
+        return indexed ? costIndicesAVX2 : costColorsAVX2;
+    }
+#endif
+
+    // Without gathers the SSE2 version would be the scalar loop with extra steps
+    return scalarRowCoster(indexed);
+}
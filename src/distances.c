@@ -0,0 +1,441 @@
+// Needed for pthreads under -std=c99
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <pthread.h>
+#include "distances.h"
+#include "algos.h"
+#include "maze.h"
+#include "pqueue.h"
+#include "stats.h"
+
+/* SWEEP */
+
+// Graph id of a cell, noCell if it is out of the maze or not something a search can start from
+static uint32_t endpointId(GRAPH* graph, uint32_t cell)
+{
+    if(cell >= (uint32_t)graph->width * (uint32_t)graph->height)
+    {
+        return noCell;
+    }
+    if(graph->mode == GRAPH_GRID)
+    {
+        return mazeCellIsOpen(graph->maze, cell) ? cell : noCell;
+    }
+    return cellId(graph, cell);
+}
+
+DISTANCE_SWEEP* newDistanceSweep(GRAPH* graph)
+{
+    if(graph == NULL)
+    {
+        return NULL;
+    }
+    DISTANCE_SWEEP* toReturn = calloc(1, sizeof(DISTANCE_SWEEP));
+    if(toReturn == NULL)
+    {
+        return NULL;
+    }
+    toReturn->numIds = graphIds(graph);
+    toReturn->open = newQueue(toReturn->numIds, NULL);
+    toReturn->cost = malloc(sizeof(uint32_t) * toReturn->numIds);
+    toReturn->stamp = calloc(toReturn->numIds, sizeof(uint32_t));
+    if(toReturn->open == NULL || toReturn->cost == NULL || toReturn->stamp == NULL)
+    {
+        freeDistanceSweep(&toReturn);
+        return NULL;
+    }
+    return toReturn;
+}
+
+void freeDistanceSweep(DISTANCE_SWEEP** toFree)
+{
+    DISTANCE_SWEEP* temp = (*toFree);
+    if(temp == NULL)
+    {
+        return;
+    }
+    freeQueue(&(temp->open));
+    free(temp->cost);
+    free(temp->stamp);
+    free(temp);
+    (*toFree) = NULL;
+}
+
+DISTANCE_TARGETS* newDistanceTargets(GRAPH* graph, uint32_t* cells, uint32_t count)
+{
+    if(graph == NULL || (cells == NULL && count > 0))
+    {
+        return NULL;
+    }
+    DISTANCE_TARGETS* toReturn = calloc(1, sizeof(DISTANCE_TARGETS));
+    if(toReturn == NULL)
+    {
+        return NULL;
+    }
+    uint32_t numIds = graphIds(graph);
+    toReturn->count = count;
+    toReturn->ids = malloc(sizeof(uint32_t) * (count + 1));
+    toReturn->isGoal = calloc((numIds / 64) + 1, sizeof(uint64_t));
+    if(toReturn->ids == NULL || toReturn->isGoal == NULL)
+    {
+        freeDistanceTargets(&toReturn);
+        return NULL;
+    }
+    for(uint32_t i = 0; i < count; i++)
+    {
+        uint32_t id = endpointId(graph, cells[i]);
+        toReturn->ids[i] = id;
+        if(id == noCell || ((toReturn->isGoal[id >> 6] >> (id & 63)) & 1))
+        {
+            continue;
+        }
+        toReturn->isGoal[id >> 6] |= (uint64_t)1 << (id & 63);
+        toReturn->distinct++;
+    }
+    return toReturn;
+}
+
+void freeDistanceTargets(DISTANCE_TARGETS** toFree)
+{
+    DISTANCE_TARGETS* temp = (*toFree);
+    if(temp == NULL)
+    {
+        return;
+    }
+    free(temp->ids);
+    free(temp->isGoal);
+    free(temp);
+    (*toFree) = NULL;
+}
+
+bool sweepDistances(GRAPH* graph, DISTANCE_SWEEP* sweep, uint32_t sourceCell, DISTANCE_TARGETS* targets,
+    uint32_t* distances, SEARCH_STATS* stats)
+{
+    if(graph == NULL || sweep == NULL || targets == NULL || distances == NULL || sweep->numIds != graphIds(graph))
+    {
+        return false;
+    }
+
+    // Stamps from before a wrap around could look current, so they are cleared once every 2^32 sweeps
+    sweep->generation++;
+    if(sweep->generation == 0)
+    {
+        memset(sweep->stamp, 0, sizeof(uint32_t) * sweep->numIds);
+        sweep->generation = 1;
+    }
+    uint32_t generation = sweep->generation;
+    uint32_t* cost = sweep->cost;
+    uint32_t* stamp = sweep->stamp;
+    PQUEUE* open = sweep->open;
+    queueClear(open);
+
+    uint32_t source = endpointId(graph, sourceCell);
+    uint32_t remaining = targets->distinct;
+    if(source != noCell)
+    {
+        stamp[source] = generation;
+        cost[source] = 0;
+        queuePush(open, source, 0);
+    }
+
+    // Every id comes off the open set once, with its final distance
+    uint32_t neighbours[4];
+    uint16_t costs[4];
+    while(remaining > 0 && !queueEmpty(open))
+    {
+        uint32_t current = queuePop(open);
+        if(stats != NULL)
+        {
+            stats->expanded++;
+        }
+        if((targets->isGoal[current >> 6] >> (current & 63)) & 1)
+        {
+            remaining--;
+        }
+
+        int count = idNeighbours(graph, current, neighbours, costs);
+        for(int i = 0; i < count; i++)
+        {
+            uint32_t next = neighbours[i];
+            uint32_t newCost = cost[current] + costs[i];
+            if(stamp[next] == generation && newCost >= cost[next])
+            {
+                continue;
+            }
+            bool queued = (stamp[next] == generation) ? queueDecrease(open, next, newCost) : queuePush(open, next, newCost);
+            if(!queued)
+            {
+                errMsg("sweepDistances", "Open set ran out of memory!");
+                return false;
+            }
+            stamp[next] = generation;
+            cost[next] = newCost;
+        }
+    }
+
+    // Either every goal came off the open set, or it ran dry and anything not stamped cannot be reached
+    for(uint32_t i = 0; i < targets->count; i++)
+    {
+        uint32_t id = targets->ids[i];
+        distances[i] = (id != noCell && stamp[id] == generation) ? cost[id] : noDistance;
+    }
+    return true;
+}
+
+bool distancesFrom(GRAPH* graph, uint32_t sourceCell, uint32_t* goalCells, uint32_t count, uint32_t* distances)
+{
+    DISTANCE_SWEEP* sweep = newDistanceSweep(graph);
+    DISTANCE_TARGETS* targets = newDistanceTargets(graph, goalCells, count);
+    bool success = sweep != NULL && targets != NULL && sweepDistances(graph, sweep, sourceCell, targets, distances, NULL);
+    freeDistanceSweep(&sweep);
+    freeDistanceTargets(&targets);
+    return success;
+}
+
+/* MATRIX */
+
+typedef struct MATRIX_JOBS_STRUCT {
+    GRAPH* graph;
+    DISTANCE_MATRIX* matrix;
+    DISTANCE_TARGETS* targets;
+
+    // Next source to hand out, and whether every sweep so far worked, guarded by lock
+    uint32_t next;
+    bool success;
+    pthread_mutex_t lock;
+} MATRIX_JOBS;
+
+// Takes sources off the shared counter until there are none left
+static void* matrixWorker(void* arg)
+{
+    MATRIX_JOBS* jobs = arg;
+    DISTANCE_MATRIX* matrix = jobs->matrix;
+
+    // A thread that cannot get search arrays of its own leaves the sources to the others
+    DISTANCE_SWEEP* sweep = newDistanceSweep(jobs->graph);
+    SEARCH_STATS stats = {0};
+    while(sweep != NULL)
+    {
+        pthread_mutex_lock(&(jobs->lock));
+        uint32_t source = jobs->next;
+        if(source < matrix->numSources && jobs->success)
+        {
+            jobs->next++;
+        }
+        else
+        {
+            source = matrix->numSources;
+        }
+        pthread_mutex_unlock(&(jobs->lock));
+        if(source >= matrix->numSources)
+        {
+            break;
+        }
+
+        uint32_t* row = matrix->distances + ((size_t)source * matrix->numTargets);
+        if(!sweepDistances(jobs->graph, sweep, matrix->sourceCells[source], jobs->targets, row, &stats))
+        {
+            pthread_mutex_lock(&(jobs->lock));
+            jobs->success = false;
+            pthread_mutex_unlock(&(jobs->lock));
+            break;
+        }
+    }
+    freeDistanceSweep(&sweep);
+
+    pthread_mutex_lock(&(jobs->lock));
+    matrix->expanded += stats.expanded;
+    pthread_mutex_unlock(&(jobs->lock));
+    return NULL;
+}
+
+DISTANCE_MATRIX* distanceMatrix(GRAPH* graph, uint32_t* sources, uint32_t numSources,
+    uint32_t* targets, uint32_t numTargets, int numThreads)
+{
+    if(graph == NULL || sources == NULL || targets == NULL || numSources == 0 || numTargets == 0)
+    {
+        return NULL;
+    }
+    DISTANCE_MATRIX* toReturn = calloc(1, sizeof(DISTANCE_MATRIX));
+    if(toReturn == NULL)
+    {
+        return NULL;
+    }
+    toReturn->numSources = numSources;
+    toReturn->numTargets = numTargets;
+    toReturn->sourceCells = malloc(sizeof(uint32_t) * numSources);
+    toReturn->targetCells = malloc(sizeof(uint32_t) * numTargets);
+    toReturn->distances = malloc(sizeof(uint32_t) * (size_t)numSources * numTargets);
+    MATRIX_JOBS jobs;
+    jobs.graph = graph;
+    jobs.matrix = toReturn;
+    jobs.targets = newDistanceTargets(graph, targets, numTargets);
+    jobs.next = 0;
+    jobs.success = true;
+    if(toReturn->sourceCells == NULL || toReturn->targetCells == NULL || toReturn->distances == NULL || jobs.targets == NULL)
+    {
+        freeDistanceTargets(&(jobs.targets));
+        freeDistanceMatrix(&toReturn);
+        return NULL;
+    }
+    memcpy(toReturn->sourceCells, sources, sizeof(uint32_t) * numSources);
+    memcpy(toReturn->targetCells, targets, sizeof(uint32_t) * numTargets);
+
+    // Every thread holds a full set of search arrays, so there is no point in more threads than sources
+    numThreads = (numThreads < 1) ? 1 : numThreads;
+    numThreads = ((uint32_t)numThreads > numSources) ? (int)numSources : numThreads;
+    pthread_t* threads = malloc(sizeof(pthread_t) * numThreads);
+    pthread_mutex_init(&(jobs.lock), NULL);
+    int started = 0;
+    for(int i = 0; threads != NULL && i < numThreads - 1; i++)
+    {
+        if(pthread_create(&(threads[i]), NULL, matrixWorker, &jobs) != 0)
+        {
+            break;
+        }
+        started++;
+    }
+
+    // The calling thread takes sources as well, and does all of them if no thread could be started
+    matrixWorker(&jobs);
+    for(int i = 0; i < started; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+    pthread_mutex_destroy(&(jobs.lock));
+    free(threads);
+    freeDistanceTargets(&(jobs.targets));
+
+    if(!jobs.success || jobs.next < numSources)
+    {
+        errMsg("distanceMatrix", "Could not sweep every source!");
+        freeDistanceMatrix(&toReturn);
+        return NULL;
+    }
+    return toReturn;
+}
+
+void freeDistanceMatrix(DISTANCE_MATRIX** toFree)
+{
+    DISTANCE_MATRIX* temp = (*toFree);
+    if(temp == NULL)
+    {
+        return;
+    }
+    free(temp->sourceCells);
+    free(temp->targetCells);
+    free(temp->distances);
+    free(temp);
+    (*toFree) = NULL;
+}
+
+/* FILES */
+
+bool saveDistanceMatrix(DISTANCE_MATRIX* matrix, char* fileName)
+{
+    if(matrix == NULL || fileName == NULL)
+    {
+        return false;
+    }
+
+    // Narrow entries unless a real distance would collide with UINT16_MAX
+    size_t entries = (size_t)matrix->numSources * matrix->numTargets;
+    bool narrow = true;
+    for(size_t i = 0; narrow && i < entries; i++)
+    {
+        narrow = matrix->distances[i] == noDistance || matrix->distances[i] < UINT16_MAX;
+    }
+    uint16_t* packed = narrow ? malloc(sizeof(uint16_t) * entries) : NULL;
+    if(narrow && packed == NULL)
+    {
+        return false;
+    }
+    for(size_t i = 0; narrow && i < entries; i++)
+    {
+        packed[i] = (matrix->distances[i] == noDistance) ? UINT16_MAX : matrix->distances[i];
+    }
+
+    FILE* fp = fopen(fileName, "wb");
+    if(fp == NULL)
+    {
+        errMsg("saveDistanceMatrix", "Could not open matrix file for writing!");
+        free(packed);
+        return false;
+    }
+    uint32_t header[4] = {distanceMatrixSignature, matrix->numSources, matrix->numTargets, narrow ? 2 : 4};
+    bool written = fwrite(header, sizeof(header), 1, fp) == 1
+        && fwrite(matrix->sourceCells, sizeof(uint32_t), matrix->numSources, fp) == matrix->numSources
+        && fwrite(matrix->targetCells, sizeof(uint32_t), matrix->numTargets, fp) == matrix->numTargets
+        && fwrite(narrow ? (void*)packed : (void*)matrix->distances, header[3], entries, fp) == entries;
+    free(packed);
+    countStat(syscalls, 6);
+    countStat(bytesWritten, sizeof(header) + (sizeof(uint32_t) * (matrix->numSources + matrix->numTargets)) + (header[3] * entries));
+
+    if(fclose(fp) != 0 || !written)
+    {
+        errMsg("saveDistanceMatrix", "Could not write matrix file!");
+        return false;
+    }
+    return true;
+}
+
+DISTANCE_MATRIX* loadDistanceMatrix(char* fileName)
+{
+    if(fileName == NULL)
+    {
+        return NULL;
+    }
+    FILE* fp = fopen(fileName, "rb");
+    if(fp == NULL)
+    {
+        return NULL;
+    }
+    uint32_t header[4];
+    if(fread(header, sizeof(header), 1, fp) != 1 || header[0] != distanceMatrixSignature
+        || header[1] == 0 || header[2] == 0 || (header[3] != 2 && header[3] != 4))
+    {
+        fclose(fp);
+        return NULL;
+    }
+
+    DISTANCE_MATRIX* toReturn = calloc(1, sizeof(DISTANCE_MATRIX));
+    if(toReturn == NULL)
+    {
+        fclose(fp);
+        return NULL;
+    }
+    toReturn->numSources = header[1];
+    toReturn->numTargets = header[2];
+    size_t entries = (size_t)header[1] * header[2];
+    toReturn->sourceCells = malloc(sizeof(uint32_t) * header[1]);
+    toReturn->targetCells = malloc(sizeof(uint32_t) * header[2]);
+    toReturn->distances = malloc(sizeof(uint32_t) * entries);
+    bool read = toReturn->sourceCells != NULL && toReturn->targetCells != NULL && toReturn->distances != NULL
+        && fread(toReturn->sourceCells, sizeof(uint32_t), header[1], fp) == header[1]
+        && fread(toReturn->targetCells, sizeof(uint32_t), header[2], fp) == header[2]
+        && fread(toReturn->distances, header[3], entries, fp) == entries;
+    fclose(fp);
+    countStat(syscalls, 6);
+    countStat(bytesRead, sizeof(header) + (sizeof(uint32_t) * (header[1] + header[2])) + (header[3] * entries));
+    if(!read)
+    {
+        freeDistanceMatrix(&toReturn);
+        return NULL;
+    }
+
+    // Narrow entries were read into the front of the array, widen them from the back so nothing is overwritten early
+    if(header[3] == 2)
+    {
+        uint16_t* packed = (uint16_t*)toReturn->distances;
+        for(size_t i = entries; i-- > 0;)
+        {
+            toReturn->distances[i] = (packed[i] == UINT16_MAX) ? noDistance : packed[i];
+        }
+    }
+    return toReturn;
+}
@@ -0,0 +1,543 @@
+// Needed for mmap, stat and fdopen under -std=c99
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "graphcache.h"
+#include "algos.h"
+#include "maze.h"
+#include "stats.h"
+
+#define cacheNameLength 4096
+
+/* LAYOUT */
+
+// Byte offsets of every section in a cache file
+typedef struct CACHE_LAYOUT_STRUCT {
+    size_t walls;
+    size_t nodeCell;
+    size_t cellOrder;
+    size_t edgeStart;
+    size_t edgeTarget;
+    size_t edgeCost;
+    size_t total;
+} CACHE_LAYOUT;
+
+static size_t alignSection(size_t bytes)
+{
+    return (bytes + 7) & ~(size_t)7;
+}
+
+// Only GRAPH_CSR renumbers its nodes, the others are in cell order already
+static uint32_t cellOrderLength(GRAPH_CACHE_HEADER* header)
+{
+    return (header->mode == GRAPH_CSR) ? header->numNodes : 0;
+}
+
+static CACHE_LAYOUT cacheLayout(GRAPH_CACHE_HEADER* header)
+{
+    CACHE_LAYOUT layout;
+    layout.walls = alignSection(sizeof(GRAPH_CACHE_HEADER));
+    layout.nodeCell = layout.walls + alignSection(sizeof(uint64_t) * header->rowWords * header->height);
+    layout.cellOrder = layout.nodeCell + alignSection(sizeof(uint32_t) * (size_t)header->numNodes);
+    layout.edgeStart = layout.cellOrder + alignSection(sizeof(uint32_t) * (size_t)cellOrderLength(header));
+    layout.edgeTarget = layout.edgeStart + alignSection(sizeof(uint32_t) * ((size_t)header->numNodes + 1));
+    layout.edgeCost = layout.edgeTarget + alignSection(sizeof(uint32_t) * (size_t)header->numEdges);
+    layout.total = layout.edgeCost + alignSection(sizeof(uint16_t) * (size_t)header->numEdges);
+    return layout;
+}
+
+// Writes a section and pads it out to 8 bytes
+static bool writeSection(FILE* fp, const void* data, size_t bytes)
+{
+    static const uint8_t zeros[8] = {0};
+    size_t padding = alignSection(bytes) - bytes;
+    countStat(syscalls, (bytes > 0) + (padding > 0));
+    countStat(bytesWritten, bytes + padding);
+    return (bytes == 0 || fwrite(data, bytes, 1, fp) == 1) && (padding == 0 || fwrite(zeros, padding, 1, fp) == 1);
+}
+
+// Creates a temporary file next to the cache to write a new one into
+// The name has the process and a counter in it, and O_EXCL makes sure no other thread or process has it
+static FILE* createTempCache(char* cacheName, char* tempName, size_t size)
+{
+    static uint32_t tempCount = 0;
+    uint32_t count = __atomic_add_fetch(&tempCount, 1, __ATOMIC_RELAXED);
+    snprintf(tempName, size, "%s.%ld.%u.tmp", cacheName, (long)getpid(), count);
+    int fd = open(tempName, O_WRONLY | O_CREAT | O_EXCL, 0666);
+    FILE* fp = (fd >= 0) ? fdopen(fd, "wb") : NULL;
+    if(fd >= 0 && fp == NULL)
+    {
+        close(fd);
+        remove(tempName);
+    }
+    return fp;
+}
+
+// Closes a temporary file and renames it over the cache, so anything that still
+// has the old one mapped keeps a whole file (the temporary file is removed on failure)
+static bool replaceCache(FILE* fp, bool written, char* tempName, char* cacheName)
+{
+    written = (fp != NULL && fclose(fp) == 0) && written && rename(tempName, cacheName) == 0;
+    countStat(syscalls, 4);
+    if(!written && fp != NULL)
+    {
+        remove(tempName);
+    }
+    return written;
+}
+
+static void sourceStat(struct stat* info, GRAPH_CACHE_HEADER* header)
+{
+    header->sourceSize = info->st_size;
+    header->sourceSeconds = info->st_mtim.tv_sec;
+    header->sourceNanos = info->st_mtim.tv_nsec;
+}
+
+/* SAVE */
+
+// Fills in the CSR arrays of a NODE graph (with malloc, no state or cellOrder), GRAPH_GRID gets empty ones
+static bool flattenNodes(GRAPH* graph, uint32_t numNodes, CSR* csr)
+{
+    memset(csr, 0, sizeof(CSR));
+    csr->nodeCell = malloc(sizeof(uint32_t) * numNodes);
+    csr->edgeStart = malloc(sizeof(uint32_t) * ((size_t)numNodes + 1));
+    csr->edgeTarget = malloc(sizeof(uint32_t) * (size_t)numNodes * 4);
+    csr->edgeCost = malloc(sizeof(uint16_t) * (size_t)numNodes * 4);
+    if((numNodes > 0 && (csr->nodeCell == NULL || csr->edgeTarget == NULL || csr->edgeCost == NULL)) || csr->edgeStart == NULL)
+    {
+        free(csr->nodeCell);
+        free(csr->edgeStart);
+        free(csr->edgeTarget);
+        free(csr->edgeCost);
+        return false;
+    }
+
+    uint32_t numEdges = 0;
+    for(uint32_t i = 0; i < numNodes; i++)
+    {
+        NODE* node = &(graph->nodes[i]);
+        NODE* links[4] = {node->up, node->down, node->left, node->right};
+        uint16_t costs[4] = {node->upCost, node->downCost, node->leftCost, node->rightCost};
+        csr->nodeCell[i] = node->x + (graph->width * node->y);
+        csr->edgeStart[i] = numEdges;
+        for(int j = 0; j < 4; j++)
+        {
+            if(links[j] != NULL)
+            {
+                csr->edgeTarget[numEdges] = links[j] - graph->nodes;
+                csr->edgeCost[numEdges] = costs[j];
+                numEdges++;
+            }
+        }
+    }
+    csr->edgeStart[numNodes] = numEdges;
+    csr->numEdges = numEdges;
+    if(numNodes > 0)
+    {
+        csr->startNode = graph->start - graph->nodes;
+        csr->endNode = graph->end - graph->nodes;
+    }
+    return true;
+}
+
+bool saveGraphCache(GRAPH* graph, char* bmpName)
+{
+    char cacheName[cacheNameLength];
+    char tempName[cacheNameLength + 32];
+    struct stat info;
+    if(graph == NULL || graph->maze == NULL || !graphCacheFileName(bmpName, cacheName, sizeof(cacheName))
+        || stat(bmpName, &info) != 0)
+    {
+        return false;
+    }
+    MAZE* maze = graph->maze;
+
+    GRAPH_CACHE_HEADER header = {0};
+    header.signature = graphCacheSignature;
+    header.version = graphCacheVersion;
+    header.mode = graph->mode;
+    header.width = graph->width;
+    header.height = graph->height;
+    header.rowWords = maze->rowWords;
+    header.openCells = graph->openCells;
+    header.startCell = graph->startCell;
+    header.endCell = graph->endCell;
+    header.startNode = graph->startCell;
+    header.endNode = graph->endCell;
+    header.weighted = maze->costs != NULL;
+    header.mazeHash = mazeHash(maze);
+    sourceStat(&info, &header);
+
+    // CSR graphs are written as they are, NODE graphs are flattened into edge lists
+    // in the same up, down, left, right order as idNeighbours
+    uint32_t numNodes = (graph->mode == GRAPH_GRID) ? 0 : graph->size;
+    CSR csr = graph->csr;
+    bool flatten = graph->mode != GRAPH_CSR;
+    if(flatten && !flattenNodes(graph, numNodes, &csr))
+    {
+        return false;
+    }
+    header.numNodes = numNodes;
+    header.numEdges = csr.numEdges;
+    if(numNodes > 0)
+    {
+        header.startNode = csr.startNode;
+        header.endNode = csr.endNode;
+    }
+
+    FILE* fp = createTempCache(cacheName, tempName, sizeof(tempName));
+    bool written = fp != NULL
+        && writeSection(fp, &header, sizeof(header))
+        && writeSection(fp, maze->walls, sizeof(uint64_t) * maze->rowWords * maze->height)
+        && writeSection(fp, csr.nodeCell, sizeof(uint32_t) * numNodes)
+        && writeSection(fp, csr.cellOrder, sizeof(uint32_t) * cellOrderLength(&header))
+        && writeSection(fp, csr.edgeStart, sizeof(uint32_t) * ((size_t)numNodes + 1))
+        && writeSection(fp, csr.edgeTarget, sizeof(uint32_t) * csr.numEdges)
+        && writeSection(fp, csr.edgeCost, sizeof(uint16_t) * csr.numEdges);
+    written = replaceCache(fp, written, tempName, cacheName);
+
+    if(flatten)
+    {
+        free(csr.nodeCell);
+        free(csr.edgeStart);
+        free(csr.edgeTarget);
+        free(csr.edgeCost);
+    }
+    if(!written)
+    {
+        errMsg("saveGraphCache", "Could not write graph cache file!");
+        return false;
+    }
+    return true;
+}
+
+/* LOAD */
+
+static bool inMap(GRAPH* graph, const void* pointer)
+{
+    const uint8_t* map = graph->cacheMap;
+    return (const uint8_t*)pointer >= map && (const uint8_t*)pointer < map + graph->cacheBytes;
+}
+
+// Drops every pointer into the mapped file, so freeGraph only frees what was allocated
+// (a maze decoded by the caller keeps its walls)
+static void forgetMapped(GRAPH* graph)
+{
+    CSR* csr = &(graph->csr);
+    if(graph->maze != NULL && inMap(graph, graph->maze->walls))
+    {
+        graph->maze->walls = NULL;
+    }
+    if(inMap(graph, csr->nodeCell))
+    {
+        csr->nodeCell = NULL;
+        csr->cellOrder = NULL;
+        csr->edgeStart = NULL;
+        csr->edgeTarget = NULL;
+        csr->edgeCost = NULL;
+    }
+}
+
+// Turns the edge lists into NODEs, false if a node or an edge points outside the graph
+static bool linkCachedNodes(GRAPH* graph, GRAPH_CACHE_HEADER* header, uint8_t* map, CACHE_LAYOUT* layout)
+{
+    const uint32_t* nodeCell = (const uint32_t*)(map + layout->nodeCell);
+    const uint32_t* edgeStart = (const uint32_t*)(map + layout->edgeStart);
+    const uint32_t* edgeTarget = (const uint32_t*)(map + layout->edgeTarget);
+    const uint16_t* edgeCost = (const uint16_t*)(map + layout->edgeCost);
+    NODE* nodes = graph->nodes;
+    uint32_t numNodes = header->numNodes;
+    uint64_t area = (uint64_t)header->width * header->height;
+    for(uint32_t i = 0; i < numNodes; i++)
+    {
+        if(nodeCell[i] >= area)
+        {
+            return false;
+        }
+        nodes[i].x = nodeCell[i] % header->width;
+        nodes[i].y = nodeCell[i] / header->width;
+        nodes[i].cost = UINT32_MAX;
+    }
+
+    for(uint32_t i = 0; i < numNodes; i++)
+    {
+        NODE* current = &(nodes[i]);
+        if(edgeStart[i] > edgeStart[i + 1] || edgeStart[i + 1] > header->numEdges)
+        {
+            return false;
+        }
+        for(uint32_t e = edgeStart[i]; e < edgeStart[i + 1]; e++)
+        {
+            if(edgeTarget[e] >= numNodes)
+            {
+                return false;
+            }
+            NODE* next = &(nodes[edgeTarget[e]]);
+            if(next->y > current->y)
+            {
+                current->up = next;
+                current->upCost = edgeCost[e];
+            }
+            else if(next->y < current->y)
+            {
+                current->down = next;
+                current->downCost = edgeCost[e];
+            }
+            else if(next->x < current->x)
+            {
+                current->left = next;
+                current->leftCost = edgeCost[e];
+            }
+            else
+            {
+                current->right = next;
+                current->rightCost = edgeCost[e];
+            }
+        }
+    }
+    return true;
+}
+
+// Points the CSR arrays straight at the file, only the search state is allocated
+// Every index is checked once here, so a damaged file is rebuilt instead of read out of bounds by solveCSR
+static bool csrOnCache(GRAPH* graph, GRAPH_CACHE_HEADER* header, uint8_t* map, CACHE_LAYOUT* layout)
+{
+    CSR* csr = &(graph->csr);
+    uint32_t numNodes = header->numNodes;
+    uint32_t numEdges = header->numEdges;
+    uint64_t area = (uint64_t)header->width * header->height;
+    csr->numEdges = numEdges;
+    csr->nodeCell = (uint32_t*)(map + layout->nodeCell);
+    csr->cellOrder = (uint32_t*)(map + layout->cellOrder);
+    csr->edgeStart = (uint32_t*)(map + layout->edgeStart);
+    csr->edgeTarget = (uint32_t*)(map + layout->edgeTarget);
+    csr->edgeCost = (uint16_t*)(map + layout->edgeCost);
+    csr->startNode = header->startNode;
+    csr->endNode = header->endNode;
+    csr->state = allocIn(graph->arena, sizeof(CSR_STATE) * numNodes);
+    if(csr->state == NULL || csr->edgeStart[numNodes] != numEdges)
+    {
+        return false;
+    }
+    for(uint32_t i = 0; i < numNodes; i++)
+    {
+        if(csr->nodeCell[i] >= area || csr->cellOrder[i] >= numNodes || csr->edgeStart[i] > csr->edgeStart[i + 1])
+        {
+            return false;
+        }
+        CSR_STATE* state = &(csr->state[i]);
+        state->stamp = 0;
+        state->cost = UINT32_MAX;
+        state->from = noCell;
+        state->x = csr->nodeCell[i] % header->width;
+        state->y = csr->nodeCell[i] / header->width;
+    }
+    for(uint32_t e = 0; e < numEdges; e++)
+    {
+        if(csr->edgeTarget[e] >= numNodes)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Points the maze at the mapped walls (maze NULL) and fills in the rest of the graph
+static GRAPH* graphOnCache(GRAPH_CACHE_HEADER* header, uint8_t* map, CACHE_LAYOUT* layout, MAZE* maze, ARENA* arena)
+{
+    GRAPH* toReturn = callocIn(arena, 1, sizeof(GRAPH));
+    if(toReturn == NULL)
+    {
+        return NULL;
+    }
+    toReturn->arena = arena;
+    toReturn->mode = header->mode;
+    toReturn->width = header->width;
+    toReturn->height = header->height;
+    toReturn->startCell = header->startCell;
+    toReturn->endCell = header->endCell;
+    toReturn->openCells = header->openCells;
+    toReturn->cacheMap = map;
+    toReturn->cacheBytes = layout->total;
+
+    if(maze == NULL)
+    {
+        maze = callocIn(arena, 1, sizeof(MAZE));
+        if(maze == NULL)
+        {
+            freeIn(arena, toReturn);
+            return NULL;
+        }
+        maze->arena = arena;
+        maze->width = header->width;
+        maze->height = header->height;
+        maze->rowWords = header->rowWords;
+        maze->walls = (uint64_t*)(map + layout->walls);
+        maze->startCell = header->startCell;
+        maze->endCell = header->endCell;
+        maze->openCells = header->openCells;
+    }
+    toReturn->maze = maze;
+
+    if(header->mode == GRAPH_GRID)
+    {
+        GRID* grid = &(toReturn->grid);
+        grid->width = header->width;
+        grid->height = header->height;
+        grid->maze = maze;
+        toReturn->size = header->openCells;
+        return toReturn;
+    }
+
+    bool linked = false;
+    toReturn->size = header->numNodes;
+    toReturn->open = newQueue(header->numNodes, arena);
+    if(toReturn->open != NULL && header->startNode < header->numNodes && header->endNode < header->numNodes)
+    {
+        if(header->mode == GRAPH_CSR)
+        {
+            linked = csrOnCache(toReturn, header, map, layout);
+        }
+        else
+        {
+            toReturn->nodes = callocIn(arena, header->numNodes, sizeof(NODE));
+            linked = toReturn->nodes != NULL && linkCachedNodes(toReturn, header, map, layout);
+        }
+    }
+    if(!linked)
+    {
+        // loadGraphCache unmaps the file, and a maze passed in still belongs to the caller
+        if(toReturn->maze->walls != (uint64_t*)(map + layout->walls))
+        {
+            toReturn->maze = NULL;
+        }
+        forgetMapped(toReturn);
+        toReturn->cacheMap = NULL;
+        freeGraph(&toReturn);
+        return NULL;
+    }
+    if(toReturn->nodes != NULL)
+    {
+        toReturn->start = &(toReturn->nodes[header->startNode]);
+        toReturn->end = &(toReturn->nodes[header->endNode]);
+    }
+    return toReturn;
+}
+
+GRAPH* loadGraphCache(char* bmpName, GRAPH_MODE mode, MAZE* maze, ARENA* arena)
+{
+    char cacheName[cacheNameLength];
+    struct stat info;
+    if(!graphCacheFileName(bmpName, cacheName, sizeof(cacheName)) || stat(bmpName, &info) != 0)
+    {
+        return NULL;
+    }
+    int fd = open(cacheName, O_RDONLY);
+    countStat(syscalls, 2);
+    if(fd < 0)
+    {
+        return NULL;
+    }
+    struct stat cacheInfo;
+    if(fstat(fd, &cacheInfo) != 0 || (size_t)cacheInfo.st_size < sizeof(GRAPH_CACHE_HEADER))
+    {
+        close(fd);
+        return NULL;
+    }
+
+    // Private and writable, so the walls can be changed without touching the file
+    size_t bytes = cacheInfo.st_size;
+    uint8_t* map = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    countStat(syscalls, 3);
+    if(map == MAP_FAILED)
+    {
+        return NULL;
+    }
+    countStat(bytesRead, bytes);
+
+    GRAPH_CACHE_HEADER* header = (GRAPH_CACHE_HEADER*)map;
+    CACHE_LAYOUT layout = cacheLayout(header);
+    bool valid = header->signature == graphCacheSignature && header->version == graphCacheVersion
+        && header->mode == (uint32_t)mode && header->width > 0 && header->height > 0
+        && header->rowWords == (header->width / 64) + 1 && layout.total == bytes;
+
+    // Unchanged file, or the same walls in a file that was copied or touched
+    GRAPH_CACHE_HEADER current = *header;
+    sourceStat(&info, &current);
+    bool sameFile = current.sourceSize == header->sourceSize && current.sourceSeconds == header->sourceSeconds
+        && current.sourceNanos == header->sourceNanos;
+    if(valid && maze != NULL)
+    {
+        // The walls are in the file, so they are compared as they are instead of trusting a hash
+        // The costs are not, so a weighted maze still needs the hash to match as well
+        valid = (uint32_t)maze->width == header->width && (uint32_t)maze->height == header->height
+            && maze->rowWords == header->rowWords && header->weighted == (maze->costs != NULL)
+            && memcmp(maze->walls, map + layout.walls, sizeof(uint64_t) * header->rowWords * header->height) == 0
+            && (maze->costs == NULL || mazeHash(maze) == header->mazeHash);
+    }
+    else if(valid)
+    {
+        valid = sameFile && header->weighted == 0;
+    }
+
+    GRAPH* toReturn = valid ? graphOnCache(header, map, &layout, maze, arena) : NULL;
+    if(toReturn == NULL)
+    {
+        munmap(map, bytes);
+        countStat(syscalls, 1);
+        return NULL;
+    }
+
+    // Saves decoding the maze again next time, through a new file like saveGraphCache
+    // since other processes can have this one mapped
+    if(!sameFile)
+    {
+        char tempName[cacheNameLength + 32];
+        FILE* fp = createTempCache(cacheName, tempName, sizeof(tempName));
+        bool written = fp != NULL && writeSection(fp, &current, sizeof(current))
+            && writeSection(fp, map + sizeof(current), bytes - sizeof(current));
+        if(!replaceCache(fp, written, tempName, cacheName))
+        {
+            errMsg("loadGraphCache", "Could not update graph cache file!");
+        }
+    }
+    return toReturn;
+}
+
+void closeGraphCache(GRAPH* graph)
+{
+    if(graph == NULL || graph->cacheMap == NULL)
+    {
+        return;
+    }
+
+    forgetMapped(graph);
+    munmap(graph->cacheMap, graph->cacheBytes);
+    countStat(syscalls, 1);
+    graph->cacheMap = NULL;
+    graph->cacheBytes = 0;
+}
+
+bool graphCacheFileName(char* bmpName, char* cacheName, size_t size)
+{
+    if(bmpName == NULL || cacheName == NULL)
+    {
+        return false;
+    }
+    int baseLength = strlen(bmpName);
+    if(endsWith(bmpName, ".bmp"))
+    {
+        baseLength -= 4;
+    }
+    int written = snprintf(cacheName, size, "%.*s.graph", baseLength, bmpName);
+    return written > 0 && (size_t)written < size;
+}
@@ -3,7 +3,11 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include "bmp.h"
+#include "maze.h"
+#include "pqueue.h"
+#include "arena.h"
 
 typedef struct GRAPH_NODE {
     struct GRAPH_NODE* up;
@@ -15,21 +19,262 @@ typedef struct GRAPH_NODE {
     struct GRAPH_NODE* right;
     uint16_t rightCost;
 
-    bool visited;
+    // cost and from are only valid if stamp is from the current search (see nextGeneration)
+    uint32_t stamp;
     uint32_t cost;
     struct GRAPH_NODE* from;
 
+    // Pixel coordinates of the node (y = 0 is the bottom row, same as colorData)
+    uint16_t x;
+    uint16_t y;
+
 } NODE;
 
+typedef enum GRAPH_MODE_ENUM {
+    // One NODE per open pixel, linked to its four neighbours
+    GRAPH_FULL,
+
+    // No NODEs at all, neighbours are derived from the pixel coordinates
+    GRAPH_GRID,
+
+    // NODEs only at junctions, turns and dead ends, straight corridors
+    // between them are collapsed into a single edge with the corridor length as cost
+    // (the sum of its step costs in a weighted maze, see costmap.h)
+    GRAPH_CORRIDOR,
+
+    // The GRAPH_CORRIDOR nodes and edges, kept in flat CSR arrays instead of linked NODEs
+    GRAPH_CSR
+} GRAPH_MODE;
+
+/*
+    Implicit grid used by GRAPH_GRID.
+    Cells are indexed x + (width * y), the same way colorData is.
+    Walls come from the packed MAZE bitset and search state is kept in flat
+    arrays next to it instead of in NODEs, so a cell costs 12 bytes
+    and a bit instead of a whole NODE.
+*/
+typedef struct GRAPH_GRID_STRUCT {
+    int width;
+    int height;
+
+    // Wall bitset (owned by the GRAPH)
+    MAZE* maze;
+
+    // Per cell search state, cost and from are only valid if stamp is from the current search
+    // (NULL until gridSearchState is called)
+    uint32_t* cost;
+    uint32_t* from;
+    uint32_t* stamp;
+} GRID;
+
+// Search state of one CSR node, kept together so a node is a single cache line visit
+typedef struct CSR_STATE_STRUCT {
+    // cost and from are only valid if stamp is from the current search
+    uint32_t stamp;
+    uint32_t cost;
+    uint32_t from;
+
+    // Pixel coordinates of the node, for the heuristic
+    uint16_t x;
+    uint16_t y;
+} CSR_STATE;
+
+/*
+    Compressed sparse row layout used by GRAPH_CSR.
+    The edges of a node sit next to each other in edgeTarget and edgeCost,
+    so its neighbours are one contiguous read instead of four pointers into
+    NODEs that are mostly padding. Nodes are numbered breadth first from the
+    start, so nodes that are close in the maze (and get expanded around the
+    same time) are close in memory too.
+*/
+typedef struct GRAPH_CSR_STRUCT {
+    uint32_t numEdges;
+
+    // Cell of every node, and the node ids sorted by cell (for cellId)
+    uint32_t* nodeCell;
+    uint32_t* cellOrder;
+
+    // The edges of node n are [edgeStart[n], edgeStart[n + 1])
+    uint32_t* edgeStart;
+    uint32_t* edgeTarget;
+    uint16_t* edgeCost;
+
+    // Ids of the start and end nodes
+    uint32_t startNode;
+    uint32_t endNode;
+
+    CSR_STATE* state;
+} CSR;
+
 typedef struct GRAPH_STRUCT {
     NODE* start;
     NODE* end;
 
     // NOTE: size includes start and end nodes
     uint32_t size;
+
+    // Number of open pixels in the maze (equal to size unless corridors are compressed)
+    uint32_t openCells;
+
+    GRAPH_MODE mode;
+
+    // Size of the maze the graph was built from
+    int width;
+    int height;
+
+    // Start and end as cell indices, valid in every mode
+    uint32_t startCell;
+    uint32_t endCell;
+
+    // All nodes are allocated in one block (NULL in GRAPH_GRID and GRAPH_CSR mode)
+    NODE* nodes;
+
+    // Only filled in GRAPH_GRID mode
+    GRID grid;
+
+    // Only filled in GRAPH_CSR mode (nodes is NULL then)
+    CSR csr;
+
+    // Wall bitset the graph was built from
+    MAZE* maze;
+
+    /*
+        Search state is never cleared between searches. Every search bumps the
+        generation and stamps what it touches with 2 * generation (open) or
+        2 * generation + 1 (closed), so anything with an older stamp counts as
+        untouched and a search only costs what it looks at.
+        The open set is kept for the same reason, it only has to be emptied.
+    */
+    uint32_t generation;
+    PQUEUE* open;
+
+    // Landmark tables A* uses on top of Manhattan distance (NULL if there are none, owned by the graph)
+    struct LANDMARKS_STRUCT* landmarks;
+
+    // Cluster abstraction for solveHPA (NULL if there is none, owned by the graph)
+    struct HPA_STRUCT* hpa;
+
+    // Graph cache file the graph was loaded from (NULL if it was built, see graphcache.h)
+    void* cacheMap;
+    size_t cacheBytes;
+
+    // Where the graph, search state and paths come from (NULL = malloc)
+    // With an arena nothing is given back by freeGraph, freePath or the solvers,
+    // so callers that solve more than once should arenaMark before and arenaRelease after
+    ARENA* arena;
 } GRAPH;
 
-GRAPH* graphFromBMP(BMP* toConvert);
+typedef struct PATH_STRUCT {
+    // Cells on the path from start to end, as indices into colorData
+    // Consecutive cells are always in a straight line, but not always adjacent
+    uint32_t* cells;
+    uint32_t length;
+
+    // Total cost of the path
+    uint32_t cost;
+
+    // Arena the cells came from (NULL = malloc)
+    ARENA* arena;
+} PATH;
+
+// One start / end question for solveQueries
+typedef struct QUERY_STRUCT {
+    uint32_t startCell;
+    uint32_t endCell;
+
+    // Filled in by solveQueries (path has to start zeroed)
+    bool found;
+    PATH path;
+    uint64_t expanded;
+} QUERY;
+
+typedef struct SEARCH_STATS_STRUCT {
+    // Number of nodes taken off the open set
+    uint64_t expanded;
+
+    // Split of expanded between the two directions of a bidirectional search
+    // (everything counts as forward for a one way search)
+    uint64_t forwardExpanded;
+    uint64_t backwardExpanded;
+} SEARCH_STATS;
+
+// Value used for "no cell" in the flat search arrays
+#define noCell UINT32_MAX
+
+// Builds a graph from a maze bitmap (white = open, black = wall)
+// Everything is allocated from arena if it is not NULL
+GRAPH* graphFromBMP(BMP* toConvert, GRAPH_MODE mode, ARENA* arena, int numThreads);
+
+// Builds a graph from a wall bitset, the graph takes ownership of the maze and uses its arena
+// NODE graphs are built in bands of rows on up to numThreads threads, node ids do not depend on the count
+GRAPH* graphFromMaze(MAZE* maze, GRAPH_MODE mode, int numThreads);
+
+// Frees a GRAPH struct and all subelements
+void freeGraph(GRAPH** toFree);
+
+// Fills in the four neighbours of a cell, returns how many are open
+int gridNeighbours(GRID* grid, uint32_t cell, uint32_t neighbours[4]);
+
+// Allocates the search arrays and open set of a GRAPH_GRID graph the first time it is searched
+// (does nothing for other modes). Callers that arenaMark between searches should call it before the mark
+bool gridSearchState(GRAPH* graph);
+
+// Marks every cell of the grid as untouched (only needed when the stamps run out)
+void resetGrid(GRID* grid);
+
+// Starts a new search on the graph, returns the stamp for touched nodes (closed is one more)
+uint32_t nextGeneration(GRAPH* graph);
+
+// Node at a cell (NULL in GRAPH_GRID mode or if the cell was collapsed into a corridor)
+NODE* nodeAtCell(GRAPH* graph, uint32_t cell);
+
+/*
+    Ids number the vertices of a graph in every mode, so per vertex arrays and
+    open sets work the same everywhere: node indices for NODE graphs,
+    cell indices in GRAPH_GRID mode.
+*/
+
+// Number of ids, every id is smaller than this
+uint32_t graphIds(GRAPH* graph);
+
+// Id of a cell (noCell if the cell has no node)
+uint32_t cellId(GRAPH* graph, uint32_t cell);
+
+// Cell index of an id
+uint32_t idCell(GRAPH* graph, uint32_t id);
+
+// Same as gridNeighbours, but for every graph mode and with the cost of each edge
+int idNeighbours(GRAPH* graph, uint32_t id, uint32_t neighbours[4], uint16_t costs[4]);
+
+// Finds the shortest path from start to end with A* (Manhattan distance heuristic)
+// stats can be NULL
+bool solveGraph(GRAPH* graph, PATH* path, SEARCH_STATS* stats);
+
+// Same as solveGraph between any two open cells
+// In GRAPH_CORRIDOR mode both cells have to be nodes (junctions, turns or dead ends)
+bool solveBetween(GRAPH* graph, uint32_t startCell, uint32_t endCell, PATH* path, SEARCH_STATS* stats);
+
+// Answers many questions about one graph, returns how many had a path
+uint32_t solveQueries(GRAPH* graph, QUERY* queries, uint32_t count);
+
+bool solveNodes(GRAPH* graph, NODE* start, NODE* end, PATH* path, SEARCH_STATS* stats);
+
+bool solveGrid(GRAPH* graph, uint32_t startCell, uint32_t endCell, PATH* path, SEARCH_STATS* stats);
+
+// A* on a GRAPH_CSR graph between two node ids
+bool solveCSR(GRAPH* graph, uint32_t startId, uint32_t endId, PATH* path, SEARCH_STATS* stats);
+
+// Manhattan distance between two cells
+uint32_t cellDistance(uint32_t a, uint32_t b, int width);
+
+// Frees the cells of a path
+void freePath(PATH* toFree);
+
+// Colors every pixel on the path (only for 24 and 32 bit bitmaps)
+bool drawPath(BMP* toDraw, PATH* path, uint32_t color);
 
+// Bitset with one bit per cell, set for every pixel drawPath would color (for streamCopyBMP)
+// Free it with free
+uint64_t* pathMask(PATH* path, int width, int height);
 
-#endif
\ No newline at end of file
+#endif
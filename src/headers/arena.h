@@ -0,0 +1,74 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+    Bump allocator for everything that lives as long as one solve
+    (maze bitset, graph, open set, search arrays, path, colorData).
+
+    Memory comes from a chain of big blocks that are kept after a reset,
+    so once a batch has seen its largest maze every later maze is served
+    from the same blocks and nothing goes back to malloc.
+    Allocations are never freed one at a time, only all at once with
+    arenaReset or everything after a mark with arenaRelease.
+*/
+
+// Every allocation is aligned to this
+#define arenaAlign 16
+
+// Header of every block, the memory itself follows it (at arenaHeaderSize)
+typedef struct ARENA_BLOCK_STRUCT {
+    struct ARENA_BLOCK_STRUCT* next;
+    size_t size;
+    size_t used;
+} ARENA_BLOCK;
+
+#define arenaHeaderSize ((sizeof(ARENA_BLOCK) + arenaAlign - 1) & ~(size_t)(arenaAlign - 1))
+
+typedef struct ARENA_STRUCT {
+    ARENA_BLOCK* first;
+
+    // Block allocations come out of, blocks after it are empty
+    ARENA_BLOCK* current;
+
+    // Size of the first block, later blocks double
+    size_t blockSize;
+
+    // Total bytes in all blocks
+    size_t reserved;
+} ARENA;
+
+// Position in an arena to go back to with arenaRelease
+typedef struct ARENA_MARK_STRUCT {
+    ARENA_BLOCK* block;
+    size_t used;
+} ARENA_MARK;
+
+// Creates an arena, the first block is allocated on first use
+ARENA* newArena(size_t blockSize);
+
+// Frees an ARENA struct and all of its blocks
+void freeArena(ARENA** toFree);
+
+// Returns size bytes from the arena (NULL if a new block could not be allocated)
+void* arenaAlloc(ARENA* arena, size_t size);
+
+// Forgets every allocation but keeps the blocks, O(1)
+void arenaReset(ARENA* arena);
+
+// Current position, and going back to it (both do nothing for a NULL arena)
+ARENA_MARK arenaMark(ARENA* arena);
+void arenaRelease(ARENA* arena, ARENA_MARK mark);
+
+/*
+    Helpers for code that takes an optional arena:
+    with a NULL arena they are plain malloc / calloc / free,
+    otherwise the memory comes from the arena and freeIn does nothing.
+*/
+void* allocIn(ARENA* arena, size_t size);
+void* callocIn(ARENA* arena, size_t count, size_t size);
+void freeIn(ARENA* arena, void* toFree);
+
+#endif
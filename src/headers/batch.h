@@ -0,0 +1,167 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include "algos.h"
+#include "arena.h"
+#include "landmarks.h"
+#include "costmap.h"
+#include "solvecache.h"
+
+// Longest maze path accepted in a batch list
+#define longestPath 4096
+
+typedef enum SEARCH_MODE_ENUM {
+    // Plain A* from start to end (solveGraph)
+    SEARCH_ASTAR,
+
+    // Bidirectional A*, both sides on the calling thread or one thread each
+    SEARCH_BIDIR,
+    SEARCH_BIDIR_THREADED,
+
+    // Jump point search (GRAPH_GRID only)
+    SEARCH_JPS,
+
+    // Hierarchical A* over clusters of clusterSize pixels (solveHPA)
+    SEARCH_HPA
+} SEARCH_MODE;
+
+typedef struct SOLVE_OPTIONS_STRUCT {
+    GRAPH_MODE mode;
+    SEARCH_MODE search;
+
+    // Number of times the search is run, searchMs is the average
+    int repeat;
+
+    // Write the output through mapWriteBMP instead of writeBMP
+    bool mapWrite;
+
+    // Read the maze and write the output through a BMP_STREAM, so no more
+    // than a window of rows is ever held as pixels (mapWrite is ignored)
+    bool stream;
+
+    // Load the graph from "<name>.graph" if it is up to date, and build and save it there if not
+    bool graphCache;
+
+    // Number of ALT landmarks for A* (0 = Manhattan distance only)
+    // Tables are loaded from "<name>.alt" if they match, and built and saved there if not
+    uint32_t landmarks;
+
+    // Cluster size for SEARCH_HPA
+    uint32_t clusterSize;
+
+    // Threads used to build the graph and clusters of one maze
+    int buildThreads;
+
+    // Cost of every pixel shade for weighted mazes (NULL = black and white walls, see costmap.h)
+    // Not used by runReplan, and SEARCH_JPS and SEARCH_HPA turn weighted mazes down
+    COST_TABLE* costTable;
+
+    // Paths solved earlier in this process, shared by every batch thread (NULL = off, see solvecache.h)
+    // A hit skips building and searching, streams always miss since their pixels are never all mapped
+    SOLVE_CACHE* solveCache;
+
+    // Print the stage times and counters once everything is solved (see reportStats),
+    // as JSON to statsJSON instead if it is not NULL
+    bool stats;
+    char* statsJSON;
+} SOLVE_OPTIONS;
+
+typedef struct SOLVE_RESULT_STRUCT {
+    bool loaded;
+    bool solved;
+    bool written;
+
+    uint32_t openCells;
+    uint32_t graphNodes;
+    size_t mazeBytes;
+
+    uint32_t pathCost;
+
+    // Graph came from the graph cache file instead of being built
+    bool cacheLoaded;
+
+    // Path came from the solve cache, so there was no graph or search at all
+    bool solveCached;
+
+    // Landmark tables, and whether they came from the .alt file
+    size_t landmarkBytes;
+    bool landmarksLoaded;
+    double landmarkMs;
+
+    // Abstract graph for SEARCH_HPA
+    uint32_t hpaNodes;
+    size_t hpaBytes;
+    double hpaMs;
+
+    uint64_t expanded;
+    uint64_t forwardExpanded;
+    uint64_t backwardExpanded;
+
+    // Bytes held by the arena after the solve
+    size_t arenaBytes;
+
+    // Wall clock time of every stage
+    double loadMs;
+    double buildMs;
+    double searchMs;
+    double writeMs;
+} SOLVE_RESULT;
+
+// Loads the landmark tables saved next to a maze, or builds and saves them
+// Returns NULL if they could not be built, loaded is set if they came from the file
+LANDMARKS* landmarksFor(GRAPH* graph, char* inName, uint32_t count, bool* loaded);
+
+// Runs the search picked in the options
+bool solveWith(GRAPH* graph, SEARCH_MODE search, PATH* path, SEARCH_STATS* stats);
+
+// Loads a maze, builds its graph, solves it and writes the path overlay to outName
+// Everything but the file mapping comes from arena, which is reset first (NULL = malloc)
+bool solveMazeFile(char* inName, char* outName, SOLVE_OPTIONS* options, SOLVE_RESULT* result, ARENA* arena);
+
+/*
+    Solves every maze in names on a pool of numThreads worker threads.
+    Every maze gets its own output file (see batchOutputName),
+    and every thread reuses one arena for all of its mazes,
+    and a throughput summary is printed once all of them are done.
+    A maze listed more than once is only solved once, and one whose output file
+    is already taken by a different maze is not solved and counts as failed.
+    Returns false if any maze could not be solved.
+*/
+bool runBatch(char** names, int count, SOLVE_OPTIONS* options, int numThreads, char* outDir);
+
+// Loads a maze and answers count random start / end questions on the one graph
+// (random open cells, or random nodes in GRAPH_CORRIDOR mode), then prints the query rate
+// With landmarks in the options the same questions are asked again with ALT to show the speedup,
+// with SEARCH_HPA they are asked again on the cluster abstraction to compare time and path length
+bool runQueries(char* inName, SOLVE_OPTIONS* options, uint32_t count, uint32_t seed);
+
+// Loads a maze and compares count A* searches from one random endpoint to count others against
+// a single distance sweep, then builds the count x count matrix between them on numThreads threads
+// and saves it to matrixName if it is not NULL (see saveDistanceMatrix)
+bool runDistances(char* inName, SOLVE_OPTIONS* options, uint32_t count, int numThreads, uint32_t seed, char* matrixName);
+
+// Solves a maze with LPA*, then changes its walls to the ones in editedName and repairs the path
+// Prints both against solving the edited maze from scratch, and writes the new path over the edited maze to outName
+bool runReplan(char* inName, char* editedName, SOLVE_OPTIONS* options, char* outName);
+
+// Prints the stage times of count results and the counters in solverStats (stats.h),
+// or writes them as JSON to jsonName if it is not NULL
+// The counters are only there when built with make INSTRUMENT=1
+bool reportStats(SOLVE_RESULT* results, int count, int repeat, char* jsonName);
+
+// Output file for a maze: "<name>_solved.bmp" next to the input, or in outDir if it is not NULL
+bool batchOutputName(char* inName, char* outDir, char* outName, size_t size);
+
+// Reads one path per line (blank lines and lines starting with # are skipped)
+char** readPathList(FILE* fp, int* count);
+
+// Frees a list from readPathList
+void freePathList(char*** toFree, int count);
+
+// Monotonic wall clock in milliseconds
+double nowMs();
+
+#endif
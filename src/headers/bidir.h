@@ -0,0 +1,26 @@
+#ifndef BIDIR_H
+#define BIDIR_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "algos.h"
+
+/*
+    Bidirectional A*, one search from start towards end and one from end towards start.
+    Each side keeps its own cost and from arrays (indexed by node id, or by cell in GRAPH_GRID mode)
+    and its own open set, so the NODE search fields are not touched.
+
+    Whenever a side reaches a node the other side has already reached, the
+    combined cost is a candidate for the best path (mu). The two sides use
+    potentials that add up to a constant, so the smallest keys of both open sets
+    together give a lower bound on every path not found yet, and the search
+    stops as soon as that bound reaches mu.
+
+    With threaded set the backward side runs on its own thread. The sides only
+    share the cost arrays (read with atomics) and mu (updated under a mutex).
+*/
+
+// Finds the shortest path from start to end, stats can be NULL
+bool solveBidirectional(GRAPH* graph, PATH* path, SEARCH_STATS* stats, bool threaded);
+
+#endif
@@ -4,6 +4,7 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <stdbool.h>
+#include "arena.h"
 
 #define longestFileName 100
 #define bmpSignature 0x4d42
@@ -103,6 +104,11 @@ typedef struct BMPDATA {
 
     PIXEL* colorData;
 
+    // Rows of the bitmap inside the mapped file (bottom row first)
+    // rowSize includes the padding at the end of every row
+    const uint8_t* rows;
+    int rowSize;
+
 } BMP_DATA;
 
 typedef struct BMPFILE {
@@ -111,13 +117,20 @@ typedef struct BMPFILE {
     BMP_DIB dib;
     BMP_DATA data;
 
+    // The whole file, mapped read only
+    const uint8_t* mapping;
+    size_t mappingSize;
+
+    // Where readData gets colorData from (NULL = malloc), set it before calling readData
+    ARENA* arena;
+
 } BMP;
 
 // Displays error message for a function
 void errMsg(char func[],char err[]);
 
 // Frees a BMP struct and all subelements
-void freeBMP();
+void freeBMP(BMP** toFree);
 
 // Creates a BMP struct
 BMP* newBMP();
@@ -125,35 +138,69 @@ BMP* newBMP();
 // Reads in a BMP file and returns a BMP struct as a pointer
 BMP* readBMP(char* fileName);
 
+// Maps a BMP file and checks its headers without decoding any pixels
+// colorData stays NULL until readData is called, rows point into the file
+BMP* mapBMP(char* fileName);
+
 // Verifies and reads the file header
-bool readHeader(BMP* toReturn, FILE* fp);
+bool readHeader(BMP* toReturn, const uint8_t* file, size_t fileSize);
 
 // Reads the DIB Header
-bool readDIB(BMP* toReturn, FILE* fp);
+bool readDIB(BMP* toReturn, const uint8_t* file, size_t fileSize);
+
+// Finds the pixel rows inside the file
+bool readRows(BMP* toReturn, const uint8_t* file, size_t fileSize);
+
+// Decodes the mapped rows into colorData
+bool readData(BMP* toReturn);
+
+bool readColorTable(BMP* toReturn, const uint8_t* file, size_t fileSize);
 
-// Reads the bitmap color data
-bool readData(BMP* toReturn, FILE* fp);
+// Hash of the mapped pixel rows readData decodes, with the size and color table (0 if nothing is mapped)
+uint64_t bmpPayloadHash(BMP* toHash);
 
-bool readDataBits(BMP* toReturn, FILE* fp);
+// Start of row y in the mapped file
+const uint8_t* bmpRow(BMP* toRead, int y);
 
-bool readDataBytes(BMP* toReturn, FILE* fp);
+// Decodes row y into one value per pixel, from colorData if it has been decoded or else from the file
+bool decodeRow(BMP* toRead, int y, uint32_t* values);
 
-bool readColorTable(BMP* toReturn, FILE* fp);
+// Value of the pixel at (x, y), from colorData if it has been decoded or else from the file
+uint32_t bmpPixel(BMP* toRead, int x, int y);
 
 // Checks if a string ends with a substring
 bool endsWith(char* toCheck, char* ending);
 
-// Writes BMP to file
+// Writes BMP to file, whole rows at a time through one buffer
 bool writeBMP(BMP* toWrite, char* fileName);
 
-// Writes BMP image data
-bool writeData(BMP* toWrite, FILE* fp, uint32_t* fileSize);
+// Writes BMP to file by sizing it with ftruncate and encoding straight into a shared mapping
+bool mapWriteBMP(BMP* toWrite, char* fileName);
+
+// Bytes in one row of the file, padding included
+uint32_t bmpRowSize(BMP* toWrite);
+
+// Where the pixel data starts in the file (headers plus color table)
+uint32_t bmpDataOffset(BMP* toWrite);
+
+// Encodes the file header, DIB header and color table (bmpDataOffset bytes)
+void writeHeaders(BMP* toWrite, uint8_t* dst, uint32_t fileSize);
+
+// Writes BMP image data, rowsPerFlush rows at a time through buffer
+bool writeData(BMP* toWrite, FILE* fp, uint8_t* buffer, uint32_t rowsPerFlush);
+
+// Encodes row y of colorData into dst (bmpRowSize bytes)
+void writeRow(BMP* toWrite, int y, uint8_t* dst);
+
+// Encodes one row of values (one per pixel, like decodeRow gives) into dst (bmpRowSize bytes)
+void encodeRow(BMP* toWrite, const uint32_t* values, uint8_t* dst);
 
-bool writeDataBits(BMP* toWrite, FILE* fp, uint32_t* fileSize);
+// Row encoders, values holds one uint32_t per pixel with stride bytes from one to the next
+void writeDataBits(BMP* toWrite, const uint8_t* values, size_t stride, uint8_t* dst);
 
-bool writeDataBytes(BMP* toWrite, FILE* fp, uint32_t* fileSize);
+void writeDataBytes(BMP* toWrite, const uint8_t* values, size_t stride, uint8_t* dst);
 
-bool writeColorTable(BMP* toWrite, FILE* fp, uint32_t* fileSize);
+void writeColorTable(BMP* toWrite, uint8_t* dst);
 
 int power(int base, int exp);
 
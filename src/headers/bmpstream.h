@@ -0,0 +1,83 @@
+#ifndef BMPSTREAM_H
+#define BMPSTREAM_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "bmp.h"
+#include "rowdecode.h"
+
+/*
+    Streaming BMP reader.
+
+    mapBMP maps the whole file and readData decodes all of it into colorData
+    (8 bytes per pixel). A stream instead reads the file front to back a
+    window of rows at a time with fread, and decodes one row at a time, so
+    it holds a few MB no matter how big the image is. Rows come out bottom
+    up, the order they are stored in the file (and in colorData).
+
+    Rows can be pulled one at a time with nextStreamRow, or pushed to a
+    callback in fixed size tiles with streamTiles.
+*/
+
+// Raw rows read from the file in one go
+#define streamWindowBytes (1 << 20)
+
+typedef struct BMP_STREAM_STRUCT {
+    // Headers and color table (data.rows and colorData stay NULL)
+    BMP* bmp;
+
+    FILE* fp;
+    ROW_DECODER decoder;
+
+    // Raw rows from windowFirst to windowFirst + windowCount
+    uint8_t* window;
+    int windowRows;
+    int windowFirst;
+    int windowCount;
+
+    // Next row nextStreamRow hands out
+    int nextRow;
+
+    // Decoded values of the last row handed out
+    uint32_t* values;
+} BMP_STREAM;
+
+typedef struct BMP_TILE_STRUCT {
+    // Pixel rectangle the tile covers (y = 0 is the bottom row)
+    int x;
+    int y;
+    int width;
+    int height;
+
+    // Value of pixel (x + i, y + j) is values[i + (stride * j)]
+    const uint32_t* values;
+    int stride;
+} BMP_TILE;
+
+// Called for every tile, returning false stops the stream
+typedef bool (*TILE_CALLBACK)(BMP_TILE* tile, void* context);
+
+// Opens a bitmap and reads its headers, windowRows raw rows are read at a time (0 = about streamWindowBytes)
+BMP_STREAM* openBMPStream(char* fileName, int windowRows);
+
+// Closes the file and frees a BMP_STREAM struct and all subelements
+void closeBMPStream(BMP_STREAM** toFree);
+
+// Decodes the next row into one value per pixel (the same values decodeRow gives)
+// Returns NULL once every row has been read, y is set to the row index
+const uint32_t* nextStreamRow(BMP_STREAM* stream, int* y);
+
+// Reads the whole image in tiles of tileWidth by tileHeight pixels (smaller along the right and top edges)
+// Tiles come a band of tileHeight rows at a time, left to right, and only one band is held at once
+bool streamTiles(char* fileName, int tileWidth, int tileHeight, TILE_CALLBACK callback, void* context);
+
+// Bytes held by the stream
+size_t streamBytes(BMP_STREAM* stream);
+
+// Copies a bitmap row by row, recoloring every pixel that is set in marked (one bit per cell, may be NULL)
+// Only 24 and 32 bit bitmaps are recolored, like drawPath
+bool streamCopyBMP(char* inName, char* outName, const uint64_t* marked, uint32_t color);
+
+#endif
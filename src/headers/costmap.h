@@ -0,0 +1,72 @@
+#ifndef COSTMAP_H
+#define COSTMAP_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "bmp.h"
+
+/*
+    Weighted mazes, where the shade of a pixel is what it costs to cross it.
+
+    Every pixel has a level for how dark it is: 765 minus the sum of its red,
+    green and blue channels, so white is 0 and black is 765. A COST_TABLE
+    gives the cost of every level, from 1 to 255, or 0 for a wall. That is
+    also how the threshold works, every level from it up is a wall.
+    Indexed bitmaps use the level of their color table entries, or with
+    byIndex look the index itself up in the table (for maps where the
+    palette is a list of terrain types instead of shades).
+
+    Rows are turned into costs by row kernels, the same way rowdecode.h turns
+    them into values: a loop with no branches in it, and an AVX2 version that
+    does 8 pixels at a time with a gather from the table and a movemask for
+    the wall bits, picked at runtime.
+
+    Stepping between two cells costs the larger of their two costs (see
+    mazeStepCost), so every edge costs the same both ways and never less
+    than the one step of Manhattan distance it covers.
+*/
+
+// Number of levels, 0 (white) to 765 (black)
+#define costLevels 766
+
+typedef struct COST_TABLE_STRUCT {
+    // Cost of every level (0 = wall), only the first 256 are used with byIndex
+    uint8_t cost[costLevels];
+
+    // Indexed bitmaps look their index up instead of the level of its color
+    bool byIndex;
+} COST_TABLE;
+
+// The table widened for one bitmap, every entry is read as a whole uint32_t by the gather
+typedef struct COST_LOOKUP_STRUCT {
+    bool indexed;
+
+    // Indexed bitmaps only use the first 256 entries, one per index
+    uint32_t cost[costLevels];
+} COST_LOOKUP;
+
+// Turns one row of decoded values (see rowdecode.h) into one cost per pixel, and clears the bit
+// of every pixel that is not a wall in walls (a row of the MAZE bitset, which has to start all set)
+typedef void (*ROW_COSTER)(const uint32_t* values, uint8_t* costs, uint64_t* walls, int width, const uint32_t* lookup);
+
+// Fills a table with costs that rise in a straight line from 1 for white to maxCost just
+// below threshold, and walls from threshold on
+// threshold is on the 0 - 255 scale of one channel (256 = no walls), maxCost is 1 - 255
+void costRamp(COST_TABLE* table, int threshold, int maxCost);
+
+// Fills in the lookup for a bitmap, going through its color table if it has one
+void costLookupFromBMP(BMP* toCheck, COST_TABLE* table, COST_LOOKUP* lookup);
+
+// Best kernel for indexed or 16/24/32 bit values on this CPU
+ROW_COSTER rowCoster(bool indexed);
+
+// Plain loop kernel, used as the fallback and as a reference
+ROW_COSTER scalarRowCoster(bool indexed);
+
+// Level of a pixel value (0x(AA)RRGGBB)
+static inline uint32_t colorLevel(uint32_t color)
+{
+    return 765 - (((color >> 16) & 0xFF) + ((color >> 8) & 0xFF) + (color & 0xFF));
+}
+
+#endif
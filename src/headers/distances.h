@@ -0,0 +1,104 @@
+#ifndef DISTANCES_H
+#define DISTANCES_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "algos.h"
+#include "pqueue.h"
+
+/*
+    Distances from one cell to many, and between many cells at once.
+
+    A* answers one start / end pair per search, so asking for the distance to
+    hundreds of goals means hundreds of searches that mostly expand the same
+    nodes again. A sweep is one Dijkstra search from the source instead, which
+    stops as soon as every goal has been taken off the open set.
+    distanceMatrix runs one sweep per source on a pool of threads. Every
+    thread has a DISTANCE_SWEEP of its own and the graph is only ever read,
+    so nothing is locked but the next source to hand out.
+
+    Cells are the same ones solveBetween accepts: any open cell in GRAPH_FULL
+    and GRAPH_GRID, only node cells (junctions, turns and dead ends) in
+    GRAPH_CORRIDOR and GRAPH_CSR. Any other cell, and any cell that cannot be
+    reached, gets noDistance.
+*/
+
+#define noDistance UINT32_MAX
+
+// "DMAT" read as a little endian uint32_t
+#define distanceMatrixSignature 0x54414d44
+
+// Search state of one sweep, one per thread
+typedef struct DISTANCE_SWEEP_STRUCT {
+    uint32_t numIds;
+    PQUEUE* open;
+
+    // cost is only valid if stamp is the current generation
+    uint32_t* cost;
+    uint32_t* stamp;
+    uint32_t generation;
+} DISTANCE_SWEEP;
+
+// Goals of a sweep, made once and shared by every thread
+typedef struct DISTANCE_TARGETS_STRUCT {
+    uint32_t count;
+
+    // Graph id of every goal (noCell if the cell is not one)
+    uint32_t* ids;
+
+    // Bitset over the graph ids, and the number of distinct ids in it
+    uint64_t* isGoal;
+    uint32_t distinct;
+} DISTANCE_TARGETS;
+
+typedef struct DISTANCE_MATRIX_STRUCT {
+    uint32_t numSources;
+    uint32_t numTargets;
+    uint32_t* sourceCells;
+    uint32_t* targetCells;
+
+    // distances[(source * numTargets) + target]
+    uint32_t* distances;
+
+    // Nodes taken off the open set by all of the sweeps
+    uint64_t expanded;
+} DISTANCE_MATRIX;
+
+DISTANCE_SWEEP* newDistanceSweep(GRAPH* graph);
+
+// Frees a DISTANCE_SWEEP struct and all subelements
+void freeDistanceSweep(DISTANCE_SWEEP** toFree);
+
+DISTANCE_TARGETS* newDistanceTargets(GRAPH* graph, uint32_t* cells, uint32_t count);
+
+// Frees a DISTANCE_TARGETS struct and all subelements
+void freeDistanceTargets(DISTANCE_TARGETS** toFree);
+
+// One sweep from sourceCell, fills distances[i] with the distance to target i
+bool sweepDistances(GRAPH* graph, DISTANCE_SWEEP* sweep, uint32_t sourceCell, DISTANCE_TARGETS* targets,
+    uint32_t* distances, SEARCH_STATS* stats);
+
+// Same as sweepDistances with a sweep and targets made for the one call
+bool distancesFrom(GRAPH* graph, uint32_t sourceCell, uint32_t* goalCells, uint32_t count, uint32_t* distances);
+
+// Distance from every source to every target, one sweep per source on up to numThreads threads
+DISTANCE_MATRIX* distanceMatrix(GRAPH* graph, uint32_t* sources, uint32_t numSources,
+    uint32_t* targets, uint32_t numTargets, int numThreads);
+
+// Frees a DISTANCE_MATRIX struct and all subelements
+void freeDistanceMatrix(DISTANCE_MATRIX** toFree);
+
+/*
+    Saves a matrix as:
+        uint32_t signature, numSources, numTargets, entry size (2 or 4)
+        uint32_t sourceCells[numSources]
+        uint32_t targetCells[numTargets]
+        distances, row by row
+    Entries are uint16_t (UINT16_MAX = no path) unless a distance does not fit.
+*/
+bool saveDistanceMatrix(DISTANCE_MATRIX* matrix, char* fileName);
+
+// Loads a file written by saveDistanceMatrix (NULL if it is missing or broken)
+DISTANCE_MATRIX* loadDistanceMatrix(char* fileName);
+
+#endif
@@ -0,0 +1,86 @@
+#ifndef GRAPHCACHE_H
+#define GRAPHCACHE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "algos.h"
+#include "maze.h"
+
+/*
+    Binary graph cache.
+
+    A built graph is saved as "<maze>.graph" next to the .bmp, so the next
+    run on the same maze can map it instead of decoding the bitmap and
+    building the graph again. Everything in the file is laid out the way it
+    is used, so GRAPH_GRID and GRAPH_CSR graphs run straight off the mapped
+    file and a NODE graph only has to turn the edge lists into pointers.
+
+    The cache is used when the maze file has the same size and modification
+    time it had when the cache was written, which only costs a stat. If
+    those differ (the file was copied or touched) the maze is decoded and the
+    cache is still used as long as the hash of its walls matches.
+    Cell costs of weighted mazes are only part of the hash, so a graph built
+    from one is only ever loaded with the decoded maze.
+
+    File layout, all little endian, every section starts on 8 bytes:
+        GRAPH_CACHE_HEADER
+        uint64_t walls[rowWords * height]
+        uint32_t nodeCell[numNodes]        cell of each node
+        uint32_t cellOrder[numNodes]       node ids sorted by cell (GRAPH_CSR only)
+        uint32_t edgeStart[numNodes + 1]   edges of node n are [edgeStart[n], edgeStart[n + 1])
+        uint32_t edgeTarget[numEdges]      node at the other end
+        uint16_t edgeCost[numEdges]
+    GRAPH_GRID graphs have no nodes or edges, only the walls.
+*/
+
+// "GRPH" read as a little endian uint32_t
+#define graphCacheSignature 0x48505247
+
+// Bumped whenever the layout changes, older files are then rebuilt
+#define graphCacheVersion 2
+
+typedef struct GRAPH_CACHE_HEADER_STRUCT {
+    uint32_t signature;
+    uint32_t version;
+    uint32_t mode;
+    uint32_t width;
+    uint32_t height;
+    uint32_t rowWords;
+    uint32_t openCells;
+    uint32_t startCell;
+    uint32_t endCell;
+    uint32_t numNodes;
+    uint32_t numEdges;
+
+    // Ids of the start and end nodes (the cells in GRAPH_GRID mode)
+    uint32_t startNode;
+    uint32_t endNode;
+
+    // 1 if the maze had cell costs, which are not in the file (see loadGraphCache)
+    uint32_t weighted;
+
+    // Hash of the walls and costs (mazeHash), only checked for weighted mazes since the walls are in the file
+    uint64_t mazeHash;
+
+    // Size and modification time of the maze file when the cache was written
+    uint64_t sourceSize;
+    int64_t sourceSeconds;
+    int64_t sourceNanos;
+} GRAPH_CACHE_HEADER;
+
+// Saves a graph to the cache file of the maze file it was built from
+bool saveGraphCache(GRAPH* graph, char* bmpName);
+
+// Maps the cache file of a maze file and builds a graph on it, NULL if there is no cache for mode or it is stale
+// With maze NULL the maze file has to be unchanged since the cache was written, and the maze unweighted
+// Otherwise maze (decoded from the file) has to match the cached walls, and is owned by the graph if one is returned
+GRAPH* loadGraphCache(char* bmpName, GRAPH_MODE mode, MAZE* maze, ARENA* arena);
+
+// Unmaps the cache file a graph was loaded from (called by freeGraph)
+void closeGraphCache(GRAPH* graph);
+
+// Names the cache file for a maze file ("maze.bmp" -> "maze.graph")
+bool graphCacheFileName(char* bmpName, char* cacheName, size_t size);
+
+#endif
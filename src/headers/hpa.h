@@ -0,0 +1,98 @@
+#ifndef HPA_H
+#define HPA_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "algos.h"
+
+/*
+    Hierarchical pathfinding (HPA*) for the pixel grid.
+
+    The maze is cut into square clusters. Wherever two neighbouring clusters
+    share a run of open cells along their border there is an entrance, with a
+    transition (one cell on each side) in the middle of a narrow entrance or
+    one at each end of a wide one. Transition cells are the nodes of a much
+    smaller abstract graph:
+        across a border - the two cells of a transition, cost 1
+        inside a cluster - every pair of nodes in the cluster, the cost is the
+                           shortest path that stays inside the cluster
+    Clusters do not depend on each other, so the distances inside them are
+    worked out on several threads.
+
+    A query links start and end to the nodes of their own clusters, runs A*
+    on the abstract graph and then fills in every step inside a cluster with
+    the cells it stands for. Paths can only cross borders at transitions, so
+    with wide entrances they can come out a little longer than the shortest path.
+
+    Only the wall bitset is used, so on a GRAPH_GRID graph the grid search
+    arrays are never allocated and much larger mazes fit in memory.
+    That also means every step costs 1, so weighted mazes are turned down.
+*/
+
+#define hpaDefaultCluster 32
+
+// Distances inside a cluster are stored as uint16_t
+#define hpaMaxCluster 255
+#define hpaNoDistance UINT16_MAX
+
+// Entrances at least this wide get a transition at each end instead of one in the middle
+#define hpaWideEntrance 6
+
+typedef struct HPA_STRUCT {
+    int width;
+    int height;
+
+    // Clusters are clusterSize square (smaller along the right and top edges)
+    uint32_t clusterSize;
+    uint32_t clustersX;
+    uint32_t clustersY;
+
+    // Transition cells, grouped by cluster and sorted by cell inside each one
+    // The nodes of cluster c are [clusterFirst[c], clusterFirst[c + 1])
+    uint32_t numNodes;
+    uint32_t* nodeCell;
+    uint32_t* clusterFirst;
+
+    // Node across the border above, below, left and right of each node (noItem if none)
+    uint32_t* across;
+
+    // Distance between every pair of nodes in a cluster, an n * n table starting at tableStart[c]
+    size_t* tableStart;
+    uint16_t* distances;
+
+    // Abstract search state, ids are the nodes and then one each for start and end
+    PQUEUE* open;
+    uint32_t* cost;
+    uint32_t* from;
+    uint32_t* stamp;
+    uint32_t generation;
+
+    // Distances from start and end to the nodes of their clusters (largest cluster sized)
+    uint32_t* startLinks;
+    uint32_t* endLinks;
+
+    // Cluster sized scratch for linking start and end and for filling in paths
+    uint16_t* scratchCost;
+    uint16_t* scratchFrom;
+    uint16_t* scratchQueue;
+
+    // Where the tables came from (NULL = malloc)
+    ARENA* arena;
+} HPA;
+
+// Finds the transitions and the distances between them, numThreads threads share the clusters
+// clusterSize is clamped to [2, hpaMaxCluster]
+HPA* buildHPA(GRAPH* graph, uint32_t clusterSize, int numThreads);
+
+// Frees an HPA struct and all subelements
+void freeHPA(HPA** toFree);
+
+// Bytes held by the abstract graph and its search state
+size_t hpaBytes(HPA* hpa);
+
+// Finds a path between two open cells with the abstract graph in graph->hpa, stats can be NULL
+// expanded counts abstract nodes, the sweeps that link and fill in paths are not counted
+bool solveHPA(GRAPH* graph, uint32_t startCell, uint32_t endCell, PATH* path, SEARCH_STATS* stats);
+
+#endif
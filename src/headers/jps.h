@@ -0,0 +1,28 @@
+#ifndef JPS_H
+#define JPS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "algos.h"
+
+/*
+    Jump Point Search for the 4-connected pixel grid (GRAPH_GRID only, unweighted mazes only).
+
+    Every step costs the same, so most shortest paths come in many symmetric
+    versions that only differ in where they turn. Instead of pushing every
+    cell, the search runs straight along a row or column until it hits a
+    cell where something new can happen (a jump point):
+        moving along a row    - a cell above or below opens up that was a wall one step back
+        moving along a column - the same for left and right, or a jump along the row
+                                from this cell finds a jump point
+    Only jump points go on the open set, and the edge to one costs the
+    number of cells jumped over, so the path length is the same as plain A*.
+
+    Search state lives in the GRID arrays (stamped like solveGrid), only jump points get a from cell.
+*/
+
+// Finds the shortest path from start to end, stats can be NULL
+// The path only holds the jump points, which are always in a straight line from each other
+bool solveJPS(GRAPH* graph, PATH* path, SEARCH_STATS* stats);
+
+#endif
@@ -0,0 +1,97 @@
+#ifndef LANDMARKS_H
+#define LANDMARKS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "algos.h"
+
+/*
+    Landmark (ALT) heuristic tables.
+
+    A few landmarks are picked far apart from each other and a full Dijkstra
+    sweep from each gives its distance to every id. For any landmark L the
+    triangle inequality says dist(v, t) >= |dist(L, t) - dist(L, v)|, and the
+    largest of those bounds is a much better heuristic than Manhattan distance
+    once walls force long detours.
+
+    Tables are stored id major (all landmarks of one id next to each other),
+    as uint16_t unless a distance does not fit, and can be saved next to the
+    .bmp so the sweeps only run once per maze.
+*/
+
+// Distance for ids a landmark cannot reach
+#define noDistance16 UINT16_MAX
+#define noDistance32 UINT32_MAX
+
+typedef struct LANDMARKS_STRUCT {
+    // Number of landmarks and their ids
+    uint32_t count;
+    uint32_t* ids;
+
+    // Number of ids in the graph the tables were built for
+    uint32_t numIds;
+
+    // Distances, table[(id * count) + k], only one of the two is used
+    uint16_t* narrow;
+    uint32_t* wide;
+
+    // Where the tables came from (NULL = malloc)
+    ARENA* arena;
+} LANDMARKS;
+
+// Picks count landmarks by farthest point sampling and sweeps from each one
+LANDMARKS* buildLandmarks(GRAPH* graph, uint32_t count);
+
+// Frees a LANDMARKS struct and all subelements
+void freeLandmarks(LANDMARKS** toFree);
+
+// Size of the distance tables in bytes
+size_t landmarkBytes(LANDMARKS* landmarks);
+
+// Saves the tables for a graph, with the maze hash so a changed maze is noticed on load
+bool saveLandmarks(GRAPH* graph, LANDMARKS* landmarks, char* fileName);
+
+// Loads tables saved for this graph (NULL if the file is missing or was saved for another maze or mode)
+LANDMARKS* loadLandmarks(GRAPH* graph, char* fileName);
+
+// File the tables of a maze are saved to: the .bmp name with ".alt" in place of ".bmp"
+bool landmarkFileName(char* bmpName, char* altName, size_t size);
+
+// Lower bound on the distance between two ids
+// Inline because A* calls it for every neighbour it pushes
+static inline uint32_t landmarkBound(const LANDMARKS* landmarks, uint32_t id, uint32_t target)
+{
+    uint32_t count = landmarks->count;
+    uint32_t best = 0;
+    if(landmarks->narrow != NULL)
+    {
+        const uint16_t* from = landmarks->narrow + ((size_t)id * count);
+        const uint16_t* to = landmarks->narrow + ((size_t)target * count);
+        for(uint32_t k = 0; k < count; k++)
+        {
+            if(from[k] == noDistance16 || to[k] == noDistance16)
+            {
+                continue;
+            }
+            uint32_t bound = (from[k] > to[k]) ? from[k] - to[k] : to[k] - from[k];
+            best = (bound > best) ? bound : best;
+        }
+        return best;
+    }
+
+    const uint32_t* from = landmarks->wide + ((size_t)id * count);
+    const uint32_t* to = landmarks->wide + ((size_t)target * count);
+    for(uint32_t k = 0; k < count; k++)
+    {
+        if(from[k] == noDistance32 || to[k] == noDistance32)
+        {
+            continue;
+        }
+        uint32_t bound = (from[k] > to[k]) ? from[k] - to[k] : to[k] - from[k];
+        best = (bound > best) ? bound : best;
+    }
+    return best;
+}
+
+#endif
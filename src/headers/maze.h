@@ -0,0 +1,107 @@
+#ifndef MAZE_H
+#define MAZE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "bmp.h"
+#include "bmpstream.h"
+#include "arena.h"
+#include "costmap.h"
+
+/*
+    Packed maze format, one bit per pixel.
+    Rows are padded to a whole number of uint64_t words (with at least
+    one spare bit) and the padding bits are set as walls, so x + 1 never
+    has to be checked against the width when looking at a neighbour.
+    Rows are bottom up like colorData, cells are x + (width * y).
+*/
+typedef struct MAZE_STRUCT {
+    int width;
+    int height;
+
+    // Number of uint64_t words in every row
+    uint32_t rowWords;
+
+    // 1 = wall, 0 = open
+    uint64_t* walls;
+
+    // Openings in the top and bottom rows, as cell indices
+    uint32_t startCell;
+    uint32_t endCell;
+
+    // Number of open pixels
+    uint32_t openCells;
+
+    // Cost of every cell, x + (width * y), 0 for walls (NULL = every open cell costs 1, see costmap.h)
+    uint8_t* costs;
+
+    // Where the bitset came from (NULL = malloc)
+    ARENA* arena;
+} MAZE;
+
+// Builds the wall bitset straight from the bitmap rows (white = open, black = wall)
+// With a cost table the walls and cell costs come from the table instead (NULL = unweighted)
+// table and arena can be NULL
+MAZE* mazeFromBMP(BMP* toConvert, COST_TABLE* table, ARENA* arena);
+
+// Same as mazeFromBMP, packing rows as they come off a freshly opened stream
+MAZE* mazeFromStream(BMP_STREAM* stream, COST_TABLE* table, ARENA* arena);
+
+// Finds the cells findMazeEndpoints would for the maze mazeFromBMP builds, from only the top and bottom rows
+bool bmpEndpoints(BMP* toCheck, COST_TABLE* table, uint32_t* startCell, uint32_t* endCell);
+
+// Frees a MAZE struct and all subelements
+void freeMaze(MAZE** toFree);
+
+// Decides which pixel values are open for the bitmap, indexed bitmaps go through the color table
+// Fills openIndex for bit depths up to 8 (256 entries)
+void openTableFromBMP(BMP* toCheck, uint8_t openIndex[256]);
+
+// Checks if a pixel value (not an index) is open
+bool colorIsOpen(uint32_t color);
+
+// Finds the openings in the top and bottom rows of the maze
+bool findMazeEndpoints(MAZE* maze);
+
+// Checks if an open cell is the middle of a straight corridor
+// (open on exactly two opposite sides, so it would never need a NODE)
+bool mazeIsCorridor(MAZE* maze, int x, int y);
+
+// Size of the wall bitset in bytes
+size_t mazeBytes(MAZE* maze);
+
+// Hash of the size, walls and cell costs, for telling if a file saved for a maze still matches it
+uint64_t mazeHash(MAZE* maze);
+
+// Opens or walls off one cell, keeping openCells up to date (its cost is left as it is)
+void setMazeCell(MAZE* maze, uint32_t cell, bool open);
+
+// Cells that are open in one maze and walls in the other (same size only), count is set to how many
+// Compares whole words, so unchanged rows cost one XOR per 64 pixels
+uint32_t* mazeChanges(MAZE* before, MAZE* after, uint32_t* count);
+
+// Inline so the graph builders and search can test cells without a call per pixel
+static inline bool mazeIsOpen(const MAZE* maze, int x, int y)
+{
+    uint64_t word = maze->walls[((size_t)maze->rowWords * y) + (x >> 6)];
+    return ((word >> (x & 63)) & 1) == 0;
+}
+
+static inline bool mazeCellIsOpen(const MAZE* maze, uint32_t cell)
+{
+    return mazeIsOpen(maze, cell % maze->width, cell / maze->width);
+}
+
+// Cost of a step between two neighbouring open cells, the larger of their two costs
+static inline uint32_t mazeStepCost(const MAZE* maze, uint32_t a, uint32_t b)
+{
+    if(maze->costs == NULL)
+    {
+        return 1;
+    }
+    uint32_t costA = maze->costs[a];
+    uint32_t costB = maze->costs[b];
+    return (costA > costB) ? costA : costB;
+}
+
+#endif
@@ -0,0 +1,115 @@
+#ifndef PQUEUE_H
+#define PQUEUE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "arena.h"
+
+/*
+    Indexed min priority queue used as the A* open set.
+    Items are ids in the range [0, capacity) with a uint32_t key,
+    so the queue can find any item again to lower its key.
+
+    The backend is picked at compile time:
+        default     - binary heap, decrease-key in O(log n)
+        PQ_PAIRING  - pairing heap, decrease-key in O(1) amortized
+        PQ_BUCKET   - bucket queue, push, pop and decrease-key in O(1) amortized
+
+    The bucket queue relies on the keys being small integers that mostly go up,
+    which is true for A* with integer edge costs and a consistent heuristic
+    (f never drops below the last key popped, and never jumps more than
+    twice the largest edge cost above it).
+*/
+
+#define noItem UINT32_MAX
+
+typedef struct PQUEUE_STRUCT {
+    // Ids must be smaller than capacity
+    uint32_t capacity;
+
+    // Number of ids currently in the queue
+    uint32_t size;
+
+    // Key of every id
+    uint32_t* keys;
+
+    // Where the arrays come from (NULL = malloc)
+    ARENA* arena;
+
+#ifdef INSTRUMENT
+    // Counted here and added to solverStats when the queue is cleared or freed
+    uint64_t pushes;
+    uint64_t decreases;
+    uint32_t peakSize;
+#endif
+
+#if defined(PQ_BUCKET)
+    // Ring of buckets (bucketCount is a power of 2)
+    // Every key in the queue is in [minKey, minKey + bucketCount), so each bucket holds one key
+    uint32_t* buckets;
+    uint32_t bucketCount;
+    uint32_t minKey;
+    uint32_t maxKey;
+
+    // Doubly linked list inside each bucket
+    uint32_t* next;
+    uint32_t* prev;
+#elif defined(PQ_PAIRING)
+    uint32_t root;
+
+    // Leftmost child and right sibling of every id
+    uint32_t* child;
+    uint32_t* sibling;
+
+    // Parent for a leftmost child, left sibling for everything else
+    uint32_t* prev;
+#else
+    // Heap ordered array of ids
+    uint32_t* heap;
+
+    // Where every id is in heap (noItem if it is not in the queue)
+    uint32_t* position;
+#endif
+
+} PQUEUE;
+
+// Name of the backend that was compiled in
+#if defined(PQ_BUCKET)
+#define queueBackend "bucket queue"
+#elif defined(PQ_PAIRING)
+#define queueBackend "pairing heap"
+#else
+#define queueBackend "binary heap"
+#endif
+
+// Creates an empty queue for ids in [0, capacity), arena can be NULL
+PQUEUE* newQueue(uint32_t capacity, ARENA* arena);
+
+// Frees a PQUEUE struct and all subelements
+void freeQueue(PQUEUE** toFree);
+
+bool queueEmpty(PQUEUE* queue);
+
+bool queueContains(PQUEUE* queue, uint32_t id);
+
+// Adds an id that is not in the queue yet
+// Returns false if the queue could not grow to fit the key
+bool queuePush(PQUEUE* queue, uint32_t id, uint32_t key);
+
+// Lowers the key of an id that is already in the queue
+bool queueDecrease(PQUEUE* queue, uint32_t id, uint32_t key);
+
+// Removes and returns the id with the smallest key
+uint32_t queuePop(PQUEUE* queue);
+
+// Takes an id that is in the queue out of it, wherever it is
+// (raising a key is a remove and a push)
+void queueRemove(PQUEUE* queue, uint32_t id);
+
+// Smallest key in the queue (UINT32_MAX if it is empty)
+uint32_t queueTopKey(PQUEUE* queue);
+
+// Removes everything from the queue
+void queueClear(PQUEUE* queue);
+
+#endif
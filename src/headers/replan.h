@@ -0,0 +1,61 @@
+#ifndef REPLAN_H
+#define REPLAN_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "algos.h"
+#include "maze.h"
+#include "pqueue.h"
+
+/*
+    Incremental replanning with Lifelong Planning A* (LPA*).
+
+    Every cell keeps g, its distance from the start as of the last time it
+    was expanded, and rhs, the best distance its neighbours offer right now.
+    A cell where the two differ is on the open set. When walls change only
+    the cells next to the change become inconsistent, and repairing the path
+    expands those and whatever their distances ripple out to, instead of
+    searching the whole maze again.
+
+    Runs on GRAPH_GRID graphs of unweighted mazes, where a wall change is one
+    bit in the maze and every edge costs 1. The NODE and CSR graphs would have to be rebuilt
+    around every change, since walls decide where their nodes are.
+    The start and end stay the cells the graph had when the REPLAN was made.
+
+    The open set is keyed on min(g, rhs) + h alone (the usual second key of
+    LPA* does not fit in the uint32_t keys), so the search keeps expanding
+    while the smallest key is equal to the end's instead of stopping there.
+*/
+
+typedef struct REPLAN_STRUCT {
+    // GRAPH_GRID graph whose walls are edited (not owned)
+    GRAPH* graph;
+    uint32_t startCell;
+    uint32_t endCell;
+
+    // Per cell distances, UINT32_MAX = no path
+    uint32_t* g;
+    uint32_t* rhs;
+
+    // Inconsistent cells (g != rhs)
+    PQUEUE* open;
+} REPLAN;
+
+// Sets up LPA* from the start to the end of a GRAPH_GRID graph, replanPath does the first search
+REPLAN* newReplan(GRAPH* graph);
+
+// Frees a REPLAN struct and all subelements (not the graph)
+void freeReplan(REPLAN** toFree);
+
+// Repairs the search after the changes so far and returns the shortest path
+// Returns false if there is no path
+bool replanPath(REPLAN* replan, PATH* path, SEARCH_STATS* stats);
+
+// Opens (open[i] = true) or walls off cells, and marks the cells around them for replanPath
+bool replanCells(REPLAN* replan, uint32_t* cells, bool* open, uint32_t count);
+
+// Makes the walls of the graph match edited (a maze of the same size) through replanCells
+// changed is set to the number of cells that differed
+bool replanMaze(REPLAN* replan, MAZE* edited, uint32_t* changed);
+
+#endif
@@ -0,0 +1,45 @@
+#ifndef ROWDECODE_H
+#define ROWDECODE_H
+
+#include <stdint.h>
+
+/*
+    Row kernels that turn one row of bitmap data into one uint32_t per pixel,
+    in the same format as PIXEL.value (index for 1/2/4/8 bpp, 0x(AA)RRGGBB for 16/24/32 bpp).
+    16 bpp pixels are 0RRRRRGGGGGBBBBB (readHeader turns BI_BITFIELDS down), and every
+    5 bit channel is widened to 8 bits so white is 0xFFFFFF like at every other depth.
+
+    There is a scalar version of every kernel, plus SSE2/SSSE3 and AVX2 versions
+    for the common depths. The fastest one the CPU supports is picked at runtime.
+*/
+
+typedef void (*ROW_DECODER)(const uint8_t* row, uint32_t* values, int width);
+
+// Best kernel for this bit depth on this CPU (NULL for unsupported depths)
+ROW_DECODER rowDecoder(int bitDepth);
+
+// Plain loop kernel for this bit depth, used as the fallback and as a reference
+ROW_DECODER scalarRowDecoder(int bitDepth);
+
+// Widens a 16 bpp 555 pixel to 0xRRGGBB, the top bits are repeated into the low ones so 31 becomes 255
+static inline uint32_t expand555(uint32_t pixel)
+{
+    uint32_t red = (pixel >> 10) & 0x1F;
+    uint32_t green = (pixel >> 5) & 0x1F;
+    uint32_t blue = pixel & 0x1F;
+    red = (red << 3) | (red >> 2);
+    green = (green << 3) | (green >> 2);
+    blue = (blue << 3) | (blue >> 2);
+    return (red << 16) | (green << 8) | blue;
+}
+
+// Narrows 0xRRGGBB back to a 16 bpp 555 pixel, the inverse of expand555
+static inline uint32_t pack555(uint32_t color)
+{
+    return (((color >> 19) & 0x1F) << 10) | (((color >> 11) & 0x1F) << 5) | ((color >> 3) & 0x1F);
+}
+
+// Instruction set the kernels from rowDecoder use ("avx2", "sse2" or "scalar")
+const char* rowDecoderLevel();
+
+#endif
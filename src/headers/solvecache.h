@@ -0,0 +1,87 @@
+#ifndef SOLVECACHE_H
+#define SOLVECACHE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "algos.h"
+#include "arena.h"
+
+/*
+    In process cache of solved paths, in front of graph building and search.
+
+    Entries are keyed by a hash of the pixels (bmpPayloadHash), a hash of
+    everything else that changes the answer (graph mode, search, cost
+    table) and the start and end cells, so a maze that comes up again is
+    answered without building a graph or searching at all.
+
+    Paths are stored compactly: the start cell, then one varint per straight
+    run, (run length << 2) | direction. Runs in the same direction are merged,
+    so a path costs a byte or two per turn instead of 4 bytes per cell, and
+    decodes to one cell per turn (see PATH).
+
+    Batch threads share one cache. Lookups only take the read lock, so they
+    run side by side, and recency is a use clock stamped on every hit
+    instead of a list that would need the write lock to reorder. Stores take
+    the write lock and evict the least recently used entries (a scan of the
+    table) until the new path fits in both the entry and byte budgets.
+*/
+
+// Byte budget the solver gives its cache
+#define solveCacheDefaultBytes ((size_t)64 << 20)
+
+// Path directions in the encoding, the same order as gridNeighbours
+#define pathUp 0
+#define pathDown 1
+#define pathLeft 2
+#define pathRight 3
+
+typedef struct SOLVE_KEY_STRUCT {
+    // Hash of the pixels and of the options that change the path
+    uint64_t payload;
+    uint64_t settings;
+
+    uint32_t startCell;
+    uint32_t endCell;
+} SOLVE_KEY;
+
+// Snapshot of the counters of a cache
+typedef struct SOLVE_CACHE_COUNTS_STRUCT {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t stores;
+    uint64_t evictions;
+
+    // Entries and encoded bytes held right now
+    uint32_t entries;
+    size_t bytes;
+} SOLVE_CACHE_COUNTS;
+
+// Defined in solvecache.c, so includers do not need the POSIX feature macros the rwlock does
+typedef struct SOLVE_CACHE_STRUCT SOLVE_CACHE;
+
+// Makes a cache that holds up to capacity paths and maxBytes of encoded paths
+SOLVE_CACHE* newSolveCache(uint32_t capacity, size_t maxBytes);
+
+// Frees a SOLVE_CACHE struct and all subelements
+void freeSolveCache(SOLVE_CACHE** toFree);
+
+// Looks a key up and decodes its path into path (cells from arena, which can be NULL)
+// Returns false on a miss, hits and misses are counted either way
+bool solveCacheFind(SOLVE_CACHE* cache, SOLVE_KEY* key, PATH* path, ARENA* arena);
+
+// Stores the path for a key, evicting old entries to make room
+// Returns false if the path could not be encoded or is larger than the whole byte budget
+bool solveCacheStore(SOLVE_CACHE* cache, SOLVE_KEY* key, PATH* path, int width);
+
+// Reads the counters of a cache
+SOLVE_CACHE_COUNTS solveCacheCounts(SOLVE_CACHE* cache);
+
+// Encodes a path of a maze width cells wide (free the result with free)
+// cells is set to the number of cells decodePath gives back
+uint8_t* encodePath(PATH* path, int width, size_t* bytes, uint32_t* cells);
+
+// Decodes cells cells of an encoded path into path, with cells from arena
+bool decodePath(const uint8_t* runs, size_t bytes, uint32_t cells, int width, PATH* path, ARENA* arena);
+
+#endif
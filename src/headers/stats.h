@@ -0,0 +1,56 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+    Process wide counters, compiled in with make INSTRUMENT=1 (-DINSTRUMENT).
+
+    Without INSTRUMENT every countStat and raiseStat is an empty statement,
+    so a normal build pays nothing for them. With it the counters are added
+    to atomically, so batch threads can share them. The hot loops never touch
+    them directly: the open set counts into its own PQUEUE and hands the
+    totals over when it is cleared or freed.
+
+    Every open set is counted, including the ones used to build landmarks
+    and HPA* clusters, and every search of a -repeat run.
+*/
+
+typedef struct SOLVER_STATS_STRUCT {
+    // Open set operations, and the most ids any one queue held at once
+    uint64_t queuePushes;
+    uint64_t decreaseKeys;
+    uint64_t openPeak;
+
+    // Bytes read from and written to maze, cache and landmark files (mapped files count whole)
+    uint64_t bytesRead;
+    uint64_t bytesWritten;
+
+    // File calls made by the solver, each stdio call counted once
+    // (open, stat, mmap, munmap, read, write, close, ...)
+    uint64_t syscalls;
+} SOLVER_STATS;
+
+extern SOLVER_STATS solverStats;
+
+#ifdef INSTRUMENT
+#define instrumented true
+#define countStat(field, amount) __atomic_fetch_add(&(solverStats.field), (uint64_t)(amount), __ATOMIC_RELAXED)
+#define raiseStat(field, value) raiseCounter(&(solverStats.field), (uint64_t)(value))
+#else
+#define instrumented false
+#define countStat(field, amount) ((void)0)
+#define raiseStat(field, value) ((void)0)
+#endif
+
+// Raises a counter to value if it is lower (for peaks)
+void raiseCounter(uint64_t* counter, uint64_t value);
+
+// Copy of every counter as it is now
+SOLVER_STATS readStats();
+
+// Sets every counter back to 0
+void resetStats();
+
+#endif
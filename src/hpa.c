@@ -0,0 +1,710 @@
+// Needed for pthreads under -std=c99
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <pthread.h>
+#include "hpa.h"
+#include "algos.h"
+#include "maze.h"
+#include "pqueue.h"
+
+// Same order as gridNeighbours: up, down, left, right
+static const int stepX[4] = {0, 0, -1, 1};
+static const int stepY[4] = {1, -1, 0, 0};
+
+/* CLUSTERS */
+
+// Cells a cluster covers
+typedef struct CLUSTER_RECT_STRUCT {
+    int x;
+    int y;
+    int width;
+    int height;
+} CLUSTER_RECT;
+
+static CLUSTER_RECT clusterRect(HPA* hpa, uint32_t cluster)
+{
+    int size = hpa->clusterSize;
+    CLUSTER_RECT rect;
+    rect.x = (cluster % hpa->clustersX) * size;
+    rect.y = (cluster / hpa->clustersX) * size;
+    rect.width = (hpa->width - rect.x < size) ? hpa->width - rect.x : size;
+    rect.height = (hpa->height - rect.y < size) ? hpa->height - rect.y : size;
+    return rect;
+}
+
+static uint32_t cellCluster(HPA* hpa, uint32_t cell)
+{
+    uint32_t x = cell % (uint32_t)hpa->width;
+    uint32_t y = cell / (uint32_t)hpa->width;
+    return (x / hpa->clusterSize) + (hpa->clustersX * (y / hpa->clusterSize));
+}
+
+// Index of a cell in the scratch arrays of its cluster
+static int localIndex(HPA* hpa, CLUSTER_RECT rect, uint32_t cell)
+{
+    int x = cell % (uint32_t)hpa->width;
+    int y = cell / (uint32_t)hpa->width;
+    return (x - rect.x) + (rect.width * (y - rect.y));
+}
+
+/*
+    Breadth first search from one cell that never leaves its cluster.
+    Afterwards cost holds the distance to every cell of the cluster (hpaNoDistance
+    if it cannot be reached) and from the next cell on the way back to source,
+    both indexed like localIndex. A cluster has at most 255 * 255 cells, so
+    uint16_t is enough for all of it.
+*/
+static void clusterSweep(MAZE* maze, CLUSTER_RECT rect, int source, uint16_t* cost, uint16_t* from, uint16_t* queue)
+{
+    int cells = rect.width * rect.height;
+    for(int i = 0; i < cells; i++)
+    {
+        cost[i] = hpaNoDistance;
+    }
+    cost[source] = 0;
+    from[source] = source;
+
+    int head = 0;
+    int tail = 0;
+    queue[tail++] = source;
+    while(head < tail)
+    {
+        int current = queue[head++];
+        int x = current % rect.width;
+        int y = current / rect.width;
+        for(int i = 0; i < 4; i++)
+        {
+            int nextX = x + stepX[i];
+            int nextY = y + stepY[i];
+            if(nextX < 0 || nextY < 0 || nextX >= rect.width || nextY >= rect.height)
+            {
+                continue;
+            }
+            int next = nextX + (rect.width * nextY);
+            if(cost[next] != hpaNoDistance || !mazeIsOpen(maze, rect.x + nextX, rect.y + nextY))
+            {
+                continue;
+            }
+            cost[next] = cost[current] + 1;
+            from[next] = current;
+            queue[tail++] = next;
+        }
+    }
+}
+
+/* ENTRANCES */
+
+typedef struct CELL_LIST_STRUCT {
+    uint32_t* cells;
+    uint32_t count;
+    uint32_t capacity;
+} CELL_LIST;
+
+static bool listAdd(CELL_LIST* list, uint32_t cell)
+{
+    if(list->count == list->capacity)
+    {
+        uint32_t capacity = (list->capacity > 0) ? list->capacity * 2 : 1024;
+        uint32_t* cells = realloc(list->cells, sizeof(uint32_t) * capacity);
+        if(cells == NULL)
+        {
+            return false;
+        }
+        list->cells = cells;
+        list->capacity = capacity;
+    }
+    list->cells[list->count++] = cell;
+    return true;
+}
+
+// Adds this side's cell of every transition on one border of a cluster
+// The border is length cells from (x, y) in steps of (dx, dy), the other side of it is (acrossX, acrossY) away
+// Both clusters walk a border the same way, so they always agree on where the transitions are
+static bool borderTransitions(MAZE* maze, int x, int y, int dx, int dy, int acrossX, int acrossY, int length, CELL_LIST* list)
+{
+    int runStart = 0;
+    for(int k = 0; k <= length; k++)
+    {
+        int cellX = x + (k * dx);
+        int cellY = y + (k * dy);
+        if(k < length && mazeIsOpen(maze, cellX, cellY) && mazeIsOpen(maze, cellX + acrossX, cellY + acrossY))
+        {
+            continue;
+        }
+
+        int runLength = k - runStart;
+        if(runLength > 0)
+        {
+            int first = runStart;
+            int last = k - 1;
+            if(runLength < hpaWideEntrance)
+            {
+                first = runStart + ((runLength - 1) / 2);
+                last = first;
+            }
+            bool added = listAdd(list, (x + (first * dx)) + (maze->width * (uint32_t)(y + (first * dy))));
+            if(added && last != first)
+            {
+                added = listAdd(list, (x + (last * dx)) + (maze->width * (uint32_t)(y + (last * dy))));
+            }
+            if(!added)
+            {
+                return false;
+            }
+        }
+        runStart = k + 1;
+    }
+    return true;
+}
+
+static int compareCells(const void* a, const void* b)
+{
+    uint32_t first = *(const uint32_t*)a;
+    uint32_t second = *(const uint32_t*)b;
+    return (first > second) - (first < second);
+}
+
+// Node at a cell (noItem if the cell is not a transition)
+static uint32_t nodeAt(HPA* hpa, uint32_t cell)
+{
+    uint32_t cluster = cellCluster(hpa, cell);
+    uint32_t low = hpa->clusterFirst[cluster];
+    uint32_t high = hpa->clusterFirst[cluster + 1];
+    while(low < high)
+    {
+        uint32_t middle = low + ((high - low) / 2);
+        if(hpa->nodeCell[middle] < cell)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+    return (low < hpa->clusterFirst[cluster + 1] && hpa->nodeCell[low] == cell) ? low : noItem;
+}
+
+// Finds every transition, grouped by cluster
+static bool findTransitions(HPA* hpa, MAZE* maze)
+{
+    uint32_t numClusters = hpa->clustersX * hpa->clustersY;
+    CELL_LIST list = {NULL, 0, 0};
+    bool added = true;
+    for(uint32_t cluster = 0; added && cluster < numClusters; cluster++)
+    {
+        hpa->clusterFirst[cluster] = list.count;
+        CLUSTER_RECT rect = clusterRect(hpa, cluster);
+        int right = rect.x + rect.width - 1;
+        int top = rect.y + rect.height - 1;
+        if(rect.x > 0)
+        {
+            added = added && borderTransitions(maze, rect.x, rect.y, 0, 1, -1, 0, rect.height, &list);
+        }
+        if(right + 1 < hpa->width)
+        {
+            added = added && borderTransitions(maze, right, rect.y, 0, 1, 1, 0, rect.height, &list);
+        }
+        if(rect.y > 0)
+        {
+            added = added && borderTransitions(maze, rect.x, rect.y, 1, 0, 0, -1, rect.width, &list);
+        }
+        if(top + 1 < hpa->height)
+        {
+            added = added && borderTransitions(maze, rect.x, top, 1, 0, 0, 1, rect.width, &list);
+        }
+    }
+    if(!added)
+    {
+        free(list.cells);
+        return false;
+    }
+
+    // A corner cell can be a transition for two borders, keep it once
+    uint32_t numNodes = 0;
+    for(uint32_t cluster = 0; cluster < numClusters; cluster++)
+    {
+        uint32_t first = hpa->clusterFirst[cluster];
+        uint32_t last = (cluster + 1 < numClusters) ? hpa->clusterFirst[cluster + 1] : list.count;
+        if(last > first)
+        {
+            qsort(list.cells + first, last - first, sizeof(uint32_t), compareCells);
+        }
+        hpa->clusterFirst[cluster] = numNodes;
+        for(uint32_t i = first; i < last; i++)
+        {
+            if(i == first || list.cells[i] != list.cells[i - 1])
+            {
+                list.cells[numNodes++] = list.cells[i];
+            }
+        }
+    }
+    hpa->clusterFirst[numClusters] = numNodes;
+    hpa->numNodes = numNodes;
+
+    hpa->nodeCell = allocIn(hpa->arena, sizeof(uint32_t) * ((numNodes > 0) ? numNodes : 1));
+    if(hpa->nodeCell != NULL && numNodes > 0)
+    {
+        memcpy(hpa->nodeCell, list.cells, sizeof(uint32_t) * numNodes);
+    }
+    free(list.cells);
+    return hpa->nodeCell != NULL;
+}
+
+// Links every node to the nodes right next to it in other clusters
+static void linkAcross(HPA* hpa, MAZE* maze)
+{
+    uint32_t width = hpa->width;
+    for(uint32_t node = 0; node < hpa->numNodes; node++)
+    {
+        uint32_t cell = hpa->nodeCell[node];
+        int x = cell % width;
+        int y = cell / width;
+        for(int i = 0; i < 4; i++)
+        {
+            int nextX = x + stepX[i];
+            int nextY = y + stepY[i];
+            uint32_t next = noItem;
+            if(nextX >= 0 && nextY >= 0 && nextX < hpa->width && nextY < hpa->height && mazeIsOpen(maze, nextX, nextY))
+            {
+                uint32_t nextCell = nextX + (width * nextY);
+                if(cellCluster(hpa, nextCell) != cellCluster(hpa, cell))
+                {
+                    next = nodeAt(hpa, nextCell);
+                }
+            }
+            hpa->across[(node * 4) + i] = next;
+        }
+    }
+}
+
+/* DISTANCES INSIDE CLUSTERS */
+
+typedef struct HPA_BUILD_STRUCT {
+    HPA* hpa;
+    MAZE* maze;
+
+    // Next cluster to hand out, taken with an atomic add
+    uint32_t next;
+} HPA_BUILD;
+
+static void* buildWorker(void* arg)
+{
+    HPA_BUILD* build = arg;
+    HPA* hpa = build->hpa;
+    size_t cells = (size_t)hpa->clusterSize * hpa->clusterSize;
+    uint16_t* cost = malloc(sizeof(uint16_t) * cells);
+    uint16_t* from = malloc(sizeof(uint16_t) * cells);
+    uint16_t* queue = malloc(sizeof(uint16_t) * cells);
+
+    // Without scratch this thread takes no clusters, the others still get through all of them
+    uint32_t numClusters = hpa->clustersX * hpa->clustersY;
+    while(cost != NULL && from != NULL && queue != NULL)
+    {
+        uint32_t cluster = __atomic_fetch_add(&(build->next), 1, __ATOMIC_RELAXED);
+        if(cluster >= numClusters)
+        {
+            break;
+        }
+        CLUSTER_RECT rect = clusterRect(hpa, cluster);
+        uint32_t first = hpa->clusterFirst[cluster];
+        uint32_t count = hpa->clusterFirst[cluster + 1] - first;
+        uint16_t* table = hpa->distances + hpa->tableStart[cluster];
+        for(uint32_t i = 0; i < count; i++)
+        {
+            clusterSweep(build->maze, rect, localIndex(hpa, rect, hpa->nodeCell[first + i]), cost, from, queue);
+            for(uint32_t j = 0; j < count; j++)
+            {
+                table[(i * count) + j] = cost[localIndex(hpa, rect, hpa->nodeCell[first + j])];
+            }
+        }
+    }
+
+    free(cost);
+    free(from);
+    free(queue);
+    return NULL;
+}
+
+static bool buildTables(HPA* hpa, MAZE* maze, int numThreads)
+{
+    HPA_BUILD build = {hpa, maze, 0};
+    pthread_t* threads = NULL;
+    int started = 0;
+    if(numThreads > 1)
+    {
+        threads = malloc(sizeof(pthread_t) * (numThreads - 1));
+    }
+    for(int i = 0; threads != NULL && i < numThreads - 1; i++)
+    {
+        if(pthread_create(&(threads[i]), NULL, buildWorker, &build) != 0)
+        {
+            break;
+        }
+        started++;
+    }
+    buildWorker(&build);
+    for(int i = 0; i < started; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+    free(threads);
+
+    // Every cluster was handed out unless every thread ran out of memory
+    return __atomic_load_n(&(build.next), __ATOMIC_RELAXED) >= hpa->clustersX * hpa->clustersY;
+}
+
+/* BUILD */
+
+HPA* buildHPA(GRAPH* graph, uint32_t clusterSize, int numThreads)
+{
+    if(graph == NULL || graph->maze == NULL)
+    {
+        return NULL;
+    }
+    if(graph->maze->costs != NULL)
+    {
+        errMsg("buildHPA", "Clusters are only built for unweighted mazes!");
+        return NULL;
+    }
+    clusterSize = (clusterSize < 2) ? 2 : clusterSize;
+    clusterSize = (clusterSize > hpaMaxCluster) ? hpaMaxCluster : clusterSize;
+
+    ARENA* arena = graph->arena;
+    MAZE* maze = graph->maze;
+    HPA* toReturn = callocIn(arena, 1, sizeof(HPA));
+    if(toReturn == NULL)
+    {
+        return NULL;
+    }
+    toReturn->arena = arena;
+    toReturn->width = graph->width;
+    toReturn->height = graph->height;
+    toReturn->clusterSize = clusterSize;
+    toReturn->clustersX = (graph->width + clusterSize - 1) / clusterSize;
+    toReturn->clustersY = (graph->height + clusterSize - 1) / clusterSize;
+
+    uint32_t numClusters = toReturn->clustersX * toReturn->clustersY;
+    toReturn->clusterFirst = allocIn(arena, sizeof(uint32_t) * (numClusters + 1));
+    toReturn->tableStart = allocIn(arena, sizeof(size_t) * (numClusters + 1));
+    if(toReturn->clusterFirst == NULL || toReturn->tableStart == NULL || !findTransitions(toReturn, maze))
+    {
+        freeHPA(&toReturn);
+        return NULL;
+    }
+
+    uint32_t numNodes = toReturn->numNodes;
+    uint32_t largest = 1;
+    toReturn->tableStart[0] = 0;
+    for(uint32_t cluster = 0; cluster < numClusters; cluster++)
+    {
+        size_t count = toReturn->clusterFirst[cluster + 1] - toReturn->clusterFirst[cluster];
+        toReturn->tableStart[cluster + 1] = toReturn->tableStart[cluster] + (count * count);
+        largest = (count > largest) ? count : largest;
+    }
+
+    size_t cells = (size_t)clusterSize * clusterSize;
+    toReturn->across = allocIn(arena, sizeof(uint32_t) * 4 * ((numNodes > 0) ? numNodes : 1));
+    toReturn->distances = allocIn(arena, sizeof(uint16_t) * ((toReturn->tableStart[numClusters] > 0) ? toReturn->tableStart[numClusters] : 1));
+    toReturn->open = newQueue(numNodes + 2, arena);
+    toReturn->cost = allocIn(arena, sizeof(uint32_t) * (numNodes + 2));
+    toReturn->from = allocIn(arena, sizeof(uint32_t) * (numNodes + 2));
+    toReturn->stamp = callocIn(arena, numNodes + 2, sizeof(uint32_t));
+    toReturn->startLinks = allocIn(arena, sizeof(uint32_t) * largest);
+    toReturn->endLinks = allocIn(arena, sizeof(uint32_t) * largest);
+    toReturn->scratchCost = allocIn(arena, sizeof(uint16_t) * cells);
+    toReturn->scratchFrom = allocIn(arena, sizeof(uint16_t) * cells);
+    toReturn->scratchQueue = allocIn(arena, sizeof(uint16_t) * cells);
+    if(toReturn->across == NULL || toReturn->distances == NULL || toReturn->open == NULL
+        || toReturn->cost == NULL || toReturn->from == NULL || toReturn->stamp == NULL
+        || toReturn->startLinks == NULL || toReturn->endLinks == NULL
+        || toReturn->scratchCost == NULL || toReturn->scratchFrom == NULL || toReturn->scratchQueue == NULL)
+    {
+        errMsg("buildHPA", "Could not allocate the abstract graph!");
+        freeHPA(&toReturn);
+        return NULL;
+    }
+
+    linkAcross(toReturn, maze);
+    if(!buildTables(toReturn, maze, numThreads))
+    {
+        errMsg("buildHPA", "Could not allocate cluster scratch!");
+        freeHPA(&toReturn);
+        return NULL;
+    }
+    return toReturn;
+}
+
+void freeHPA(HPA** toFree)
+{
+    HPA* temp = (*toFree);
+    if(temp == NULL)
+    {
+        return;
+    }
+    ARENA* arena = temp->arena;
+    freeIn(arena, temp->nodeCell);
+    freeIn(arena, temp->clusterFirst);
+    freeIn(arena, temp->across);
+    freeIn(arena, temp->tableStart);
+    freeIn(arena, temp->distances);
+    freeQueue(&(temp->open));
+    freeIn(arena, temp->cost);
+    freeIn(arena, temp->from);
+    freeIn(arena, temp->stamp);
+    freeIn(arena, temp->startLinks);
+    freeIn(arena, temp->endLinks);
+    freeIn(arena, temp->scratchCost);
+    freeIn(arena, temp->scratchFrom);
+    freeIn(arena, temp->scratchQueue);
+    freeIn(arena, temp);
+    (*toFree) = NULL;
+}
+
+size_t hpaBytes(HPA* hpa)
+{
+    uint32_t numClusters = hpa->clustersX * hpa->clustersY;
+    size_t bytes = sizeof(uint32_t) * hpa->numNodes * 5;
+    bytes += (sizeof(uint32_t) + sizeof(size_t)) * (numClusters + 1);
+    bytes += sizeof(uint16_t) * hpa->tableStart[numClusters];
+    bytes += sizeof(uint32_t) * 3 * (hpa->numNodes + 2);
+    return bytes;
+}
+
+/* SEARCH */
+
+typedef struct HPA_QUERY_STRUCT {
+    HPA* hpa;
+    uint32_t startCell;
+    uint32_t endCell;
+    uint32_t touched;
+    uint32_t closed;
+} HPA_QUERY;
+
+// Sweeps from a cell and keeps its distance to every node of its cluster in links
+// Returns the distance to target if it is in the same cluster and can be reached (UINT32_MAX if not)
+static uint32_t linkCell(HPA* hpa, MAZE* maze, uint32_t cell, uint32_t target, uint32_t* links)
+{
+    uint32_t cluster = cellCluster(hpa, cell);
+    CLUSTER_RECT rect = clusterRect(hpa, cluster);
+    clusterSweep(maze, rect, localIndex(hpa, rect, cell), hpa->scratchCost, hpa->scratchFrom, hpa->scratchQueue);
+
+    uint32_t first = hpa->clusterFirst[cluster];
+    uint32_t count = hpa->clusterFirst[cluster + 1] - first;
+    for(uint32_t i = 0; i < count; i++)
+    {
+        uint16_t distance = hpa->scratchCost[localIndex(hpa, rect, hpa->nodeCell[first + i])];
+        links[i] = (distance == hpaNoDistance) ? UINT32_MAX : distance;
+    }
+    if(cellCluster(hpa, target) != cluster)
+    {
+        return UINT32_MAX;
+    }
+    uint16_t distance = hpa->scratchCost[localIndex(hpa, rect, target)];
+    return (distance == hpaNoDistance) ? UINT32_MAX : distance;
+}
+
+static uint32_t abstractCell(HPA_QUERY* query, uint32_t id)
+{
+    HPA* hpa = query->hpa;
+    if(id < hpa->numNodes)
+    {
+        return hpa->nodeCell[id];
+    }
+    return (id == hpa->numNodes) ? query->startCell : query->endCell;
+}
+
+static bool relax(HPA_QUERY* query, uint32_t current, uint32_t next, uint32_t edgeCost)
+{
+    HPA* hpa = query->hpa;
+    if(edgeCost == UINT32_MAX || hpa->stamp[next] == query->closed)
+    {
+        return true;
+    }
+    uint32_t newCost = hpa->cost[current] + edgeCost;
+    if(hpa->stamp[next] == query->touched && newCost >= hpa->cost[next])
+    {
+        return true;
+    }
+    hpa->stamp[next] = query->touched;
+    hpa->cost[next] = newCost;
+    hpa->from[next] = current;
+
+    uint32_t key = newCost + cellDistance(abstractCell(query, next), query->endCell, hpa->width);
+    return queueContains(hpa->open, next) ? queueDecrease(hpa->open, next, key) : queuePush(hpa->open, next, key);
+}
+
+// Fills in the cells between two cells of the same cluster, appending everything after from
+static uint32_t refineStep(HPA* hpa, MAZE* maze, uint32_t from, uint32_t to, uint32_t* cells)
+{
+    CLUSTER_RECT rect = clusterRect(hpa, cellCluster(hpa, to));
+    int target = localIndex(hpa, rect, to);
+    clusterSweep(maze, rect, target, hpa->scratchCost, hpa->scratchFrom, hpa->scratchQueue);
+
+    uint32_t count = 0;
+    int current = localIndex(hpa, rect, from);
+    while(current != target)
+    {
+        current = hpa->scratchFrom[current];
+        cells[count++] = (rect.x + (current % rect.width)) + ((uint32_t)hpa->width * (rect.y + (current / rect.width)));
+    }
+    return count;
+}
+
+bool solveHPA(GRAPH* graph, uint32_t startCell, uint32_t endCell, PATH* path, SEARCH_STATS* stats)
+{
+    if(graph == NULL || graph->hpa == NULL || path == NULL)
+    {
+        return false;
+    }
+    HPA* hpa = graph->hpa;
+    MAZE* maze = graph->maze;
+    uint32_t area = (uint32_t)graph->width * (uint32_t)graph->height;
+    if(startCell >= area || endCell >= area || !mazeCellIsOpen(maze, startCell) || !mazeCellIsOpen(maze, endCell))
+    {
+        errMsg("solveHPA", "Start and end have to be open cells!");
+        return false;
+    }
+
+    // Same stamping as nextGeneration
+    if(hpa->generation >= (UINT32_MAX / 2) - 1)
+    {
+        memset(hpa->stamp, 0, sizeof(uint32_t) * (hpa->numNodes + 2));
+        hpa->generation = 0;
+    }
+    hpa->generation++;
+    HPA_QUERY query = {hpa, startCell, endCell, 2 * hpa->generation, (2 * hpa->generation) + 1};
+
+    // Start and end become two more nodes, linked to the nodes of their clusters (and each other)
+    uint32_t startId = hpa->numNodes;
+    uint32_t endId = hpa->numNodes + 1;
+    uint32_t startCluster = cellCluster(hpa, startCell);
+    uint32_t endCluster = cellCluster(hpa, endCell);
+    uint32_t direct = linkCell(hpa, maze, startCell, endCell, hpa->startLinks);
+    linkCell(hpa, maze, endCell, startCell, hpa->endLinks);
+
+    PQUEUE* open = hpa->open;
+    queueClear(open);
+    hpa->stamp[startId] = query.touched;
+    hpa->cost[startId] = 0;
+    hpa->from[startId] = noItem;
+    queuePush(open, startId, cellDistance(startCell, endCell, graph->width));
+
+    uint64_t expanded = 0;
+    bool queued = true;
+    while(queued && !queueEmpty(open))
+    {
+        uint32_t current = queuePop(open);
+        hpa->stamp[current] = query.closed;
+        expanded++;
+        if(current == endId)
+        {
+            break;
+        }
+
+        if(current == startId)
+        {
+            uint32_t first = hpa->clusterFirst[startCluster];
+            uint32_t count = hpa->clusterFirst[startCluster + 1] - first;
+            for(uint32_t i = 0; queued && i < count; i++)
+            {
+                queued = relax(&query, current, first + i, hpa->startLinks[i]);
+            }
+            queued = queued && relax(&query, current, endId, direct);
+            continue;
+        }
+
+        uint32_t cluster = cellCluster(hpa, hpa->nodeCell[current]);
+        uint32_t first = hpa->clusterFirst[cluster];
+        uint32_t count = hpa->clusterFirst[cluster + 1] - first;
+        uint16_t* row = hpa->distances + hpa->tableStart[cluster] + ((size_t)(current - first) * count);
+        for(uint32_t i = 0; queued && i < count; i++)
+        {
+            if(row[i] != hpaNoDistance && first + i != current)
+            {
+                queued = relax(&query, current, first + i, row[i]);
+            }
+        }
+        for(int i = 0; queued && i < 4; i++)
+        {
+            uint32_t next = hpa->across[(current * 4) + i];
+            if(next != noItem)
+            {
+                queued = relax(&query, current, next, 1);
+            }
+        }
+        if(queued && cluster == endCluster)
+        {
+            queued = relax(&query, current, endId, hpa->endLinks[current - first]);
+        }
+    }
+    if(!queued)
+    {
+        errMsg("solveHPA", "Open set ran out of memory!");
+        return false;
+    }
+
+    if(stats != NULL)
+    {
+        stats->expanded = expanded;
+        stats->forwardExpanded = expanded;
+        stats->backwardExpanded = 0;
+    }
+    if(hpa->stamp[endId] != query.closed)
+    {
+        return false;
+    }
+
+    // Abstract path from start to end
+    uint32_t steps = 0;
+    for(uint32_t id = endId; id != noItem; id = hpa->from[id])
+    {
+        steps++;
+    }
+    uint32_t* ids = malloc(sizeof(uint32_t) * steps);
+    uint32_t length = hpa->cost[endId] + 1;
+    path->arena = graph->arena;
+    path->cells = allocIn(path->arena, sizeof(uint32_t) * length);
+    if(ids == NULL || path->cells == NULL)
+    {
+        free(ids);
+        freePath(path);
+        return false;
+    }
+    uint32_t step = steps;
+    for(uint32_t id = endId; id != noItem; id = hpa->from[id])
+    {
+        ids[--step] = id;
+    }
+
+    // Steps across a border are between neighbouring cells, steps inside a cluster are filled in
+    uint32_t filled = 0;
+    path->cells[filled++] = startCell;
+    for(uint32_t i = 1; i < steps; i++)
+    {
+        uint32_t from = abstractCell(&query, ids[i - 1]);
+        uint32_t to = abstractCell(&query, ids[i]);
+        if(from == to)
+        {
+            continue;
+        }
+        if(cellCluster(hpa, from) != cellCluster(hpa, to))
+        {
+            path->cells[filled++] = to;
+        }
+        else
+        {
+            filled += refineStep(hpa, maze, from, to, path->cells + filled);
+        }
+    }
+    free(ids);
+
+    path->length = filled;
+    path->cost = hpa->cost[endId];
+    return true;
+}
@@ -0,0 +1,227 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "jps.h"
+#include "algos.h"
+#include "maze.h"
+#include "pqueue.h"
+
+// mazeIsOpen with the left, bottom and top edges checked (the right edge is always a wall)
+static inline bool cellOpen(const MAZE* maze, int x, int y)
+{
+    return x >= 0 && y >= 0 && y < maze->height && mazeIsOpen(maze, x, y);
+}
+
+// Runs along the row from (x, y) in direction dx, returns the first jump point or noCell
+static uint32_t jumpRow(const MAZE* maze, int x, int y, int dx, uint32_t endCell)
+{
+    int width = maze->width;
+    while(true)
+    {
+        x += dx;
+        if(!cellOpen(maze, x, y))
+        {
+            return noCell;
+        }
+        uint32_t cell = x + (width * y);
+        if(cell == endCell)
+        {
+            return cell;
+        }
+
+        // A cell above or below that could not be reached from the cell behind is a forced neighbour
+        if((cellOpen(maze, x, y + 1) && !cellOpen(maze, x - dx, y + 1))
+            || (cellOpen(maze, x, y - 1) && !cellOpen(maze, x - dx, y - 1)))
+        {
+            return cell;
+        }
+    }
+}
+
+// Runs along the column from (x, y) in direction dy, returns the first jump point or noCell
+static uint32_t jumpColumn(const MAZE* maze, int x, int y, int dy, uint32_t endCell)
+{
+    int width = maze->width;
+    while(true)
+    {
+        y += dy;
+        if(!cellOpen(maze, x, y))
+        {
+            return noCell;
+        }
+        uint32_t cell = x + (width * y);
+        if(cell == endCell)
+        {
+            return cell;
+        }
+
+        if((cellOpen(maze, x - 1, y) && !cellOpen(maze, x - 1, y - dy))
+            || (cellOpen(maze, x + 1, y) && !cellOpen(maze, x + 1, y - dy)))
+        {
+            return cell;
+        }
+
+        // Rows are only ever entered from a jump point, so stop here if either side of the row leads somewhere
+        if(jumpRow(maze, x, y, 1, endCell) != noCell || jumpRow(maze, x, y, -1, endCell) != noCell)
+        {
+            return cell;
+        }
+    }
+}
+
+bool solveJPS(GRAPH* graph, PATH* path, SEARCH_STATS* stats)
+{
+    if(graph == NULL || path == NULL)
+    {
+        return false;
+    }
+    if(graph->mode != GRAPH_GRID)
+    {
+        errMsg("solveJPS", "Jump point search only works on GRAPH_GRID graphs!");
+        return false;
+    }
+    if(graph->maze->costs != NULL)
+    {
+        errMsg("solveJPS", "Jump point search only works on unweighted mazes!");
+        return false;
+    }
+    if(!gridSearchState(graph))
+    {
+        return false;
+    }
+
+    GRID* grid = &(graph->grid);
+    MAZE* maze = grid->maze;
+    int width = grid->width;
+    uint32_t endCell = graph->endCell;
+
+    PQUEUE* open = graph->open;
+    queueClear(open);
+
+    uint32_t touched = nextGeneration(graph);
+    uint32_t closed = touched + 1;
+
+    uint64_t expanded = 0;
+    grid->stamp[graph->startCell] = touched;
+    grid->cost[graph->startCell] = 0;
+    grid->from[graph->startCell] = noCell;
+    queuePush(open, graph->startCell, 0);
+
+    while(!queueEmpty(open))
+    {
+        uint32_t current = queuePop(open);
+        grid->stamp[current] = closed;
+        expanded++;
+        if(current == endCell)
+        {
+            break;
+        }
+
+        int x = current % width;
+        int y = current / width;
+
+        // Direction the search arrived from decides which ways are worth jumping
+        // (straight on plus both turns, or all four from the start)
+        int dx = 0;
+        int dy = 0;
+        uint32_t from = grid->from[current];
+        if(from != noCell)
+        {
+            int fromX = from % width;
+            int fromY = from / width;
+            dx = (x > fromX) - (x < fromX);
+            dy = (y > fromY) - (y < fromY);
+        }
+
+        uint32_t jumps[4];
+        int count = 0;
+        if(dy == 0 && dx != -1)
+        {
+            jumps[count++] = jumpRow(maze, x, y, 1, endCell);
+        }
+        if(dy == 0 && dx != 1)
+        {
+            jumps[count++] = jumpRow(maze, x, y, -1, endCell);
+        }
+        if(dx == 0 && dy != -1)
+        {
+            jumps[count++] = jumpColumn(maze, x, y, 1, endCell);
+        }
+        if(dx == 0 && dy != 1)
+        {
+            jumps[count++] = jumpColumn(maze, x, y, -1, endCell);
+        }
+
+        // Turns
+        if(dx != 0)
+        {
+            jumps[count++] = jumpColumn(maze, x, y, 1, endCell);
+            jumps[count++] = jumpColumn(maze, x, y, -1, endCell);
+        }
+        if(dy != 0)
+        {
+            jumps[count++] = jumpRow(maze, x, y, 1, endCell);
+            jumps[count++] = jumpRow(maze, x, y, -1, endCell);
+        }
+
+        for(int i = 0; i < count; i++)
+        {
+            uint32_t next = jumps[i];
+            if(next == noCell || grid->stamp[next] == closed)
+            {
+                continue;
+            }
+
+            // Jumps are straight, so the cost is the number of cells jumped over
+            uint32_t newCost = grid->cost[current] + cellDistance(current, next, width);
+            if(grid->stamp[next] == touched && newCost >= grid->cost[next])
+            {
+                continue;
+            }
+            grid->stamp[next] = touched;
+            grid->cost[next] = newCost;
+            grid->from[next] = current;
+
+            uint32_t key = newCost + cellDistance(next, endCell, width);
+            bool queued = queueContains(open, next) ? queueDecrease(open, next, key) : queuePush(open, next, key);
+            if(!queued)
+            {
+                errMsg("solveJPS", "Open set ran out of memory!");
+                return false;
+            }
+        }
+    }
+
+    if(stats != NULL)
+    {
+        stats->expanded = expanded;
+        stats->forwardExpanded = expanded;
+        stats->backwardExpanded = 0;
+    }
+    if(grid->stamp[endCell] != closed)
+    {
+        return false;
+    }
+
+    // Only jump points have a from cell, so count them first
+    uint32_t length = 0;
+    for(uint32_t cell = endCell; cell != noCell; cell = grid->from[cell])
+    {
+        length++;
+    }
+    path->arena = graph->arena;
+    path->cells = allocIn(path->arena, sizeof(uint32_t) * length);
+    if(path->cells == NULL)
+    {
+        return false;
+    }
+    path->length = length;
+    path->cost = grid->cost[endCell];
+    for(uint32_t cell = endCell; cell != noCell; cell = grid->from[cell])
+    {
+        length--;
+        path->cells[length] = cell;
+    }
+
+    return true;
+}
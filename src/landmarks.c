@@ -0,0 +1,331 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "landmarks.h"
+#include "algos.h"
+#include "maze.h"
+#include "pqueue.h"
+#include "stats.h"
+
+// "ALT1" read as a little endian uint32_t
+#define landmarkSignature 0x31544c41
+
+/* DIJKSTRA SWEEP */
+
+// Fills distances with the distance from source to every id (UINT32_MAX if unreachable)
+static bool sweep(GRAPH* graph, PQUEUE* open, uint32_t source, uint32_t* distances)
+{
+    uint32_t numIds = graphIds(graph);
+    for(uint32_t i = 0; i < numIds; i++)
+    {
+        distances[i] = UINT32_MAX;
+    }
+    queueClear(open);
+    distances[source] = 0;
+    queuePush(open, source, 0);
+
+    uint32_t neighbours[4];
+    uint16_t costs[4];
+    while(!queueEmpty(open))
+    {
+        uint32_t current = queuePop(open);
+        int count = idNeighbours(graph, current, neighbours, costs);
+        for(int i = 0; i < count; i++)
+        {
+            uint32_t next = neighbours[i];
+            uint32_t newCost = distances[current] + costs[i];
+            if(newCost >= distances[next])
+            {
+                continue;
+            }
+            distances[next] = newCost;
+            bool queued = queueContains(open, next) ? queueDecrease(open, next, newCost) : queuePush(open, next, newCost);
+            if(!queued)
+            {
+                errMsg("buildLandmarks", "Open set ran out of memory!");
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Switches the tables to uint32_t once a distance does not fit in uint16_t
+static bool widenTables(LANDMARKS* landmarks)
+{
+    size_t entries = (size_t)landmarks->numIds * landmarks->count;
+    uint32_t* wide = allocIn(landmarks->arena, sizeof(uint32_t) * entries);
+    if(wide == NULL)
+    {
+        return false;
+    }
+    for(size_t i = 0; i < entries; i++)
+    {
+        wide[i] = (landmarks->narrow[i] == noDistance16) ? noDistance32 : landmarks->narrow[i];
+    }
+    freeIn(landmarks->arena, landmarks->narrow);
+    landmarks->narrow = NULL;
+    landmarks->wide = wide;
+    return true;
+}
+
+static LANDMARKS* newLandmarks(GRAPH* graph, uint32_t count, bool wide)
+{
+    ARENA* arena = graph->arena;
+    LANDMARKS* toReturn = callocIn(arena, 1, sizeof(LANDMARKS));
+    if(toReturn == NULL)
+    {
+        return NULL;
+    }
+    toReturn->arena = arena;
+    toReturn->count = count;
+    toReturn->numIds = graphIds(graph);
+    toReturn->ids = allocIn(arena, sizeof(uint32_t) * count);
+
+    size_t entries = (size_t)toReturn->numIds * count;
+    if(wide)
+    {
+        toReturn->wide = allocIn(arena, sizeof(uint32_t) * entries);
+    }
+    else
+    {
+        toReturn->narrow = allocIn(arena, sizeof(uint16_t) * entries);
+    }
+    if(toReturn->ids == NULL || (toReturn->wide == NULL && toReturn->narrow == NULL))
+    {
+        freeLandmarks(&toReturn);
+        return NULL;
+    }
+    return toReturn;
+}
+
+LANDMARKS* buildLandmarks(GRAPH* graph, uint32_t count)
+{
+    if(graph == NULL || count == 0)
+    {
+        return NULL;
+    }
+
+    uint32_t numIds = graphIds(graph);
+    LANDMARKS* toReturn = newLandmarks(graph, count, false);
+    PQUEUE* open = newQueue(numIds, NULL);
+    uint32_t* distances = malloc(sizeof(uint32_t) * numIds);
+
+    // Smallest distance from any landmark picked so far, the next one is wherever this is largest
+    uint32_t* nearest = malloc(sizeof(uint32_t) * numIds);
+    if(toReturn == NULL || open == NULL || distances == NULL || nearest == NULL)
+    {
+        freeLandmarks(&toReturn);
+        freeQueue(&open);
+        free(distances);
+        free(nearest);
+        return NULL;
+    }
+
+    // The first landmark is the id farthest from the maze start, which lands it in some far corner
+    bool swept = sweep(graph, open, cellId(graph, graph->startCell), distances);
+    for(uint32_t i = 0; i < numIds; i++)
+    {
+        nearest[i] = distances[i];
+    }
+
+    for(uint32_t k = 0; swept && k < count; k++)
+    {
+        uint32_t farthest = 0;
+        uint32_t farthestDistance = 0;
+        for(uint32_t i = 0; i < numIds; i++)
+        {
+            // Unreachable ids (walls in grid mode, other components) are never picked
+            if(nearest[i] != UINT32_MAX && nearest[i] >= farthestDistance)
+            {
+                farthest = i;
+                farthestDistance = nearest[i];
+            }
+        }
+        toReturn->ids[k] = farthest;
+
+        swept = sweep(graph, open, farthest, distances);
+        for(uint32_t i = 0; swept && i < numIds; i++)
+        {
+            uint32_t distance = distances[i];
+            if(distance != UINT32_MAX && distance >= noDistance16 && toReturn->narrow != NULL)
+            {
+                swept = widenTables(toReturn);
+            }
+            if(toReturn->narrow != NULL)
+            {
+                toReturn->narrow[((size_t)i * count) + k] = (distance == UINT32_MAX) ? noDistance16 : distance;
+            }
+            else
+            {
+                toReturn->wide[((size_t)i * count) + k] = distance;
+            }
+            if(distance < nearest[i])
+            {
+                nearest[i] = distance;
+            }
+        }
+    }
+
+    freeQueue(&open);
+    free(distances);
+    free(nearest);
+    if(!swept)
+    {
+        freeLandmarks(&toReturn);
+        return NULL;
+    }
+    return toReturn;
+}
+
+void freeLandmarks(LANDMARKS** toFree)
+{
+    LANDMARKS* temp = (*toFree);
+    if(temp == NULL)
+    {
+        return;
+    }
+    freeIn(temp->arena, temp->ids);
+    freeIn(temp->arena, temp->narrow);
+    freeIn(temp->arena, temp->wide);
+    freeIn(temp->arena, temp);
+    (*toFree) = NULL;
+}
+
+size_t landmarkBytes(LANDMARKS* landmarks)
+{
+    size_t entries = (size_t)landmarks->numIds * landmarks->count;
+    return entries * ((landmarks->narrow != NULL) ? sizeof(uint16_t) : sizeof(uint32_t));
+}
+
+/* FILES */
+
+/*
+    File layout, all little endian:
+        uint32_t signature ("ALT1")
+        uint32_t width, height, mode, numIds, count, wide
+        uint64_t mazeHash
+        uint32_t ids[count]
+        table (uint16_t or uint32_t per entry)
+*/
+
+bool saveLandmarks(GRAPH* graph, LANDMARKS* landmarks, char* fileName)
+{
+    if(graph == NULL || landmarks == NULL || fileName == NULL)
+    {
+        return false;
+    }
+    FILE* fp = fopen(fileName, "wb");
+    if(fp == NULL)
+    {
+        errMsg("saveLandmarks", "Could not open landmark file for writing!");
+        return false;
+    }
+
+    uint32_t header[7] = {landmarkSignature, graph->width, graph->height, graph->mode,
+        landmarks->numIds, landmarks->count, landmarks->wide != NULL};
+    uint64_t hash = mazeHash(graph->maze);
+    size_t entries = (size_t)landmarks->numIds * landmarks->count;
+
+    bool written = fwrite(header, sizeof(header), 1, fp) == 1
+        && fwrite(&hash, sizeof(hash), 1, fp) == 1
+        && fwrite(landmarks->ids, sizeof(uint32_t), landmarks->count, fp) == landmarks->count;
+    if(written && landmarks->narrow != NULL)
+    {
+        written = fwrite(landmarks->narrow, sizeof(uint16_t), entries, fp) == entries;
+    }
+    else if(written)
+    {
+        written = fwrite(landmarks->wide, sizeof(uint32_t), entries, fp) == entries;
+    }
+    countStat(syscalls, 6);
+    countStat(bytesWritten, sizeof(header) + sizeof(hash) + (sizeof(uint32_t) * landmarks->count)
+        + (entries * ((landmarks->narrow != NULL) ? sizeof(uint16_t) : sizeof(uint32_t))));
+
+    if(fclose(fp) != 0 || !written)
+    {
+        errMsg("saveLandmarks", "Could not write landmark file!");
+        return false;
+    }
+    return true;
+}
+
+LANDMARKS* loadLandmarks(GRAPH* graph, char* fileName)
+{
+    if(graph == NULL || fileName == NULL)
+    {
+        return NULL;
+    }
+    FILE* fp = fopen(fileName, "rb");
+    if(fp == NULL)
+    {
+        return NULL;
+    }
+
+    // Open, the two header reads and the close
+    countStat(syscalls, 4);
+    countStat(bytesRead, sizeof(uint32_t) * 7 + sizeof(uint64_t));
+
+    uint32_t header[7];
+    uint64_t hash = 0;
+    if(fread(header, sizeof(header), 1, fp) != 1 || fread(&hash, sizeof(hash), 1, fp) != 1)
+    {
+        fclose(fp);
+        return NULL;
+    }
+
+    // Anything that does not match means the tables are for another maze or graph mode
+    if(header[0] != landmarkSignature || header[1] != (uint32_t)graph->width || header[2] != (uint32_t)graph->height
+        || header[3] != (uint32_t)graph->mode || header[4] != graphIds(graph) || header[5] == 0
+        || hash != mazeHash(graph->maze))
+    {
+        fclose(fp);
+        return NULL;
+    }
+
+    uint32_t count = header[5];
+    LANDMARKS* toReturn = newLandmarks(graph, count, header[6] != 0);
+    if(toReturn == NULL)
+    {
+        fclose(fp);
+        return NULL;
+    }
+    size_t entries = (size_t)toReturn->numIds * count;
+    bool read = fread(toReturn->ids, sizeof(uint32_t), count, fp) == count;
+    if(read && toReturn->narrow != NULL)
+    {
+        read = fread(toReturn->narrow, sizeof(uint16_t), entries, fp) == entries;
+    }
+    else if(read)
+    {
+        read = fread(toReturn->wide, sizeof(uint32_t), entries, fp) == entries;
+    }
+    fclose(fp);
+    countStat(syscalls, 2);
+    countStat(bytesRead, (sizeof(uint32_t) * count) + (entries * ((toReturn->narrow != NULL) ? sizeof(uint16_t) : sizeof(uint32_t))));
+
+    if(!read)
+    {
+        errMsg("loadLandmarks", "Landmark file is cut short!");
+        freeLandmarks(&toReturn);
+        return NULL;
+    }
+    return toReturn;
+}
+
+bool landmarkFileName(char* bmpName, char* altName, size_t size)
+{
+    if(bmpName == NULL || altName == NULL)
+    {
+        return false;
+    }
+    int baseLength = strlen(bmpName);
+    if(endsWith(bmpName, ".bmp"))
+    {
+        baseLength -= 4;
+    }
+    int written = snprintf(altName, size, "%.*s.alt", baseLength, bmpName);
+    return written > 0 && (size_t)written < size;
+}
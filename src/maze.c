@@ -0,0 +1,427 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "maze.h"
+#include "bmp.h"
+#include "bmpstream.h"
+#include "costmap.h"
+
+// Allocates a maze with every cell a wall, and room for the cell costs if it is weighted
+static MAZE* newMaze(int width, int height, bool weighted, ARENA* arena)
+{
+    MAZE* toReturn = callocIn(arena, 1, sizeof(MAZE));
+    if(toReturn == NULL)
+    {
+        return NULL;
+    }
+    toReturn->arena = arena;
+    toReturn->width = width;
+    toReturn->height = height;
+    // Always leaves at least one padding bit, so (width, y) is a wall too
+    toReturn->rowWords = (width / 64) + 1;
+    toReturn->walls = allocIn(arena, sizeof(uint64_t) * toReturn->rowWords * height);
+    if(weighted)
+    {
+        toReturn->costs = allocIn(arena, (size_t)width * height);
+    }
+    if(toReturn->walls == NULL || (weighted && toReturn->costs == NULL))
+    {
+        freeMaze(&toReturn);
+        return NULL;
+    }
+    return toReturn;
+}
+
+// Same test packMazeRow and packCostRow make, for a single value (lookup is NULL for unweighted mazes)
+static inline bool valueIsOpen(uint32_t value, const uint8_t* openIndex, const COST_LOOKUP* lookup)
+{
+    if(lookup != NULL)
+    {
+        return lookup->cost[lookup->indexed ? (value & 0xFF) : colorLevel(value)] != 0;
+    }
+    return (openIndex != NULL) ? openIndex[value & 0xFF] : colorIsOpen(value);
+}
+
+// Packs one decoded row into the wall bitset
+// Indexed bitmaps only have a few possible values, so openIndex says which of them are open (NULL for 16/24/32 bit)
+static void packMazeRow(MAZE* maze, int y, const uint32_t* rowValues, const uint8_t* openIndex)
+{
+    int width = maze->width;
+    uint64_t* row = maze->walls + ((size_t)maze->rowWords * y);
+    uint32_t openCells = 0;
+    for(uint32_t word = 0; word < maze->rowWords; word++)
+    {
+        // Start with every bit as a wall so the padding past width stays closed
+        uint64_t bits = UINT64_MAX;
+        int firstX = word * 64;
+        int lastX = (firstX + 64 < width) ? firstX + 64 : width;
+        for(int x = firstX; x < lastX; x++)
+        {
+            bool open = valueIsOpen(rowValues[x], openIndex, NULL);
+            bits &= ~((uint64_t)open << (x - firstX));
+            openCells += open;
+        }
+        row[word] = bits;
+    }
+    maze->openCells += openCells;
+}
+
+// Weighted version of packMazeRow, the kernel fills in the costs and clears the wall bits of every cell that has one
+static void packCostRow(MAZE* maze, int y, const uint32_t* rowValues, ROW_COSTER coster, const COST_LOOKUP* lookup)
+{
+    uint64_t* row = maze->walls + ((size_t)maze->rowWords * y);
+    for(uint32_t word = 0; word < maze->rowWords; word++)
+    {
+        row[word] = UINT64_MAX;
+    }
+    coster(rowValues, maze->costs + ((size_t)maze->width * y), row, maze->width, lookup->cost);
+
+    // The padding bits are still set, so every clear bit is an open cell
+    uint32_t openCells = 0;
+    for(uint32_t word = 0; word < maze->rowWords; word++)
+    {
+        openCells += __builtin_popcountll(~row[word]);
+    }
+    maze->openCells += openCells;
+}
+
+// Kernel and lookup for a weighted maze (NULL if there is no table)
+static ROW_COSTER costsFor(BMP* bmp, COST_TABLE* table, COST_LOOKUP* lookup)
+{
+    if(table == NULL)
+    {
+        return NULL;
+    }
+    costLookupFromBMP(bmp, table, lookup);
+    return rowCoster(lookup->indexed);
+}
+
+static MAZE* finishMaze(MAZE* maze, char* func)
+{
+    if(!findMazeEndpoints(maze))
+    {
+        errMsg(func, "Maze has no opening in the top or bottom row!");
+        freeMaze(&maze);
+        return NULL;
+    }
+    return maze;
+}
+
+MAZE* mazeFromBMP(BMP* toConvert, COST_TABLE* table, ARENA* arena)
+{
+    if(toConvert == NULL || (toConvert->data.colorData == NULL && toConvert->data.rows == NULL))
+    {
+        return NULL;
+    }
+
+    int width = toConvert->data.width;
+    int height = toConvert->data.height;
+
+    MAZE* toReturn = newMaze(width, height, table != NULL, arena);
+    uint32_t* rowValues = allocIn(arena, sizeof(uint32_t) * width);
+    if(toReturn == NULL || rowValues == NULL)
+    {
+        freeIn(arena, rowValues);
+        freeMaze(&toReturn);
+        return NULL;
+    }
+
+    bool indexed = toConvert->data.bitDepth <= 8;
+    uint8_t openIndex[256];
+    if(indexed)
+    {
+        openTableFromBMP(toConvert, openIndex);
+    }
+    COST_LOOKUP lookup;
+    ROW_COSTER coster = costsFor(toConvert, table, &lookup);
+
+    for(int y = 0; y < height; y++)
+    {
+        decodeRow(toConvert, y, rowValues);
+        if(coster != NULL)
+        {
+            packCostRow(toReturn, y, rowValues, coster, &lookup);
+        }
+        else
+        {
+            packMazeRow(toReturn, y, rowValues, indexed ? openIndex : NULL);
+        }
+    }
+    freeIn(arena, rowValues);
+
+    return finishMaze(toReturn, "mazeFromBMP");
+}
+
+MAZE* mazeFromStream(BMP_STREAM* stream, COST_TABLE* table, ARENA* arena)
+{
+    if(stream == NULL)
+    {
+        return NULL;
+    }
+    BMP* bmp = stream->bmp;
+    MAZE* toReturn = newMaze(bmp->data.width, bmp->data.height, table != NULL, arena);
+    if(toReturn == NULL)
+    {
+        return NULL;
+    }
+
+    bool indexed = bmp->data.bitDepth <= 8;
+    uint8_t openIndex[256];
+    if(indexed)
+    {
+        openTableFromBMP(bmp, openIndex);
+    }
+    COST_LOOKUP lookup;
+    ROW_COSTER coster = costsFor(bmp, table, &lookup);
+
+    // Every row is packed as soon as it arrives, so only the window is ever held as pixels
+    int rows = 0;
+    int y = 0;
+    const uint32_t* rowValues = NULL;
+    while((rowValues = nextStreamRow(stream, &y)) != NULL)
+    {
+        if(coster != NULL)
+        {
+            packCostRow(toReturn, y, rowValues, coster, &lookup);
+        }
+        else
+        {
+            packMazeRow(toReturn, y, rowValues, indexed ? openIndex : NULL);
+        }
+        rows++;
+    }
+    if(rows != toReturn->height)
+    {
+        freeMaze(&toReturn);
+        return NULL;
+    }
+
+    return finishMaze(toReturn, "mazeFromStream");
+}
+
+bool bmpEndpoints(BMP* toCheck, COST_TABLE* table, uint32_t* startCell, uint32_t* endCell)
+{
+    *startCell = UINT32_MAX;
+    *endCell = UINT32_MAX;
+    if(toCheck == NULL || toCheck->data.width <= 0 || toCheck->data.height <= 0)
+    {
+        return false;
+    }
+    int width = toCheck->data.width;
+    int height = toCheck->data.height;
+    uint32_t* rowValues = malloc(sizeof(uint32_t) * width);
+    if(rowValues == NULL)
+    {
+        return false;
+    }
+
+    uint8_t openIndex[256];
+    const uint8_t* indexOpen = NULL;
+    if(toCheck->data.bitDepth <= 8)
+    {
+        openTableFromBMP(toCheck, openIndex);
+        indexOpen = openIndex;
+    }
+    COST_LOOKUP lookup;
+    const COST_LOOKUP* costs = NULL;
+    if(table != NULL)
+    {
+        costLookupFromBMP(toCheck, table, &lookup);
+        costs = &lookup;
+    }
+
+    // Top row of the image (last row of colorData) first, then the bottom row
+    int rows[2] = {height - 1, 0};
+    uint32_t* found[2] = {startCell, endCell};
+    for(int r = 0; r < 2; r++)
+    {
+        if(!decodeRow(toCheck, rows[r], rowValues))
+        {
+            break;
+        }
+        for(int x = 0; x < width; x++)
+        {
+            if(valueIsOpen(rowValues[x], indexOpen, costs))
+            {
+                *(found[r]) = x + ((uint32_t)width * rows[r]);
+                break;
+            }
+        }
+    }
+    free(rowValues);
+    return (*startCell != UINT32_MAX && *endCell != UINT32_MAX);
+}
+
+void freeMaze(MAZE** toFree)
+{
+    MAZE* temp = (*toFree);
+    if(temp == NULL)
+    {
+        return;
+    }
+    freeIn(temp->arena, temp->walls);
+    freeIn(temp->arena, temp->costs);
+    freeIn(temp->arena, temp);
+    (*toFree) = NULL;
+}
+
+void openTableFromBMP(BMP* toCheck, uint8_t openIndex[256])
+{
+    for(int i = 0; i < 256; i++)
+    {
+        if(toCheck->data.HasCTable)
+        {
+            // Indices past the end of the color table are treated as walls
+            openIndex[i] = ((uint32_t)i < toCheck->data.cTable.length) && colorIsOpen(toCheck->data.cTable.entries[i]);
+        }
+        else
+        {
+            // No color to go off of, so anything that is not 0 is open
+            openIndex[i] = (i != 0);
+        }
+    }
+}
+
+bool colorIsOpen(uint32_t color)
+{
+    // Colors are stored as 0x(AA)RRGGBB, anything brighter than mid grey is open
+    uint32_t brightness = ((color >> 16) & 0xFF) + ((color >> 8) & 0xFF) + (color & 0xFF);
+    return brightness >= 3 * 128;
+}
+
+bool findMazeEndpoints(MAZE* maze)
+{
+    int width = maze->width;
+    int height = maze->height;
+
+    // The start is the opening in the top row of the image (last row of colorData)
+    // and the end is the opening in the bottom row
+    maze->startCell = UINT32_MAX;
+    maze->endCell = UINT32_MAX;
+    for(int x = 0; x < width; x++)
+    {
+        if(maze->startCell == UINT32_MAX && mazeIsOpen(maze, x, height - 1))
+        {
+            maze->startCell = x + (width * (height - 1));
+        }
+        if(maze->endCell == UINT32_MAX && mazeIsOpen(maze, x, 0))
+        {
+            maze->endCell = x;
+        }
+    }
+
+    return (maze->startCell != UINT32_MAX && maze->endCell != UINT32_MAX);
+}
+
+bool mazeIsCorridor(MAZE* maze, int x, int y)
+{
+    // Padding bits are walls, so only x = 0 and the top and bottom rows need checks
+    bool up = (y + 1 < maze->height) && mazeIsOpen(maze, x, y + 1);
+    bool down = (y > 0) && mazeIsOpen(maze, x, y - 1);
+    bool left = (x > 0) && mazeIsOpen(maze, x - 1, y);
+    bool right = mazeIsOpen(maze, x + 1, y);
+
+    // Anything else is a junction, a turn or a dead end
+    return (up && down && !left && !right) || (left && right && !up && !down);
+}
+
+size_t mazeBytes(MAZE* maze)
+{
+    return sizeof(uint64_t) * maze->rowWords * maze->height;
+}
+
+void setMazeCell(MAZE* maze, uint32_t cell, bool open)
+{
+    int x = cell % maze->width;
+    int y = cell / maze->width;
+    uint64_t* word = &(maze->walls[((size_t)maze->rowWords * y) + (x >> 6)]);
+    uint64_t bit = (uint64_t)1 << (x & 63);
+    if(open == (((*word) & bit) == 0))
+    {
+        return;
+    }
+    if(open)
+    {
+        (*word) &= ~bit;
+        maze->openCells++;
+    }
+    else
+    {
+        (*word) |= bit;
+        maze->openCells--;
+    }
+}
+
+uint32_t* mazeChanges(MAZE* before, MAZE* after, uint32_t* count)
+{
+    *count = 0;
+    if(before == NULL || after == NULL || before->width != after->width || before->height != after->height)
+    {
+        return NULL;
+    }
+
+    // Counted first so the list is allocated once
+    size_t numWords = (size_t)before->rowWords * before->height;
+    uint32_t changed = 0;
+    for(size_t i = 0; i < numWords; i++)
+    {
+        changed += __builtin_popcountll(before->walls[i] ^ after->walls[i]);
+    }
+    uint32_t* toReturn = malloc(sizeof(uint32_t) * (changed + 1));
+    if(toReturn == NULL)
+    {
+        return NULL;
+    }
+    for(size_t i = 0; i < numWords && *count < changed; i++)
+    {
+        uint64_t diff = before->walls[i] ^ after->walls[i];
+        while(diff != 0)
+        {
+            uint32_t y = i / before->rowWords;
+            uint32_t x = ((i % before->rowWords) * 64) + __builtin_ctzll(diff);
+            toReturn[(*count)++] = x + ((uint32_t)before->width * y);
+            diff &= diff - 1;
+        }
+    }
+    return toReturn;
+}
+
+// One round of a hash lane, the rotate carries every bit of the word (bit 63 too) into the low half
+// so the next multiply spreads it over the whole lane
+static inline uint64_t hashRound(uint64_t lane, uint64_t word)
+{
+    lane += word * 0xC2B2AE3D27D4EB4FULL;
+    lane = (lane << 31) | (lane >> 33);
+    return lane * 0x9E3779B185EBCA87ULL;
+}
+
+uint64_t mazeHash(MAZE* maze)
+{
+    // Four lanes of multiply and rotate over the bitset, the same as bmpPayloadHash
+    // Weighted mazes start from other lanes, so they never match the same walls unweighted
+    uint64_t lanes[4] = {(uint64_t)maze->width, (uint64_t)maze->height, maze->costs != NULL, 0};
+    size_t count = (size_t)maze->rowWords * maze->height;
+    for(size_t i = 0; i < count; i++)
+    {
+        lanes[i & 3] = hashRound(lanes[i & 3], maze->walls[i]);
+    }
+
+    // Costs go in 8 at a time
+    if(maze->costs != NULL)
+    {
+        size_t bytes = (size_t)maze->width * maze->height;
+        for(size_t i = 0; i < bytes; i += 8)
+        {
+            uint64_t word = 0;
+            memcpy(&word, maze->costs + i, (bytes - i < 8) ? bytes - i : 8);
+            lanes[(i / 8) & 3] = hashRound(lanes[(i / 8) & 3], word);
+        }
+    }
+
+    uint64_t hash = hashRound(hashRound(hashRound(lanes[0], lanes[1]), lanes[2]), lanes[3]);
+    hash ^= hash >> 33;
+    hash *= 0xC2B2AE3D27D4EB4FULL;
+    hash ^= hash >> 29;
+    return hash;
+}
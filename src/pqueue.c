@@ -0,0 +1,634 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "pqueue.h"
+#include "stats.h"
+
+#ifdef INSTRUMENT
+#define countPush(queue) ((queue)->pushes++, (queue)->peakSize = ((queue)->size > (queue)->peakSize) ? (queue)->size : (queue)->peakSize)
+#define countDecrease(queue) ((queue)->decreases++)
+
+// Hands the counts of one queue over to solverStats
+static void flushCounts(PQUEUE* queue)
+{
+    countStat(queuePushes, queue->pushes);
+    countStat(decreaseKeys, queue->decreases);
+    raiseStat(openPeak, queue->peakSize);
+    queue->pushes = 0;
+    queue->decreases = 0;
+    queue->peakSize = 0;
+}
+#else
+#define countPush(queue) ((void)0)
+#define countDecrease(queue) ((void)0)
+#define flushCounts(queue) ((void)0)
+#endif
+
+PQUEUE* newQueue(uint32_t capacity, ARENA* arena)
+{
+    PQUEUE* toReturn = callocIn(arena, 1, sizeof(PQUEUE));
+    if(toReturn == NULL)
+    {
+        return NULL;
+    }
+    toReturn->arena = arena;
+    toReturn->capacity = capacity;
+    toReturn->size = 0;
+    toReturn->keys = allocIn(arena, sizeof(uint32_t) * capacity);
+
+#if defined(PQ_BUCKET)
+    // Starts small and doubles whenever the keys spread out further
+    toReturn->bucketCount = 64;
+    toReturn->buckets = allocIn(arena, sizeof(uint32_t) * toReturn->bucketCount);
+    toReturn->next = allocIn(arena, sizeof(uint32_t) * capacity);
+    toReturn->prev = allocIn(arena, sizeof(uint32_t) * capacity);
+    if(toReturn->keys == NULL || toReturn->buckets == NULL || toReturn->next == NULL || toReturn->prev == NULL)
+    {
+        freeQueue(&toReturn);
+        return NULL;
+    }
+    for(uint32_t i = 0; i < toReturn->bucketCount; i++)
+    {
+        toReturn->buckets[i] = noItem;
+    }
+    for(uint32_t i = 0; i < capacity; i++)
+    {
+        toReturn->prev[i] = noItem;
+    }
+#elif defined(PQ_PAIRING)
+    toReturn->root = noItem;
+    toReturn->child = allocIn(arena, sizeof(uint32_t) * capacity);
+    toReturn->sibling = allocIn(arena, sizeof(uint32_t) * capacity);
+    toReturn->prev = allocIn(arena, sizeof(uint32_t) * capacity);
+    if(toReturn->keys == NULL || toReturn->child == NULL || toReturn->sibling == NULL || toReturn->prev == NULL)
+    {
+        freeQueue(&toReturn);
+        return NULL;
+    }
+    for(uint32_t i = 0; i < capacity; i++)
+    {
+        toReturn->prev[i] = noItem;
+    }
+#else
+    toReturn->heap = allocIn(arena, sizeof(uint32_t) * capacity);
+    toReturn->position = allocIn(arena, sizeof(uint32_t) * capacity);
+    if(toReturn->keys == NULL || toReturn->heap == NULL || toReturn->position == NULL)
+    {
+        freeQueue(&toReturn);
+        return NULL;
+    }
+    for(uint32_t i = 0; i < capacity; i++)
+    {
+        toReturn->position[i] = noItem;
+    }
+#endif
+
+    return toReturn;
+}
+
+void freeQueue(PQUEUE** toFree)
+{
+    PQUEUE* temp = (*toFree);
+    if(temp == NULL)
+    {
+        return;
+    }
+    flushCounts(temp);
+    freeIn(temp->arena, temp->keys);
+#if defined(PQ_BUCKET)
+    freeIn(temp->arena, temp->buckets);
+    freeIn(temp->arena, temp->next);
+    freeIn(temp->arena, temp->prev);
+#elif defined(PQ_PAIRING)
+    freeIn(temp->arena, temp->child);
+    freeIn(temp->arena, temp->sibling);
+    freeIn(temp->arena, temp->prev);
+#else
+    freeIn(temp->arena, temp->heap);
+    freeIn(temp->arena, temp->position);
+#endif
+    freeIn(temp->arena, temp);
+    (*toFree) = NULL;
+}
+
+bool queueEmpty(PQUEUE* queue)
+{
+    return queue->size == 0;
+}
+
+#if defined(PQ_BUCKET)
+
+/* BUCKET QUEUE */
+
+// Marks the first item of a bucket in prev, so prev is only noItem for ids not in the queue
+#define bucketHead (UINT32_MAX - 1)
+
+static void linkItem(PQUEUE* queue, uint32_t id)
+{
+    uint32_t bucket = queue->keys[id] & (queue->bucketCount - 1);
+    uint32_t first = queue->buckets[bucket];
+    queue->next[id] = first;
+    queue->prev[id] = bucketHead;
+    if(first != noItem)
+    {
+        queue->prev[first] = id;
+    }
+    queue->buckets[bucket] = id;
+}
+
+static void unlinkItem(PQUEUE* queue, uint32_t id)
+{
+    uint32_t next = queue->next[id];
+    uint32_t prev = queue->prev[id];
+    if(prev == bucketHead)
+    {
+        queue->buckets[queue->keys[id] & (queue->bucketCount - 1)] = next;
+    }
+    else
+    {
+        queue->next[prev] = next;
+    }
+    if(next != noItem)
+    {
+        queue->prev[next] = prev;
+    }
+    queue->prev[id] = noItem;
+}
+
+// Doubles the ring until every key in [low, high] has its own bucket
+static bool growBuckets(PQUEUE* queue, uint32_t low, uint32_t high)
+{
+    uint32_t newCount = queue->bucketCount;
+    while(high - low >= newCount)
+    {
+        newCount *= 2;
+    }
+    if(newCount == queue->bucketCount)
+    {
+        return true;
+    }
+
+    uint32_t* newBuckets = allocIn(queue->arena, sizeof(uint32_t) * newCount);
+    if(newBuckets == NULL)
+    {
+        return false;
+    }
+    for(uint32_t i = 0; i < newCount; i++)
+    {
+        newBuckets[i] = noItem;
+    }
+
+    // Every item has to move to the bucket of its key in the bigger ring
+    uint32_t* oldBuckets = queue->buckets;
+    uint32_t oldCount = queue->bucketCount;
+    queue->buckets = newBuckets;
+    queue->bucketCount = newCount;
+    for(uint32_t i = 0; i < oldCount; i++)
+    {
+        uint32_t current = oldBuckets[i];
+        while(current != noItem)
+        {
+            uint32_t next = queue->next[current];
+            linkItem(queue, current);
+            current = next;
+        }
+    }
+    freeIn(queue->arena, oldBuckets);
+    return true;
+}
+
+// Makes room for key in the ring, moving minKey down if key is below it
+static bool fitKey(PQUEUE* queue, uint32_t key)
+{
+    if(queue->size == 0)
+    {
+        queue->minKey = key;
+        queue->maxKey = key;
+        return true;
+    }
+
+    uint32_t low = (key < queue->minKey) ? key : queue->minKey;
+    uint32_t high = (key > queue->maxKey) ? key : queue->maxKey;
+    if(high - low >= queue->bucketCount && !growBuckets(queue, low, high))
+    {
+        return false;
+    }
+    queue->minKey = low;
+    queue->maxKey = high;
+    return true;
+}
+
+// Moves minKey up to the first bucket with something in it
+static uint32_t firstBucket(PQUEUE* queue)
+{
+    uint32_t mask = queue->bucketCount - 1;
+    while(queue->buckets[queue->minKey & mask] == noItem)
+    {
+        queue->minKey++;
+    }
+    return queue->minKey & mask;
+}
+
+bool queueContains(PQUEUE* queue, uint32_t id)
+{
+    return queue->prev[id] != noItem;
+}
+
+bool queuePush(PQUEUE* queue, uint32_t id, uint32_t key)
+{
+    if(!fitKey(queue, key))
+    {
+        return false;
+    }
+    queue->keys[id] = key;
+    linkItem(queue, id);
+    queue->size++;
+    countPush(queue);
+    return true;
+}
+
+bool queueDecrease(PQUEUE* queue, uint32_t id, uint32_t key)
+{
+    // Only moving down can need a bigger ring, and the old bucket is still valid if that fails
+    if(!fitKey(queue, key))
+    {
+        return false;
+    }
+    unlinkItem(queue, id);
+    queue->keys[id] = key;
+    linkItem(queue, id);
+    countDecrease(queue);
+    return true;
+}
+
+uint32_t queuePop(PQUEUE* queue)
+{
+    if(queue->size == 0)
+    {
+        return noItem;
+    }
+
+    // Last in first out inside a bucket, which favours the deepest node on ties
+    uint32_t toReturn = queue->buckets[firstBucket(queue)];
+    unlinkItem(queue, toReturn);
+    queue->size--;
+    return toReturn;
+}
+
+void queueRemove(PQUEUE* queue, uint32_t id)
+{
+    unlinkItem(queue, id);
+    queue->size--;
+}
+
+uint32_t queueTopKey(PQUEUE* queue)
+{
+    if(queue->size == 0)
+    {
+        return UINT32_MAX;
+    }
+    firstBucket(queue);
+    return queue->minKey;
+}
+
+void queueClear(PQUEUE* queue)
+{
+    flushCounts(queue);
+    // Only the buckets between minKey and maxKey can have anything in them
+    uint32_t mask = queue->bucketCount - 1;
+    for(uint32_t key = queue->minKey; queue->size > 0; key++)
+    {
+        uint32_t current = queue->buckets[key & mask];
+        while(current != noItem)
+        {
+            uint32_t next = queue->next[current];
+            queue->prev[current] = noItem;
+            queue->size--;
+            current = next;
+        }
+        queue->buckets[key & mask] = noItem;
+    }
+}
+
+#elif defined(PQ_PAIRING)
+
+/* PAIRING HEAP */
+
+// Links two heap roots, the one with the larger key becomes the leftmost child of the other
+static uint32_t meld(PQUEUE* queue, uint32_t a, uint32_t b)
+{
+    if(a == noItem)
+    {
+        return b;
+    }
+    if(b == noItem)
+    {
+        return a;
+    }
+    if(queue->keys[b] < queue->keys[a])
+    {
+        uint32_t temp = a;
+        a = b;
+        b = temp;
+    }
+
+    queue->sibling[b] = queue->child[a];
+    if(queue->child[a] != noItem)
+    {
+        queue->prev[queue->child[a]] = b;
+    }
+    queue->prev[b] = a;
+    queue->child[a] = b;
+    return a;
+}
+
+// Takes the subtree of an id that is not the root out of its parent
+static void cutItem(PQUEUE* queue, uint32_t id)
+{
+    uint32_t prev = queue->prev[id];
+    if(queue->child[prev] == id)
+    {
+        queue->child[prev] = queue->sibling[id];
+    }
+    else
+    {
+        queue->sibling[prev] = queue->sibling[id];
+    }
+    if(queue->sibling[id] != noItem)
+    {
+        queue->prev[queue->sibling[id]] = prev;
+    }
+    queue->sibling[id] = noItem;
+    queue->prev[id] = noItem;
+}
+
+/*
+    Standard two pass merge of the children of a removed id, returns the new subtree root.
+    Pass 1 melds the children in pairs from left to right and
+    pushes every pair onto a list (reusing sibling as the link).
+    Pass 2 melds that list, which walks the pairs from right to left.
+*/
+static uint32_t mergeChildren(PQUEUE* queue, uint32_t id)
+{
+    uint32_t current = queue->child[id];
+    uint32_t pairs = noItem;
+    while(current != noItem)
+    {
+        uint32_t a = current;
+        uint32_t b = queue->sibling[a];
+        current = (b == noItem) ? noItem : queue->sibling[b];
+
+        queue->sibling[a] = noItem;
+        queue->prev[a] = noItem;
+        if(b != noItem)
+        {
+            queue->sibling[b] = noItem;
+            queue->prev[b] = noItem;
+            a = meld(queue, a, b);
+        }
+        queue->sibling[a] = pairs;
+        pairs = a;
+    }
+
+    uint32_t newRoot = noItem;
+    while(pairs != noItem)
+    {
+        uint32_t next = queue->sibling[pairs];
+        queue->sibling[pairs] = noItem;
+        newRoot = meld(queue, newRoot, pairs);
+        pairs = next;
+    }
+    if(newRoot != noItem)
+    {
+        queue->prev[newRoot] = noItem;
+    }
+    queue->child[id] = noItem;
+    return newRoot;
+}
+
+bool queueContains(PQUEUE* queue, uint32_t id)
+{
+    return id == queue->root || queue->prev[id] != noItem;
+}
+
+uint32_t queueTopKey(PQUEUE* queue)
+{
+    if(queue->size == 0)
+    {
+        return UINT32_MAX;
+    }
+    return queue->keys[queue->root];
+}
+
+bool queuePush(PQUEUE* queue, uint32_t id, uint32_t key)
+{
+    queue->keys[id] = key;
+    queue->child[id] = noItem;
+    queue->sibling[id] = noItem;
+    queue->prev[id] = noItem;
+    queue->root = meld(queue, queue->root, id);
+    queue->size++;
+    countPush(queue);
+    return true;
+}
+
+bool queueDecrease(PQUEUE* queue, uint32_t id, uint32_t key)
+{
+    countDecrease(queue);
+    queue->keys[id] = key;
+    if(id == queue->root)
+    {
+        return true;
+    }
+
+    // Cut the subtree out of its parent and meld it back in at the root
+    cutItem(queue, id);
+    queue->root = meld(queue, queue->root, id);
+    return true;
+}
+
+uint32_t queuePop(PQUEUE* queue)
+{
+    uint32_t toReturn = queue->root;
+    if(toReturn == noItem)
+    {
+        return noItem;
+    }
+    queue->root = mergeChildren(queue, toReturn);
+    queue->prev[toReturn] = noItem;
+    queue->size--;
+    return toReturn;
+}
+
+void queueRemove(PQUEUE* queue, uint32_t id)
+{
+    if(id == queue->root)
+    {
+        queuePop(queue);
+        return;
+    }
+
+    // The children of id take its place, melded back in at the root
+    cutItem(queue, id);
+    queue->root = meld(queue, queue->root, mergeChildren(queue, id));
+    queue->size--;
+}
+
+void queueClear(PQUEUE* queue)
+{
+    flushCounts(queue);
+    // Walk the whole tree so only the ids that are in the queue get touched
+    uint32_t current = queue->root;
+    while(current != noItem)
+    {
+        // Move the children of current into its sibling list before unlinking it
+        uint32_t child = queue->child[current];
+        if(child != noItem)
+        {
+            uint32_t last = child;
+            while(queue->sibling[last] != noItem)
+            {
+                last = queue->sibling[last];
+            }
+            queue->sibling[last] = queue->sibling[current];
+            queue->sibling[current] = child;
+            queue->child[current] = noItem;
+        }
+        uint32_t next = queue->sibling[current];
+        queue->prev[current] = noItem;
+        queue->sibling[current] = noItem;
+        current = next;
+    }
+    queue->root = noItem;
+    queue->size = 0;
+}
+
+#else
+
+/* BINARY HEAP */
+
+static void swapItems(PQUEUE* queue, uint32_t a, uint32_t b)
+{
+    uint32_t temp = queue->heap[a];
+    queue->heap[a] = queue->heap[b];
+    queue->heap[b] = temp;
+    queue->position[queue->heap[a]] = a;
+    queue->position[queue->heap[b]] = b;
+}
+
+static void siftUp(PQUEUE* queue, uint32_t index)
+{
+    while(index > 0)
+    {
+        uint32_t parent = (index - 1) / 2;
+        if(queue->keys[queue->heap[parent]] <= queue->keys[queue->heap[index]])
+        {
+            break;
+        }
+        swapItems(queue, parent, index);
+        index = parent;
+    }
+}
+
+static void siftDown(PQUEUE* queue, uint32_t index)
+{
+    uint32_t size = queue->size;
+    while(true)
+    {
+        uint32_t smallest = index;
+        uint32_t left = (2 * index) + 1;
+        uint32_t right = left + 1;
+        if(left < size && queue->keys[queue->heap[left]] < queue->keys[queue->heap[smallest]])
+        {
+            smallest = left;
+        }
+        if(right < size && queue->keys[queue->heap[right]] < queue->keys[queue->heap[smallest]])
+        {
+            smallest = right;
+        }
+        if(smallest == index)
+        {
+            break;
+        }
+        swapItems(queue, smallest, index);
+        index = smallest;
+    }
+}
+
+bool queueContains(PQUEUE* queue, uint32_t id)
+{
+    return queue->position[id] != noItem;
+}
+
+uint32_t queueTopKey(PQUEUE* queue)
+{
+    if(queue->size == 0)
+    {
+        return UINT32_MAX;
+    }
+    return queue->keys[queue->heap[0]];
+}
+
+bool queuePush(PQUEUE* queue, uint32_t id, uint32_t key)
+{
+    queue->keys[id] = key;
+    queue->heap[queue->size] = id;
+    queue->position[id] = queue->size;
+    queue->size++;
+    siftUp(queue, queue->size - 1);
+    countPush(queue);
+    return true;
+}
+
+bool queueDecrease(PQUEUE* queue, uint32_t id, uint32_t key)
+{
+    queue->keys[id] = key;
+    siftUp(queue, queue->position[id]);
+    countDecrease(queue);
+    return true;
+}
+
+uint32_t queuePop(PQUEUE* queue)
+{
+    if(queue->size == 0)
+    {
+        return noItem;
+    }
+    uint32_t toReturn = queue->heap[0];
+    queue->size--;
+    if(queue->size > 0)
+    {
+        queue->heap[0] = queue->heap[queue->size];
+        queue->position[queue->heap[0]] = 0;
+        siftDown(queue, 0);
+    }
+    queue->position[toReturn] = noItem;
+    return toReturn;
+}
+
+void queueRemove(PQUEUE* queue, uint32_t id)
+{
+    // The last item fills the hole, and moves whichever way its key says
+    uint32_t index = queue->position[id];
+    queue->size--;
+    if(index < queue->size)
+    {
+        queue->heap[index] = queue->heap[queue->size];
+        queue->position[queue->heap[index]] = index;
+        siftUp(queue, index);
+        siftDown(queue, index);
+    }
+    queue->position[id] = noItem;
+}
+
+void queueClear(PQUEUE* queue)
+{
+    flushCounts(queue);
+    for(uint32_t i = 0; i < queue->size; i++)
+    {
+        queue->position[queue->heap[i]] = noItem;
+    }
+    queue->size = 0;
+}
+
+#endif
@@ -0,0 +1,292 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "replan.h"
+#include "algos.h"
+#include "maze.h"
+#include "pqueue.h"
+
+#define noPath UINT32_MAX
+
+static uint32_t replanKey(REPLAN* replan, uint32_t cell)
+{
+    uint32_t best = (replan->g[cell] < replan->rhs[cell]) ? replan->g[cell] : replan->rhs[cell];
+    if(best == noPath)
+    {
+        return noPath;
+    }
+    return best + cellDistance(cell, replan->endCell, replan->graph->width);
+}
+
+// Works out rhs for a cell again and puts it on (or takes it off) the open set to match
+static bool updateCell(REPLAN* replan, uint32_t cell)
+{
+    GRAPH* graph = replan->graph;
+    if(!mazeCellIsOpen(graph->maze, cell))
+    {
+        replan->rhs[cell] = noPath;
+    }
+    else if(cell == replan->startCell)
+    {
+        replan->rhs[cell] = 0;
+    }
+    else
+    {
+        uint32_t neighbours[4];
+        int count = gridNeighbours(&(graph->grid), cell, neighbours);
+        uint32_t best = noPath;
+        for(int i = 0; i < count; i++)
+        {
+            uint32_t through = replan->g[neighbours[i]];
+            if(through != noPath && through + 1 < best)
+            {
+                best = through + 1;
+            }
+        }
+        replan->rhs[cell] = best;
+    }
+
+    PQUEUE* open = replan->open;
+    bool queued = queueContains(open, cell);
+    if(replan->g[cell] == replan->rhs[cell])
+    {
+        if(queued)
+        {
+            queueRemove(open, cell);
+        }
+        return true;
+    }
+
+    uint32_t key = replanKey(replan, cell);
+    if(queued && key <= open->keys[cell])
+    {
+        return (key == open->keys[cell]) || queueDecrease(open, cell, key);
+    }
+    if(queued)
+    {
+        queueRemove(open, cell);
+    }
+    return queuePush(open, cell, key);
+}
+
+REPLAN* newReplan(GRAPH* graph)
+{
+    if(graph == NULL || graph->mode != GRAPH_GRID)
+    {
+        errMsg("newReplan", "Replanning needs a GRAPH_GRID graph!");
+        return NULL;
+    }
+    if(graph->maze->costs != NULL)
+    {
+        errMsg("newReplan", "Replanning only works on unweighted mazes!");
+        return NULL;
+    }
+    REPLAN* toReturn = calloc(1, sizeof(REPLAN));
+    if(toReturn == NULL)
+    {
+        return NULL;
+    }
+    uint32_t area = (uint32_t)graph->width * (uint32_t)graph->height;
+    toReturn->graph = graph;
+    toReturn->startCell = graph->startCell;
+    toReturn->endCell = graph->endCell;
+    toReturn->g = malloc(sizeof(uint32_t) * area);
+    toReturn->rhs = malloc(sizeof(uint32_t) * area);
+    toReturn->open = newQueue(area, NULL);
+    if(toReturn->g == NULL || toReturn->rhs == NULL || toReturn->open == NULL)
+    {
+        freeReplan(&toReturn);
+        return NULL;
+    }
+    for(uint32_t i = 0; i < area; i++)
+    {
+        toReturn->g[i] = noPath;
+        toReturn->rhs[i] = noPath;
+    }
+
+    // The start is the only inconsistent cell until something is expanded
+    if(!updateCell(toReturn, toReturn->startCell))
+    {
+        freeReplan(&toReturn);
+        return NULL;
+    }
+    return toReturn;
+}
+
+void freeReplan(REPLAN** toFree)
+{
+    REPLAN* temp = (*toFree);
+    if(temp == NULL)
+    {
+        return;
+    }
+    free(temp->g);
+    free(temp->rhs);
+    freeQueue(&(temp->open));
+    free(temp);
+    (*toFree) = NULL;
+}
+
+// Expands inconsistent cells until the end is consistent and nothing on the open set can still lower it
+static bool computePath(REPLAN* replan, uint64_t* expanded)
+{
+    PQUEUE* open = replan->open;
+    uint32_t* g = replan->g;
+    uint32_t* rhs = replan->rhs;
+    uint32_t end = replan->endCell;
+    uint32_t neighbours[4];
+    while(!queueEmpty(open) && (queueTopKey(open) <= replanKey(replan, end) || g[end] != rhs[end]))
+    {
+        uint32_t current = queuePop(open);
+        (*expanded)++;
+
+        // Overconsistent cells settle on rhs, underconsistent ones start over from no path
+        bool settled = g[current] > rhs[current];
+        g[current] = settled ? rhs[current] : noPath;
+        if(!settled && !updateCell(replan, current))
+        {
+            return false;
+        }
+        int count = gridNeighbours(&(replan->graph->grid), current, neighbours);
+        for(int i = 0; i < count; i++)
+        {
+            if(!updateCell(replan, neighbours[i]))
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool replanPath(REPLAN* replan, PATH* path, SEARCH_STATS* stats)
+{
+    if(replan == NULL || path == NULL)
+    {
+        return false;
+    }
+    uint64_t expanded = 0;
+    bool computed = computePath(replan, &expanded);
+    if(stats != NULL)
+    {
+        stats->expanded = expanded;
+        stats->forwardExpanded = expanded;
+        stats->backwardExpanded = 0;
+    }
+    uint32_t cost = replan->g[replan->endCell];
+    if(!computed)
+    {
+        errMsg("replanPath", "Open set ran out of memory!");
+        return false;
+    }
+    if(cost == noPath)
+    {
+        return false;
+    }
+
+    // Walks back from the end, always to a neighbour one step closer to the start
+    GRAPH* graph = replan->graph;
+    uint32_t length = cost + 1;
+    path->arena = graph->arena;
+    path->cells = allocIn(path->arena, sizeof(uint32_t) * length);
+    if(path->cells == NULL)
+    {
+        return false;
+    }
+    path->length = length;
+    path->cost = cost;
+    uint32_t current = replan->endCell;
+    uint32_t neighbours[4];
+    for(uint32_t i = length; i > 1; i--)
+    {
+        path->cells[i - 1] = current;
+        int count = gridNeighbours(&(graph->grid), current, neighbours);
+        uint32_t next = noCell;
+        for(int n = 0; n < count && next == noCell; n++)
+        {
+            if(replan->g[neighbours[n]] == replan->g[current] - 1)
+            {
+                next = neighbours[n];
+            }
+        }
+        if(next == noCell)
+        {
+            errMsg("replanPath", "Path is broken!");
+            freePath(path);
+            return false;
+        }
+        current = next;
+    }
+    path->cells[0] = current;
+    return true;
+}
+
+bool replanCells(REPLAN* replan, uint32_t* cells, bool* open, uint32_t count)
+{
+    if(replan == NULL || (count > 0 && (cells == NULL || open == NULL)))
+    {
+        return false;
+    }
+    GRAPH* graph = replan->graph;
+    uint32_t area = (uint32_t)graph->width * (uint32_t)graph->height;
+    for(uint32_t i = 0; i < count; i++)
+    {
+        if(cells[i] >= area)
+        {
+            continue;
+        }
+        setMazeCell(graph->maze, cells[i], open[i]);
+    }
+
+    // Only once every wall is in place, so no cell is looked at with half of the changes
+    uint32_t neighbours[4];
+    for(uint32_t i = 0; i < count; i++)
+    {
+        if(cells[i] >= area)
+        {
+            continue;
+        }
+        if(!updateCell(replan, cells[i]))
+        {
+            return false;
+        }
+        int numNeighbours = gridNeighbours(&(graph->grid), cells[i], neighbours);
+        for(int n = 0; n < numNeighbours; n++)
+        {
+            if(!updateCell(replan, neighbours[n]))
+            {
+                return false;
+            }
+        }
+    }
+    graph->openCells = graph->maze->openCells;
+    return true;
+}
+
+bool replanMaze(REPLAN* replan, MAZE* edited, uint32_t* changed)
+{
+    *changed = 0;
+    if(replan == NULL || edited == NULL)
+    {
+        return false;
+    }
+    uint32_t count = 0;
+    uint32_t* cells = mazeChanges(replan->graph->maze, edited, &count);
+    bool* open = malloc(sizeof(bool) * (count + 1));
+    if(cells == NULL || open == NULL)
+    {
+        free(cells);
+        free(open);
+        return false;
+    }
+    for(uint32_t i = 0; i < count; i++)
+    {
+        open[i] = mazeCellIsOpen(edited, cells[i]);
+    }
+    bool success = replanCells(replan, cells, open, count);
+    *changed = count;
+    free(cells);
+    free(open);
+    return success;
+}
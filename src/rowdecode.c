@@ -0,0 +1,308 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "rowdecode.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define ROWDECODE_X86
+#include <immintrin.h>
+#endif
+
+/* SCALAR KERNELS */
+
+// Pixels packed below a byte, most significant bits first, starting at pixel firstX
+static void decodePackedScalar(const uint8_t* row, uint32_t* values, int firstX, int width, int bitDepth)
+{
+    uint8_t valueMask = (1 << bitDepth) - 1;
+    int pixelsPerByte = 8 / bitDepth;
+    for(int x = firstX; x < width; x++)
+    {
+        int shift = 8 - bitDepth - ((x % pixelsPerByte) * bitDepth);
+        values[x] = (row[x / pixelsPerByte] >> shift) & valueMask;
+    }
+}
+
+static void decode1Scalar(const uint8_t* row, uint32_t* values, int width)
+{
+    decodePackedScalar(row, values, 0, width, 1);
+}
+
+static void decode2Scalar(const uint8_t* row, uint32_t* values, int width)
+{
+    decodePackedScalar(row, values, 0, width, 2);
+}
+
+static void decode4Scalar(const uint8_t* row, uint32_t* values, int width)
+{
+    decodePackedScalar(row, values, 0, width, 4);
+}
+
+static void decode8Scalar(const uint8_t* row, uint32_t* values, int width)
+{
+    for(int x = 0; x < width; x++)
+    {
+        values[x] = row[x];
+    }
+}
+
+static void decode16Scalar(const uint8_t* row, uint32_t* values, int width)
+{
+    for(int x = 0; x < width; x++)
+    {
+        values[x] = expand555(row[2 * x] | ((uint32_t)row[(2 * x) + 1] << 8));
+    }
+}
+
+// Bytes are stored BGR, which is 0xRRGGBB read as little endian
+static void decode24Scalar(const uint8_t* row, uint32_t* values, int width)
+{
+    for(int x = 0; x < width; x++)
+    {
+        const uint8_t* pixel = row + (3 * x);
+        values[x] = pixel[0] | ((uint32_t)pixel[1] << 8) | ((uint32_t)pixel[2] << 16);
+    }
+}
+
+// 32 bpp rows are already little endian uint32_t values
+static void decode32Scalar(const uint8_t* row, uint32_t* values, int width)
+{
+    memcpy(values, row, sizeof(uint32_t) * width);
+}
+
+#ifdef ROWDECODE_X86
+
+/* SSE2 / SSSE3 KERNELS */
+
+__attribute__((target("sse2")))
+static void decode1SSE2(const uint8_t* row, uint32_t* values, int width)
+{
+    // One mask per output lane, lane 0 takes the most significant bit
+    const __m128i bitsLow = _mm_set_epi32(0x10, 0x20, 0x40, 0x80);
+    const __m128i bitsHigh = _mm_set_epi32(0x01, 0x02, 0x04, 0x08);
+    const __m128i one = _mm_set1_epi32(1);
+
+    int x = 0;
+    for(; x + 8 <= width; x += 8)
+    {
+        __m128i packed = _mm_set1_epi32(row[x / 8]);
+        __m128i low = _mm_cmpeq_epi32(_mm_and_si128(packed, bitsLow), bitsLow);
+        __m128i high = _mm_cmpeq_epi32(_mm_and_si128(packed, bitsHigh), bitsHigh);
+        _mm_storeu_si128((__m128i*)(values + x), _mm_and_si128(low, one));
+        _mm_storeu_si128((__m128i*)(values + x + 4), _mm_and_si128(high, one));
+    }
+    decodePackedScalar(row, values, x, width, 1);
+}
+
+__attribute__((target("sse2")))
+static void decode4SSE2(const uint8_t* row, uint32_t* values, int width)
+{
+    const __m128i nibbleMask = _mm_set1_epi8(0x0F);
+    const __m128i zero = _mm_setzero_si128();
+
+    int x = 0;
+    for(; x + 16 <= width; x += 16)
+    {
+        // 8 bytes hold 16 pixels, the high nibble comes first
+        __m128i packed = _mm_loadl_epi64((const __m128i*)(row + (x / 2)));
+        __m128i high = _mm_and_si128(_mm_srli_epi16(packed, 4), nibbleMask);
+        __m128i low = _mm_and_si128(packed, nibbleMask);
+        __m128i pixels = _mm_unpacklo_epi8(high, low);
+
+        __m128i words0 = _mm_unpacklo_epi8(pixels, zero);
+        __m128i words1 = _mm_unpackhi_epi8(pixels, zero);
+        _mm_storeu_si128((__m128i*)(values + x), _mm_unpacklo_epi16(words0, zero));
+        _mm_storeu_si128((__m128i*)(values + x + 4), _mm_unpackhi_epi16(words0, zero));
+        _mm_storeu_si128((__m128i*)(values + x + 8), _mm_unpacklo_epi16(words1, zero));
+        _mm_storeu_si128((__m128i*)(values + x + 12), _mm_unpackhi_epi16(words1, zero));
+    }
+    decodePackedScalar(row, values, x, width, 4);
+}
+
+__attribute__((target("sse2")))
+static void decode8SSE2(const uint8_t* row, uint32_t* values, int width)
+{
+    const __m128i zero = _mm_setzero_si128();
+
+    int x = 0;
+    for(; x + 16 <= width; x += 16)
+    {
+        __m128i pixels = _mm_loadu_si128((const __m128i*)(row + x));
+        __m128i words0 = _mm_unpacklo_epi8(pixels, zero);
+        __m128i words1 = _mm_unpackhi_epi8(pixels, zero);
+        _mm_storeu_si128((__m128i*)(values + x), _mm_unpacklo_epi16(words0, zero));
+        _mm_storeu_si128((__m128i*)(values + x + 4), _mm_unpackhi_epi16(words0, zero));
+        _mm_storeu_si128((__m128i*)(values + x + 8), _mm_unpacklo_epi16(words1, zero));
+        _mm_storeu_si128((__m128i*)(values + x + 12), _mm_unpackhi_epi16(words1, zero));
+    }
+    for(; x < width; x++)
+    {
+        values[x] = row[x];
+    }
+}
+
+// SSE2 has no byte shuffle, so 24 bpp needs SSSE3
+__attribute__((target("ssse3")))
+static void decode24SSSE3(const uint8_t* row, uint32_t* values, int width)
+{
+    // Spreads 4 BGR pixels out to 4 zero topped uint32_t
+    const __m128i spread = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+
+    // Every load reads 16 bytes for 12 bytes of pixels, so stop early enough to stay inside the row
+    int x = 0;
+    for(; x + 6 <= width; x += 4)
+    {
+        __m128i pixels = _mm_loadu_si128((const __m128i*)(row + (3 * x)));
+        _mm_storeu_si128((__m128i*)(values + x), _mm_shuffle_epi8(pixels, spread));
+    }
+    for(; x < width; x++)
+    {
+        const uint8_t* pixel = row + (3 * x);
+        values[x] = pixel[0] | ((uint32_t)pixel[1] << 8) | ((uint32_t)pixel[2] << 16);
+    }
+}
+
+/* AVX2 KERNELS */
+
+__attribute__((target("avx2")))
+static void decode1AVX2(const uint8_t* row, uint32_t* values, int width)
+{
+    const __m256i bits = _mm256_set_epi32(0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80);
+    const __m256i one = _mm256_set1_epi32(1);
+
+    int x = 0;
+    for(; x + 8 <= width; x += 8)
+    {
+        __m256i packed = _mm256_set1_epi32(row[x / 8]);
+        __m256i set = _mm256_cmpeq_epi32(_mm256_and_si256(packed, bits), bits);
+        _mm256_storeu_si256((__m256i*)(values + x), _mm256_and_si256(set, one));
+    }
+    decodePackedScalar(row, values, x, width, 1);
+}
+
+__attribute__((target("avx2")))
+static void decode4AVX2(const uint8_t* row, uint32_t* values, int width)
+{
+    const __m128i nibbleMask = _mm_set1_epi8(0x0F);
+
+    int x = 0;
+    for(; x + 16 <= width; x += 16)
+    {
+        __m128i packed = _mm_loadl_epi64((const __m128i*)(row + (x / 2)));
+        __m128i high = _mm_and_si128(_mm_srli_epi16(packed, 4), nibbleMask);
+        __m128i low = _mm_and_si128(packed, nibbleMask);
+        __m128i pixels = _mm_unpacklo_epi8(high, low);
+
+        _mm256_storeu_si256((__m256i*)(values + x), _mm256_cvtepu8_epi32(pixels));
+        _mm256_storeu_si256((__m256i*)(values + x + 8), _mm256_cvtepu8_epi32(_mm_srli_si128(pixels, 8)));
+    }
+    decodePackedScalar(row, values, x, width, 4);
+}
+
+__attribute__((target("avx2")))
+static void decode8AVX2(const uint8_t* row, uint32_t* values, int width)
+{
+    int x = 0;
+    for(; x + 16 <= width; x += 16)
+    {
+        __m128i pixels = _mm_loadu_si128((const __m128i*)(row + x));
+        _mm256_storeu_si256((__m256i*)(values + x), _mm256_cvtepu8_epi32(pixels));
+        _mm256_storeu_si256((__m256i*)(values + x + 8), _mm256_cvtepu8_epi32(_mm_srli_si128(pixels, 8)));
+    }
+    for(; x < width; x++)
+    {
+        values[x] = row[x];
+    }
+}
+
+__attribute__((target("avx2")))
+static void decode24AVX2(const uint8_t* row, uint32_t* values, int width)
+{
+    // The shuffle works per 128 bit lane, so each lane gets its own 4 pixels
+    const __m256i spread = _mm256_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,
+                                            0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+
+    // The second load reads 4 bytes past the 8th pixel, so stop early enough to stay inside the row
+    int x = 0;
+    for(; x + 10 <= width; x += 8)
+    {
+        __m128i low = _mm_loadu_si128((const __m128i*)(row + (3 * x)));
+        __m128i high = _mm_loadu_si128((const __m128i*)(row + (3 * x) + 12));
+        __m256i pixels = _mm256_inserti128_si256(_mm256_castsi128_si256(low), high, 1);
+        _mm256_storeu_si256((__m256i*)(values + x), _mm256_shuffle_epi8(pixels, spread));
+    }
+    for(; x < width; x++)
+    {
+        const uint8_t* pixel = row + (3 * x);
+        values[x] = pixel[0] | ((uint32_t)pixel[1] << 8) | ((uint32_t)pixel[2] << 16);
+    }
+}
+
+#endif
+
+ROW_DECODER scalarRowDecoder(int bitDepth)
+{
+    switch(bitDepth)
+    {
+        case 1: return decode1Scalar;
+        case 2: return decode2Scalar;
+        case 4: return decode4Scalar;
+        case 8: return decode8Scalar;
+        case 16: return decode16Scalar;
+        case 24: return decode24Scalar;
+        case 32: return decode32Scalar;
+        default: return NULL;
+    }
+}
+
+ROW_DECODER rowDecoder(int bitDepth)
+{
+#ifdef ROWDECODE_X86
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2"))
+    {
+        switch(bitDepth)
+        {
+            case 1: return decode1AVX2;
+            case 4: return decode4AVX2;
+            case 8: return decode8AVX2;
+            case 24: return decode24AVX2;
+            default: break;
+        }
+    }
+    else if(__builtin_cpu_supports("sse2"))
+    {
+        switch(bitDepth)
+        {
+            case 1: return decode1SSE2;
+            case 4: return decode4SSE2;
+            case 8: return decode8SSE2;
+            case 24:
+                if(__builtin_cpu_supports("ssse3"))
+                {
+                    return decode24SSSE3;
+                }
+                break;
+            default: break;
+        }
+    }
+#endif
+
+    // 2 and 16 bpp are rare, and 32 bpp is a plain copy already
+    return scalarRowDecoder(bitDepth);
+}
+
+const char* rowDecoderLevel()
+{
+#ifdef ROWDECODE_X86
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2"))
+    {
+        return "avx2";
+    }
+    if(__builtin_cpu_supports("sse2"))
+    {
+        return "sse2";
+    }
+#endif
+    return "scalar";
+}
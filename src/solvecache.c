@@ -0,0 +1,414 @@
+// Needed for pthread_rwlock_t under -std=c99
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <pthread.h>
+#include "solvecache.h"
+#include "algos.h"
+#include "arena.h"
+
+/* PATH ENCODING */
+
+// Longest a uint64_t varint can get, 7 bits per byte
+#define maxVarintBytes 10
+
+static size_t putVarint(uint8_t* dst, uint64_t value)
+{
+    size_t count = 0;
+    while(value >= 0x80)
+    {
+        dst[count++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    dst[count++] = (uint8_t)value;
+    return count;
+}
+
+// Reads a varint at *at, false if it runs past end
+static bool getVarint(const uint8_t* runs, size_t bytes, size_t* at, uint64_t* value)
+{
+    *value = 0;
+    for(int shift = 0; *at < bytes && shift < 64; shift += 7)
+    {
+        uint8_t byte = runs[(*at)++];
+        *value |= (uint64_t)(byte & 0x7F) << shift;
+        if((byte & 0x80) == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+uint8_t* encodePath(PATH* path, int width, size_t* bytes, uint32_t* cells)
+{
+    *bytes = 0;
+    *cells = 0;
+    if(path == NULL || path->cells == NULL || path->length == 0 || width <= 0)
+    {
+        return NULL;
+    }
+
+    // Every move is at most one run, so this is always enough
+    uint8_t* toReturn = malloc(maxVarintBytes * (size_t)path->length);
+    if(toReturn == NULL)
+    {
+        return NULL;
+    }
+    size_t used = putVarint(toReturn, path->cells[0]);
+    uint32_t runs = 0;
+    int runDirection = -1;
+    uint64_t runLength = 0;
+    for(uint32_t i = 0; i + 1 < path->length; i++)
+    {
+        uint32_t current = path->cells[i];
+        uint32_t next = path->cells[i + 1];
+        int direction = 0;
+        uint64_t length = 0;
+        if(next / width == current / width)
+        {
+            direction = (next > current) ? pathRight : pathLeft;
+            length = (next > current) ? next - current : current - next;
+        }
+        else
+        {
+            // Up is towards the top of the image, which is the next row
+            direction = (next > current) ? pathUp : pathDown;
+            length = ((next > current) ? next - current : current - next) / width;
+        }
+        if(length == 0)
+        {
+            continue;
+        }
+
+        // Moves in the same direction are one run
+        if(direction != runDirection && runLength > 0)
+        {
+            used += putVarint(toReturn + used, (runLength << 2) | runDirection);
+            runs++;
+            runLength = 0;
+        }
+        runDirection = direction;
+        runLength += length;
+    }
+    if(runLength > 0)
+    {
+        used += putVarint(toReturn + used, (runLength << 2) | runDirection);
+        runs++;
+    }
+
+    uint8_t* shrunk = realloc(toReturn, used);
+    toReturn = (shrunk != NULL) ? shrunk : toReturn;
+    *bytes = used;
+    *cells = runs + 1;
+    return toReturn;
+}
+
+bool decodePath(const uint8_t* runs, size_t bytes, uint32_t cells, int width, PATH* path, ARENA* arena)
+{
+    if(runs == NULL || cells == 0 || path == NULL)
+    {
+        return false;
+    }
+    path->arena = arena;
+    path->cells = allocIn(arena, sizeof(uint32_t) * cells);
+    if(path->cells == NULL)
+    {
+        return false;
+    }
+
+    const int64_t steps[4] = {width, -(int64_t)width, -1, 1};
+    size_t at = 0;
+    uint64_t value = 0;
+    bool valid = getVarint(runs, bytes, &at, &value);
+    int64_t cell = value;
+    path->cells[0] = cell;
+    for(uint32_t i = 1; valid && i < cells; i++)
+    {
+        valid = getVarint(runs, bytes, &at, &value);
+        cell += steps[value & 3] * (int64_t)(value >> 2);
+        path->cells[i] = cell;
+    }
+    if(!valid || at != bytes)
+    {
+        freePath(path);
+        return false;
+    }
+    path->length = cells;
+    return true;
+}
+
+/* CACHE */
+
+typedef struct SOLVE_ENTRY_STRUCT {
+    SOLVE_KEY key;
+    bool used;
+
+    // Cache clock the last time the entry was stored or found (read and written atomically)
+    uint64_t lastUsed;
+
+    // Width of the maze, which the up and down runs step by
+    int width;
+
+    // Cost of the path and the number of cells it decodes to
+    uint32_t cost;
+    uint32_t cells;
+
+    // Encoded path (see encodePath)
+    uint8_t* runs;
+    size_t runBytes;
+
+    // Next entry in the same hash bucket (noCell = none)
+    uint32_t next;
+} SOLVE_ENTRY;
+
+struct SOLVE_CACHE_STRUCT {
+    // Most entries, and most encoded path bytes, held at once
+    uint32_t capacity;
+    size_t maxBytes;
+
+    uint32_t count;
+    size_t bytes;
+    SOLVE_ENTRY* entries;
+
+    // First entry of every bucket (noCell = empty), bucketMask + 1 is a power of 2
+    uint32_t* buckets;
+    uint32_t bucketMask;
+
+    // Read for lookups, write for stores
+    pthread_rwlock_t lock;
+
+    // Ticks once per lookup hit or store, and the counters (all updated atomically)
+    uint64_t clock;
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t stores;
+    uint64_t evictions;
+};
+
+static uint32_t keyBucket(SOLVE_CACHE* cache, SOLVE_KEY* key)
+{
+    // Mixed down with the splitmix64 finalizer, the low bits pick the bucket
+    uint64_t hash = key->payload ^ (key->settings * 0x9E3779B97F4A7C15ULL)
+        ^ (((uint64_t)key->startCell << 32) | key->endCell);
+    hash = (hash ^ (hash >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    hash = (hash ^ (hash >> 27)) * 0x94D049BB133111EBULL;
+    hash ^= hash >> 31;
+    return (uint32_t)hash & cache->bucketMask;
+}
+
+static bool sameKey(SOLVE_KEY* a, SOLVE_KEY* b)
+{
+    return a->payload == b->payload && a->settings == b->settings
+        && a->startCell == b->startCell && a->endCell == b->endCell;
+}
+
+// Entry for a key (noCell if there is none), under either lock
+static uint32_t findEntry(SOLVE_CACHE* cache, SOLVE_KEY* key)
+{
+    uint32_t index = cache->buckets[keyBucket(cache, key)];
+    while(index != noCell && !sameKey(&(cache->entries[index].key), key))
+    {
+        index = cache->entries[index].next;
+    }
+    return index;
+}
+
+// Marks an entry as just used, only needs the read lock
+static void touchEntry(SOLVE_CACHE* cache, SOLVE_ENTRY* entry)
+{
+    uint64_t now = __atomic_add_fetch(&(cache->clock), 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&(entry->lastUsed), now, __ATOMIC_RELAXED);
+}
+
+// Drops the least recently used entry, under the write lock
+static void evictOldest(SOLVE_CACHE* cache)
+{
+    uint32_t oldest = noCell;
+    for(uint32_t i = 0; i < cache->capacity; i++)
+    {
+        SOLVE_ENTRY* entry = &(cache->entries[i]);
+        if(entry->used && (oldest == noCell || entry->lastUsed < cache->entries[oldest].lastUsed))
+        {
+            oldest = i;
+        }
+    }
+    if(oldest == noCell)
+    {
+        return;
+    }
+
+    SOLVE_ENTRY* entry = &(cache->entries[oldest]);
+    uint32_t* link = &(cache->buckets[keyBucket(cache, &(entry->key))]);
+    while(*link != oldest)
+    {
+        link = &(cache->entries[*link].next);
+    }
+    *link = entry->next;
+
+    free(entry->runs);
+    cache->bytes -= entry->runBytes;
+    cache->count--;
+    memset(entry, 0, sizeof(SOLVE_ENTRY));
+    __atomic_add_fetch(&(cache->evictions), 1, __ATOMIC_RELAXED);
+}
+
+SOLVE_CACHE* newSolveCache(uint32_t capacity, size_t maxBytes)
+{
+    capacity = (capacity < 1) ? 1 : capacity;
+    SOLVE_CACHE* toReturn = calloc(1, sizeof(SOLVE_CACHE));
+    if(toReturn == NULL)
+    {
+        return NULL;
+    }
+
+    // At least twice as many buckets as entries keeps the chains short
+    uint32_t numBuckets = 1;
+    while(numBuckets < 2 * capacity && numBuckets < (UINT32_MAX / 2) + 1)
+    {
+        numBuckets *= 2;
+    }
+    toReturn->capacity = capacity;
+    toReturn->maxBytes = maxBytes;
+    toReturn->bucketMask = numBuckets - 1;
+    toReturn->entries = calloc(capacity, sizeof(SOLVE_ENTRY));
+    toReturn->buckets = malloc(sizeof(uint32_t) * numBuckets);
+    if(toReturn->entries == NULL || toReturn->buckets == NULL || pthread_rwlock_init(&(toReturn->lock), NULL) != 0)
+    {
+        free(toReturn->entries);
+        free(toReturn->buckets);
+        free(toReturn);
+        return NULL;
+    }
+    for(uint32_t i = 0; i < numBuckets; i++)
+    {
+        toReturn->buckets[i] = noCell;
+    }
+    return toReturn;
+}
+
+void freeSolveCache(SOLVE_CACHE** toFree)
+{
+    SOLVE_CACHE* temp = (*toFree);
+    if(temp == NULL)
+    {
+        return;
+    }
+    for(uint32_t i = 0; i < temp->capacity; i++)
+    {
+        free(temp->entries[i].runs);
+    }
+    pthread_rwlock_destroy(&(temp->lock));
+    free(temp->entries);
+    free(temp->buckets);
+    free(temp);
+    (*toFree) = NULL;
+}
+
+bool solveCacheFind(SOLVE_CACHE* cache, SOLVE_KEY* key, PATH* path, ARENA* arena)
+{
+    if(cache == NULL || key == NULL || path == NULL)
+    {
+        return false;
+    }
+
+    pthread_rwlock_rdlock(&(cache->lock));
+    uint32_t index = findEntry(cache, key);
+    bool hit = false;
+    if(index != noCell)
+    {
+        SOLVE_ENTRY* entry = &(cache->entries[index]);
+        hit = decodePath(entry->runs, entry->runBytes, entry->cells, entry->width, path, arena);
+        if(hit)
+        {
+            path->cost = entry->cost;
+            touchEntry(cache, entry);
+        }
+    }
+    pthread_rwlock_unlock(&(cache->lock));
+
+    __atomic_add_fetch(hit ? &(cache->hits) : &(cache->misses), 1, __ATOMIC_RELAXED);
+    return hit;
+}
+
+bool solveCacheStore(SOLVE_CACHE* cache, SOLVE_KEY* key, PATH* path, int width)
+{
+    if(cache == NULL || key == NULL || path == NULL)
+    {
+        return false;
+    }
+
+    // Encoded before taking the lock, so lookups only wait for the table update
+    size_t bytes = 0;
+    uint32_t cells = 0;
+    uint8_t* runs = encodePath(path, width, &bytes, &cells);
+    if(runs == NULL || bytes > cache->maxBytes)
+    {
+        free(runs);
+        return false;
+    }
+
+    pthread_rwlock_wrlock(&(cache->lock));
+
+    // Another thread can have solved the same maze since this one missed
+    uint32_t index = findEntry(cache, key);
+    if(index != noCell)
+    {
+        touchEntry(cache, &(cache->entries[index]));
+        pthread_rwlock_unlock(&(cache->lock));
+        free(runs);
+        return true;
+    }
+
+    while(cache->count > 0 && (cache->count >= cache->capacity || cache->bytes + bytes > cache->maxBytes))
+    {
+        evictOldest(cache);
+    }
+    index = 0;
+    while(cache->entries[index].used)
+    {
+        index++;
+    }
+
+    SOLVE_ENTRY* entry = &(cache->entries[index]);
+    entry->key = *key;
+    entry->used = true;
+    entry->width = width;
+    entry->cost = path->cost;
+    entry->cells = cells;
+    entry->runs = runs;
+    entry->runBytes = bytes;
+    touchEntry(cache, entry);
+
+    uint32_t bucket = keyBucket(cache, key);
+    entry->next = cache->buckets[bucket];
+    cache->buckets[bucket] = index;
+    cache->count++;
+    cache->bytes += bytes;
+    __atomic_add_fetch(&(cache->stores), 1, __ATOMIC_RELAXED);
+
+    pthread_rwlock_unlock(&(cache->lock));
+    return true;
+}
+
+SOLVE_CACHE_COUNTS solveCacheCounts(SOLVE_CACHE* cache)
+{
+    SOLVE_CACHE_COUNTS toReturn = {0};
+    if(cache == NULL)
+    {
+        return toReturn;
+    }
+    toReturn.hits = __atomic_load_n(&(cache->hits), __ATOMIC_RELAXED);
+    toReturn.misses = __atomic_load_n(&(cache->misses), __ATOMIC_RELAXED);
+    toReturn.stores = __atomic_load_n(&(cache->stores), __ATOMIC_RELAXED);
+    toReturn.evictions = __atomic_load_n(&(cache->evictions), __ATOMIC_RELAXED);
+
+    pthread_rwlock_rdlock(&(cache->lock));
+    toReturn.entries = cache->count;
+    toReturn.bytes = cache->bytes;
+    pthread_rwlock_unlock(&(cache->lock));
+    return toReturn;
+}
@@ -1,25 +1,341 @@
+// Needed for sysconf under -std=c99
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
 #include <string.h>
+#include <unistd.h>
 #include "bmp.h"
+#include "algos.h"
+#include "batch.h"
+#include "hpa.h"
+#include "costmap.h"
+#include "solvecache.h"
 
-int main()
+int main(int argc, char* argv[])
 {
+    SOLVE_OPTIONS options;
+
+    // Graph backend, can be changed with -full, -grid, -corridor or -csr
+    options.mode = GRAPH_GRID;
+
+    // Search, can be changed with -bidir (both sides on one thread), -bidir-threads or -jps
+    options.search = SEARCH_ASTAR;
+
+    // Number of times the search is run, the time printed is the average
+    options.repeat = 1;
+
+    // Write the output through a shared mapping instead of buffered fwrite
+    options.mapWrite = false;
+
+    // Read and write the maze a window of rows at a time instead of mapping and decoding all of it
+    options.stream = false;
+
+    // Load the built graph from "<maze>.graph" when it is up to date, can be turned on with -cache
+    options.graphCache = false;
+
+    // Number of ALT landmarks, 0 = Manhattan distance only
+    options.landmarks = 0;
+
+    // Cluster size for -hpa, can be changed with -cluster N
+    options.clusterSize = hpaDefaultCluster;
+
+    // Stage times and counters at the end, -stats prints them and -stats-json file writes them as JSON
+    options.stats = false;
+    options.statsJSON = NULL;
+
+    // Black and white walls, -weights threshold maxCost makes shades of grey cost from 1 to maxCost
+    // and everything at least threshold dark (0 - 255) a wall
+    COST_TABLE costTable;
+    options.costTable = NULL;
+
+    // Keeps up to this many solved paths, so a maze that comes up again in a batch is not solved twice
+    // (0 = off, can be changed with -solve-cache N)
+    uint32_t solveCacheSize = 0;
+
+    // Batch mode solves every maze listed on stdin (or in a manifest) on a pool of threads,
+    // writing "<name>_solved.bmp" next to each maze or into outDir
+    bool batch = false;
+    char* manifest = NULL;
+    char* outDir = NULL;
+    int numThreads = sysconf(_SC_NPROCESSORS_ONLN);
+
+    // Number of random start / end questions to ask about the maze instead of solving it once
+    int queries = 0;
+
+    // Edited copy of the maze to replan the path for after solving the original
+    char* editedName = NULL;
+
+    // Number of random points to measure the distances between instead, and where to save the matrix
+    int distancePoints = 0;
+    char* matrixName = NULL;
+    for(int i = 1; i < argc; i++)
+    {
+        if(strcmp(argv[i], "-full") == 0)
+        {
+            options.mode = GRAPH_FULL;
+        }
+        else if(strcmp(argv[i], "-grid") == 0)
+        {
+            options.mode = GRAPH_GRID;
+        }
+        else if(strcmp(argv[i], "-corridor") == 0)
+        {
+            options.mode = GRAPH_CORRIDOR;
+        }
+        else if(strcmp(argv[i], "-csr") == 0)
+        {
+            options.mode = GRAPH_CSR;
+        }
+        else if(strcmp(argv[i], "-bidir") == 0)
+        {
+            options.search = SEARCH_BIDIR;
+        }
+        else if(strcmp(argv[i], "-bidir-threads") == 0)
+        {
+            options.search = SEARCH_BIDIR_THREADED;
+        }
+        else if(strcmp(argv[i], "-jps") == 0)
+        {
+            options.search = SEARCH_JPS;
+        }
+        else if(strcmp(argv[i], "-hpa") == 0)
+        {
+            options.search = SEARCH_HPA;
+        }
+        else if(strcmp(argv[i], "-cluster") == 0 && i + 1 < argc && atoi(argv[i + 1]) > 1)
+        {
+            options.clusterSize = atoi(argv[i + 1]);
+            i++;
+        }
+        else if(strcmp(argv[i], "-mapwrite") == 0)
+        {
+            options.mapWrite = true;
+        }
+        else if(strcmp(argv[i], "-stream") == 0)
+        {
+            options.stream = true;
+        }
+        else if(strcmp(argv[i], "-cache") == 0)
+        {
+            options.graphCache = true;
+        }
+        else if(strcmp(argv[i], "-stats") == 0)
+        {
+            options.stats = true;
+        }
+        else if(strcmp(argv[i], "-stats-json") == 0 && i + 1 < argc)
+        {
+            options.stats = true;
+            options.statsJSON = argv[i + 1];
+            i++;
+        }
+        else if(strcmp(argv[i], "-weights") == 0 && i + 2 < argc && atoi(argv[i + 1]) > 0 && atoi(argv[i + 2]) > 0)
+        {
+            costRamp(&costTable, atoi(argv[i + 1]), atoi(argv[i + 2]));
+            options.costTable = &costTable;
+            i += 2;
+        }
+        else if(strcmp(argv[i], "-solve-cache") == 0 && i + 1 < argc && atoi(argv[i + 1]) > 0)
+        {
+            solveCacheSize = atoi(argv[i + 1]);
+            i++;
+        }
+        else if(strcmp(argv[i], "-repeat") == 0 && i + 1 < argc && atoi(argv[i + 1]) > 0)
+        {
+            options.repeat = atoi(argv[i + 1]);
+            i++;
+        }
+        else if(strcmp(argv[i], "-batch") == 0)
+        {
+            batch = true;
+        }
+        else if(strcmp(argv[i], "-manifest") == 0 && i + 1 < argc)
+        {
+            batch = true;
+            manifest = argv[i + 1];
+            i++;
+        }
+        else if(strcmp(argv[i], "-threads") == 0 && i + 1 < argc && atoi(argv[i + 1]) > 0)
+        {
+            numThreads = atoi(argv[i + 1]);
+            i++;
+        }
+        else if(strcmp(argv[i], "-landmarks") == 0 && i + 1 < argc && atoi(argv[i + 1]) > 0)
+        {
+            options.landmarks = atoi(argv[i + 1]);
+            i++;
+        }
+        else if(strcmp(argv[i], "-queries") == 0 && i + 1 < argc && atoi(argv[i + 1]) > 0)
+        {
+            queries = atoi(argv[i + 1]);
+            i++;
+        }
+        else if(strcmp(argv[i], "-replan") == 0 && i + 1 < argc)
+        {
+            editedName = argv[i + 1];
+            i++;
+        }
+        else if(strcmp(argv[i], "-distances") == 0 && i + 1 < argc && atoi(argv[i + 1]) > 0)
+        {
+            distancePoints = atoi(argv[i + 1]);
+            i++;
+        }
+        else if(strcmp(argv[i], "-matrix") == 0 && i + 1 < argc)
+        {
+            matrixName = argv[i + 1];
+            i++;
+        }
+        else if(strcmp(argv[i], "-outdir") == 0 && i + 1 < argc)
+        {
+            outDir = argv[i + 1];
+            i++;
+        }
+        else
+        {
+            printf("Usage: %s [-full | -grid | -corridor | -csr] [-bidir | -bidir-threads | -jps | -hpa [-cluster N]]\n", argv[0]);
+            printf("       %*s [-landmarks K] [-repeat N] [-mapwrite | -stream] [-cache] [-threads N]\n", (int)strlen(argv[0]), "");
+            printf("       %*s [-weights threshold maxCost] [-stats | -stats-json file] < mazeFile\n", (int)strlen(argv[0]), "");
+            printf("       %s -batch [-threads N] [-outdir dir] [-solve-cache N] [options] < mazeList\n", argv[0]);
+            printf("       %s -manifest mazeList [-threads N] [-outdir dir] [-solve-cache N] [options]\n", argv[0]);
+            printf("       %s -queries N [-full | -grid | -corridor | -csr] [-landmarks K | -hpa [-cluster N]] < mazeFile\n", argv[0]);
+            printf("       %s -replan edited.bmp [-threads N] < mazeFile\n", argv[0]);
+            printf("       %s -distances N [-full | -grid | -corridor | -csr] [-threads N] [-matrix file] < mazeFile\n", argv[0]);
+            return 1;
+        }
+    }
+
+    // Jump point search runs on the pixel grid, and HPA* only needs the wall bitset which the grid adds nothing to
+    if(options.search == SEARCH_JPS || options.search == SEARCH_HPA)
+    {
+        options.mode = GRAPH_GRID;
+    }
+
+    // Batch mode already keeps every thread busy with a maze of its own
+    options.buildThreads = batch ? 1 : numThreads;
+
+    // Only a batch can ask for the same maze twice
+    options.solveCache = NULL;
+
+    if(batch)
+    {
+        // One maze path per line, from the manifest or from stdin
+        FILE* list = stdin;
+        if(manifest != NULL)
+        {
+            list = fopen(manifest, "r");
+            if(list == NULL)
+            {
+                errMsg("main", "Could not open manifest file!");
+                return 1;
+            }
+        }
+        int count = 0;
+        char** names = readPathList(list, &count);
+        if(list != stdin)
+        {
+            fclose(list);
+        }
+        if(names == NULL || count == 0)
+        {
+            errMsg("main", "No maze files to solve!");
+            freePathList(&names, count);
+            return 1;
+        }
+
+        options.solveCache = (solveCacheSize > 0) ? newSolveCache(solveCacheSize, solveCacheDefaultBytes) : NULL;
+        bool allSolved = runBatch(names, count, &options, numThreads, outDir);
+        freeSolveCache(&(options.solveCache));
+        freePathList(&names, count);
+        return allSolved ? 0 : 1;
+    }
+
     char* buffer = malloc(longestFileName * sizeof(char));
     buffer = fgets(buffer, longestFileName, stdin);
-    
+
     int inputSize = strlen(buffer);
 
     char* name = malloc(inputSize * sizeof(char));
-    
+
     for (int i = 0; i < inputSize; i++ )
     {
         name[i] = buffer[i];
     }
     name[inputSize - 1] = 0;
-    BMP* testBMP = readBMP(name);
-    writeBMP(testBMP,"test.bmp");
-    freeBMP(&testBMP);
+
+    if(editedName != NULL)
+    {
+        return runReplan(name, editedName, &options, "test.bmp") ? 0 : 1;
+    }
+    if(distancePoints > 0)
+    {
+        return runDistances(name, &options, distancePoints, numThreads, 12345, matrixName) ? 0 : 1;
+    }
+    if(queries > 0)
+    {
+        return runQueries(name, &options, queries, 12345) ? 0 : 1;
+    }
+
+    SOLVE_RESULT result;
+    ARENA* arena = newArena(1 << 20);
+    solveMazeFile(name, "test.bmp", &options, &result, arena);
+    freeArena(&arena);
+    if(!result.loaded)
+    {
+        errMsg("main", "Could not read maze file!");
+        return 1;
+    }
+    printf("Load time: %.3f ms\n", result.loadMs);
+    if(result.cacheLoaded)
+    {
+        printf("Graph build: %.3f ms (loaded from cache)\n", result.buildMs);
+    }
+    else
+    {
+        printf("Graph build: %.3f ms on %d thread%s\n", result.buildMs, options.buildThreads,
+            (options.buildThreads == 1) ? "" : "s");
+    }
+
+    if(result.graphNodes > 0)
+    {
+        printf("Open cells: %u, graph nodes: %u (%.1fx compression), wall bitset: %lu bytes\n",
+            result.openCells, result.graphNodes, (double)result.openCells / result.graphNodes,
+            (unsigned long)result.mazeBytes);
+        if(result.landmarkBytes > 0)
+        {
+            printf("Landmarks: %u, tables: %.1f KB, %s in %.3f ms\n", options.landmarks,
+                result.landmarkBytes / 1024.0, result.landmarksLoaded ? "loaded" : "built", result.landmarkMs);
+        }
+        if(result.hpaBytes > 0)
+        {
+            printf("Abstract nodes: %u, tables: %.1f KB, built in %.3f ms on %d thread%s\n",
+                result.hpaNodes, result.hpaBytes / 1024.0, result.hpaMs, options.buildThreads,
+                (options.buildThreads == 1) ? "" : "s");
+        }
+        if(result.solved)
+        {
+            printf("Path length: %u, nodes expanded: %llu, search time: %.3f ms (%s)\n",
+                result.pathCost, (unsigned long long)result.expanded, result.searchMs, queueBackend);
+            // JPS and HPA* only search one way
+            if(options.search == SEARCH_BIDIR || options.search == SEARCH_BIDIR_THREADED)
+            {
+                printf("Expanded forward: %llu, backward: %llu\n",
+                    (unsigned long long)result.forwardExpanded, (unsigned long long)result.backwardExpanded);
+            }
+        }
+        else
+        {
+            printf("No path found\n");
+        }
+    }
+    if(result.written)
+    {
+        printf("Write time: %.3f ms\n", result.writeMs);
+    }
+    if(options.stats)
+    {
+        reportStats(&result, 1, options.repeat, options.statsJSON);
+    }
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,36 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include "stats.h"
+
+SOLVER_STATS solverStats;
+
+void raiseCounter(uint64_t* counter, uint64_t value)
+{
+    uint64_t current = __atomic_load_n(counter, __ATOMIC_RELAXED);
+    while(value > current && !__atomic_compare_exchange_n(counter, &current, value, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+    {
+        // current now holds what another thread put there, try again if it is still lower
+    }
+}
+
+SOLVER_STATS readStats()
+{
+    SOLVER_STATS toReturn;
+    toReturn.queuePushes = __atomic_load_n(&(solverStats.queuePushes), __ATOMIC_RELAXED);
+    toReturn.decreaseKeys = __atomic_load_n(&(solverStats.decreaseKeys), __ATOMIC_RELAXED);
+    toReturn.openPeak = __atomic_load_n(&(solverStats.openPeak), __ATOMIC_RELAXED);
+    toReturn.bytesRead = __atomic_load_n(&(solverStats.bytesRead), __ATOMIC_RELAXED);
+    toReturn.bytesWritten = __atomic_load_n(&(solverStats.bytesWritten), __ATOMIC_RELAXED);
+    toReturn.syscalls = __atomic_load_n(&(solverStats.syscalls), __ATOMIC_RELAXED);
+    return toReturn;
+}
+
+void resetStats()
+{
+    __atomic_store_n(&(solverStats.queuePushes), 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&(solverStats.decreaseKeys), 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&(solverStats.openPeak), 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&(solverStats.bytesRead), 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&(solverStats.bytesWritten), 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&(solverStats.syscalls), 0, __ATOMIC_RELAXED);
+}